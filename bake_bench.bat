@@ -0,0 +1,2 @@
+call "C:\Program Files (x86)\Microsoft Visual Studio\2017\Community\VC\Auxiliary\Build\vcvarsall.bat" amd64
+lua build.lua bake_bench
@@ -0,0 +1,316 @@
+// Bakes generated scenes with the radiosity mapper and reports the time of each phase. Built as bake_bench.exe by
+// "build.lua bake_bench", separately from the main executable.
+//
+// bake_bench [--scene cornell|pillars|props|all] [--grid width depth] [--props n] [--rocks rings] [--seed n]
+//            [--lightmap-size n] [--json file] [--compare baseline.json] [--no-pvs]
+//
+// Lightmaps are checksummed instead of written. --compare reads an earlier --json file, shows how the total time
+// of each scene changed and fails with exit code 1 if any scene baked to different lightmaps. --no-pvs draws every
+// object into every hemicube side, a --json run with it is the baseline that culling must reproduce. --rocks makes
+// the props detailed rocks that the hemicubes draw as simplified occluders, see SceneSettings::rock_rings.
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "memory.h"
+#include "windows_window.h"
+#include "renderer_direct3d.h"
+#include "keyboard.h"
+#include "radiosity_mapper.h"
+#include "scene_generator.h"
+#include "world.h"
+#include "config.h"
+#include "trace.h"
+
+static const unsigned MaxBakeResults = 3;
+
+struct BakeResult
+{
+    char name[64];
+    size_t num_objects;
+    RadiosityMapperStats stats;
+};
+
+static void key_pressed_callback(Key key)
+{
+    keyboard_pressed(key);
+}
+
+static void key_released_callback(Key key)
+{
+    keyboard_released(key);
+}
+
+static double total_ms(const RadiosityMapperStats& s)
+{
+    return s.uv_raster_ms + s.patch_setup_ms + s.pvs_ms + s.gather_ms + s.output_ms;
+}
+
+static bool bake_scene(Renderer* renderer, const SceneSettings& settings, PvsCulling pvs_culling, const char* name, BakeResult* result)
+{
+    Allocator ha = create_heap_allocator();
+    World world = world_create(&ha);
+
+    if (!scene_generate(&world, renderer, settings))
+    {
+        fprintf(stderr, "Failed generating scene %s, is box.wobj missing?\n", name);
+        world_destroy(&world);
+        return false;
+    }
+
+    RadiosityMapperStats s = {};
+    run_radiosity_mapper(world, renderer, settings.lightmap_size, WriteLightmaps::DoNotWrite, &s, pvs_culling);
+
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->num_objects = world.objects.num;
+    result->stats = s;
+
+    double total = total_ms(s);
+    printf("%-24s %8zu %8zu %8zu %8.1f %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f %12.0f  %016llx%s\n", name, world.objects.num, s.num_patches,
+        s.num_pvs_clusters, s.mean_pvs_objects, s.uv_raster_ms, s.patch_setup_ms, s.pvs_ms, s.gather_ms, s.output_ms, total,
+        total > 0 ? (double)s.num_patches / (total / 1000.0) : 0.0,
+        (unsigned long long)s.lightmap_checksum, s.aborted ? "  aborted" : "");
+
+    for (size_t i = 0; i < world.objects.num; ++i)
+    {
+        if (IsValidRRHandle(world.objects[i].lightmap_patch_offset))
+            renderer->unload_resource(world.objects[i].lightmap_patch_offset);
+    }
+
+    // Objects share geometry and occluder proxies, each of them is unloaded once.
+    for (size_t i = 0; i < world.objects.num; ++i)
+    {
+        const Object& obj = world.objects[i];
+        bool shared = false;
+        bool proxy_shared = !IsValidRRHandle(obj.occluder_geometry_handle);
+
+        for (size_t j = 0; j < i; ++j)
+        {
+            shared = shared || world.objects[j].geometry_handle.h == obj.geometry_handle.h;
+            proxy_shared = proxy_shared || world.objects[j].occluder_geometry_handle.h == obj.occluder_geometry_handle.h;
+        }
+
+        if (!shared)
+            renderer->unload_resource(obj.geometry_handle);
+
+        if (!proxy_shared)
+            renderer->unload_resource(obj.occluder_geometry_handle);
+    }
+
+    world_destroy(&world);
+    heap_allocator_check_clean(&ha);
+    return !s.aborted;
+}
+
+static bool write_json(const BakeResult* results, unsigned num_results, const char* filename)
+{
+    FILE* f = fopen(filename, "wb");
+
+    if (f == nullptr)
+        return false;
+
+    // One scene per line, compare_to_baseline depends on it.
+    fprintf(f, "{\n    \"scenes\": [\n");
+
+    for (unsigned i = 0; i < num_results; ++i)
+    {
+        const BakeResult& r = results[i];
+        const RadiosityMapperStats& s = r.stats;
+        fprintf(f, "        {\"name\": \"%s\", \"objects\": %zu, \"patches\": %zu, \"clusters\": %zu, \"mean_pvs_objects\": %.2f, \"uv_raster_ms\": %.3f, \"patch_setup_ms\": %.3f, \"pvs_ms\": %.3f, \"gather_ms\": %.3f, \"output_ms\": %.3f, \"total_ms\": %.3f, \"checksum\": \"%016llx\"}%s\n",
+            r.name, r.num_objects, s.num_patches, s.num_pvs_clusters, s.mean_pvs_objects, s.uv_raster_ms, s.patch_setup_ms, s.pvs_ms,
+            s.gather_ms, s.output_ms, total_ms(s),
+            (unsigned long long)s.lightmap_checksum, i + 1 < num_results ? "," : "");
+    }
+
+    fprintf(f, "    ]\n}\n");
+    return fclose(f) == 0;
+}
+
+// Compares each scene to the line with the same name in a file written by write_json, returns the number of
+// scenes whose lightmaps changed.
+static unsigned compare_to_baseline(const BakeResult* results, unsigned num_results, const char* filename)
+{
+    FILE* f = fopen(filename, "rb");
+
+    if (f == nullptr)
+    {
+        fprintf(stderr, "Could not read %s.\n", filename);
+        return num_results;
+    }
+
+    unsigned num_changed = 0;
+    printf("\n%-24s %12s %12s %9s\n", "compared to baseline", "baseline ms", "ms", "change");
+
+    for (unsigned i = 0; i < num_results; ++i)
+    {
+        const BakeResult& r = results[i];
+        char name_key[80];
+        snprintf(name_key, sizeof(name_key), "\"name\": \"%s\"", r.name);
+        char line[1024];
+        const char* total = nullptr;
+        const char* checksum = nullptr;
+        rewind(f);
+
+        while (fgets(line, sizeof(line), f) != nullptr)
+        {
+            if (strstr(line, name_key) == nullptr)
+                continue;
+
+            total = strstr(line, "\"total_ms\": ");
+            checksum = strstr(line, "\"checksum\": \"");
+            break;
+        }
+
+        if (total == nullptr || checksum == nullptr)
+        {
+            printf("%-24s %12s %12.1f\n", r.name, "-", total_ms(r.stats));
+            continue;
+        }
+
+        double base_total = atof(total + strlen("\"total_ms\": "));
+        unsigned long long base_checksum = strtoull(checksum + strlen("\"checksum\": \""), nullptr, 16);
+        bool changed = base_checksum != r.stats.lightmap_checksum;
+        num_changed += changed ? 1 : 0;
+        double change = base_total > 0 ? (total_ms(r.stats) / base_total - 1.0) * 100.0 : 0.0;
+        printf("%-24s %12.1f %12.1f %8.1f%%%s\n", r.name, base_total, total_ms(r.stats), change, changed ? "  LIGHTMAPS CHANGED" : "");
+    }
+
+    fclose(f);
+    return num_changed;
+}
+
+int main(int argc, char** argv)
+{
+    void* temp_memory_block = VirtualAlloc(nullptr, TempMemorySize, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    Assert(temp_memory_block != nullptr, "Failed allocating temp memory.");
+    temp_memory_blob_init(temp_memory_block, TempMemorySize);
+
+    void* permanent_memory_block = VirtualAlloc(nullptr, PermanentMemorySize, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    Assert(permanent_memory_block != nullptr, "Failed allocating permanent memory.");
+    permanent_memory_blob_init(permanent_memory_block, PermanentMemorySize);
+
+    const char* scene = "all";
+    const char* json_filename = nullptr;
+    const char* baseline_filename = nullptr;
+    PvsCulling pvs_culling = PvsCulling::Cull;
+    SceneSettings base_settings = {};
+    base_settings.grid_width = 4;
+    base_settings.grid_depth = 4;
+    base_settings.num_props = 32;
+    base_settings.seed = 1;
+    base_settings.lightmap_size = LightmapSize;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--scene") == 0 && has_value)
+            scene = argv[++i];
+        else if (strcmp(argv[i], "--grid") == 0 && i + 2 < argc)
+        {
+            base_settings.grid_width = (unsigned)atoi(argv[++i]);
+            base_settings.grid_depth = (unsigned)atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--props") == 0 && has_value)
+            base_settings.num_props = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--rocks") == 0 && has_value)
+            base_settings.rock_rings = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && has_value)
+            base_settings.seed = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--lightmap-size") == 0 && has_value)
+            base_settings.lightmap_size = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && has_value)
+            json_filename = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0 && has_value)
+            baseline_filename = argv[++i];
+        else if (strcmp(argv[i], "--no-pvs") == 0)
+            pvs_culling = PvsCulling::DrawAll;
+        else
+        {
+            fprintf(stderr, "usage: bake_bench [--scene cornell|pillars|props|all] [--grid width depth] [--props n] [--rocks rings] [--seed n] [--lightmap-size n] [--json file] [--compare baseline.json] [--no-pvs]\n");
+            return 2;
+        }
+    }
+
+    if (strcmp(scene, "all") != 0 && strcmp(scene, "cornell") != 0 && strcmp(scene, "pillars") != 0 && strcmp(scene, "props") != 0)
+    {
+        fprintf(stderr, "Unknown scene %s.\n", scene);
+        return 2;
+    }
+
+    unsigned lightmap_size = base_settings.lightmap_size;
+
+    if (lightmap_size < 2 || lightmap_size > WindowWidth || lightmap_size > WindowHeight)
+    {
+        fprintf(stderr, "The lightmap size must be between 2 and %u.\n", min(WindowWidth, WindowHeight));
+        return 2;
+    }
+
+    WindowsWindow window = {};
+    create_window(&window);
+    Renderer renderer = {};
+    renderer.init(window.handle);
+    keyboard_init();
+    window.state.key_released_callback = key_released_callback;
+    window.state.key_pressed_callback = key_pressed_callback;
+
+    // Scene names include the settings, so that --compare only matches runs of the same scene.
+    BakeResult results[MaxBakeResults] = {};
+    unsigned num_results = 0;
+    bool all = strcmp(scene, "all") == 0;
+    bool ok = true;
+    char name[64];
+    printf("%-24s %8s %8s %8s %8s %12s %12s %12s %12s %12s %12s %12s  %s\n", "scene", "objects", "patches", "clusters",
+        "pvs objs", "uv raster ms", "setup ms", "pvs ms", "gather ms", "output ms", "total ms", "patches/s", "checksum");
+
+    if (ok && (all || strcmp(scene, "cornell") == 0))
+    {
+        SceneSettings s = base_settings;
+        s.type = SceneType::CornellBox;
+        snprintf(name, sizeof(name), "cornell/%u", lightmap_size);
+        ok = bake_scene(&renderer, s, pvs_culling, name, &results[num_results++]);
+    }
+
+    if (ok && (all || strcmp(scene, "pillars") == 0))
+    {
+        SceneSettings s = base_settings;
+        s.type = SceneType::PillarGrid;
+        snprintf(name, sizeof(name), "pillars_%ux%u/%u", s.grid_width, s.grid_depth, lightmap_size);
+        ok = bake_scene(&renderer, s, pvs_culling, name, &results[num_results++]);
+    }
+
+    if (ok && (all || strcmp(scene, "props") == 0))
+    {
+        SceneSettings s = base_settings;
+        s.type = SceneType::ScatteredProps;
+
+        if (s.rock_rings > 0)
+            snprintf(name, sizeof(name), "props_%u_seed%u_rocks%u/%u", s.num_props, s.seed, s.rock_rings, lightmap_size);
+        else
+            snprintf(name, sizeof(name), "props_%u_seed%u/%u", s.num_props, s.seed, lightmap_size);
+
+        ok = bake_scene(&renderer, s, pvs_culling, name, &results[num_results++]);
+    }
+
+    renderer.shutdown();
+    int exit_code = ok && num_results > 0 ? 0 : 2;
+
+    #if defined(ENABLE_TRACING)
+        if (!trace_write_chrome_json("bake_bench_trace.json"))
+            fprintf(stderr, "Could not write bake_bench_trace.json.\n");
+    #endif
+
+    if (!ok)
+        num_results = num_results > 0 ? num_results - 1 : 0;
+
+    if (json_filename != nullptr && !write_json(results, num_results, json_filename))
+    {
+        fprintf(stderr, "Could not write %s.\n", json_filename);
+        exit_code = 2;
+    }
+
+    if (baseline_filename != nullptr && compare_to_baseline(results, num_results, baseline_filename) > 0 && exit_code == 0)
+        exit_code = 1;
+
+    return exit_code;
+}
@@ -0,0 +1,517 @@
+// Microbenchmarks for allocators, containers, OBJ loading and math. Built as bench.exe by "build.lua bench",
+// separately from the main executable.
+//
+// bench [--filter text] [--samples n] [--json file] [--compare baseline.json] [--threshold percent]
+//       [--profile file]
+//
+// Every benchmark is timed as a number of samples, each running a fixed number of operations, and reported as
+// ns/op: the minimum, 10th percentile, median, 90th percentile and maximum over the samples. --json writes the
+// results, --compare reads an earlier --json file and flags benchmarks whose median got slower than the
+// threshold, 10% by default. The exit code is 1 if there were any regressions. --profile runs the sampling
+// profiler over the benchmarks and writes folded stacks, on Linux.
+
+#include "memory.h"
+#include "dynamic_array.h"
+#include "math.h"
+#include "math_batch.h"
+#include "camera.h"
+#include "obj.h"
+#include "sampling_profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+static const unsigned DefaultSamples = 31;
+static const float DefaultRegressionThreshold = 10.0f;
+static const unsigned MaxBenchResults = 128;
+
+struct BenchResult
+{
+    char name[64];
+    size_t ops_per_sample;
+    unsigned num_samples;
+    double min_ns;
+    double p10_ns;
+    double median_ns;
+    double p90_ns;
+    double max_ns;
+};
+
+struct Bench
+{
+    const char* filter;
+    unsigned num_samples;
+    BenchResult results[MaxBenchResults];
+    unsigned num_results;
+};
+
+// Results of the benchmarked code are added here so the compiler can't remove it.
+static volatile float bench_sink;
+
+static double percentile(const double* sorted, unsigned num, double p)
+{
+    return sorted[(unsigned)(p * (num - 1) + 0.5)];
+}
+
+// Runs f, which must do ops_per_sample operations, once to warm up and then once per sample.
+template<typename F>
+static void bench_run(Bench* b, const char* name, size_t ops_per_sample, F f)
+{
+    if (b->filter != nullptr && strstr(name, b->filter) == nullptr)
+        return;
+
+    Assert(b->num_results < MaxBenchResults, "Too many benchmarks.");
+    Allocator ta = create_temp_allocator();
+    double* samples = (double*)ta.alloc(b->num_samples * sizeof(double));
+    f();
+
+    for (unsigned s = 0; s < b->num_samples; ++s)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end = std::chrono::steady_clock::now();
+        samples[s] = std::chrono::duration<double, std::nano>(end - start).count() / (double)ops_per_sample;
+    }
+
+    for (unsigned i = 1; i < b->num_samples; ++i)
+    {
+        double v = samples[i];
+        unsigned j = i;
+
+        for (; j > 0 && samples[j - 1] > v; --j)
+            samples[j] = samples[j - 1];
+
+        samples[j] = v;
+    }
+
+    BenchResult& r = b->results[b->num_results++];
+    snprintf(r.name, sizeof(r.name), "%s", name);
+    r.ops_per_sample = ops_per_sample;
+    r.num_samples = b->num_samples;
+    r.min_ns = samples[0];
+    r.p10_ns = percentile(samples, b->num_samples, 0.1);
+    r.median_ns = percentile(samples, b->num_samples, 0.5);
+    r.p90_ns = percentile(samples, b->num_samples, 0.9);
+    r.max_ns = samples[b->num_samples - 1];
+    printf("%-40s %12.2f %12.2f %12.2f %12.2f %12.2f\n", r.name, r.min_ns, r.p10_ns, r.median_ns, r.p90_ns, r.max_ns);
+}
+
+static unsigned lcg_next(unsigned* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state;
+}
+
+static float random_float(unsigned* state)
+{
+    return (float)(lcg_next(state) >> 8) / (float)(1 << 24) * 2.0f - 1.0f;
+}
+
+static void bench_allocators(Bench* b)
+{
+    const unsigned num_allocs = 1024;
+    Allocator ha = create_heap_allocator();
+    void* ptrs[num_allocs];
+
+    bench_run(b, "heap_allocator/alloc_free_64", num_allocs, [&]() {
+        for (unsigned i = 0; i < num_allocs; ++i)
+            ptrs[i] = ha.alloc(64);
+
+        for (unsigned i = 0; i < num_allocs; ++i)
+            ha.dealloc(ptrs[i]);
+    });
+
+    unsigned sizes[num_allocs];
+    unsigned rng = 1;
+
+    for (unsigned i = 0; i < num_allocs; ++i)
+        sizes[i] = 16 + lcg_next(&rng) % 4096;
+
+    bench_run(b, "heap_allocator/alloc_free_mixed", num_allocs, [&]() {
+        for (unsigned i = 0; i < num_allocs; ++i)
+            ptrs[i] = ha.alloc(sizes[i]);
+
+        // Every other first, so that frees also merge with free neighbours.
+        for (unsigned i = 0; i < num_allocs; i += 2)
+            ha.dealloc(ptrs[i]);
+
+        for (unsigned i = 1; i < num_allocs; i += 2)
+            ha.dealloc(ptrs[i]);
+    });
+
+    heap_allocator_check_clean(&ha);
+
+    bench_run(b, "temp_allocator/alloc_64", num_allocs, [&]() {
+        Allocator ta = create_temp_allocator();
+
+        for (unsigned i = 0; i < num_allocs; ++i)
+            ptrs[i] = ta.alloc(64);
+    });
+}
+
+static void bench_dynamic_array(Bench* b)
+{
+    const unsigned num_elements = 1 << 20;
+    Allocator ha = create_heap_allocator();
+
+    bench_run(b, "dynamic_array/add_heap", num_elements, [&]() {
+        DynamicArray<unsigned> da = dynamic_array_create<unsigned>(&ha);
+
+        for (unsigned i = 0; i < num_elements; ++i)
+            da.add(i);
+
+        bench_sink = bench_sink + (float)da[num_elements / 2];
+        dynamic_array_destroy(&da);
+    });
+
+    bench_run(b, "dynamic_array/add_temp", num_elements, [&]() {
+        Allocator ta = create_temp_allocator();
+        DynamicArray<unsigned> da = dynamic_array_create<unsigned>(&ta);
+
+        for (unsigned i = 0; i < num_elements; ++i)
+            da.add(i);
+
+        bench_sink = bench_sink + (float)da[num_elements / 2];
+    });
+
+    heap_allocator_check_clean(&ha);
+}
+
+// Writes a side by side grid of quads with normals and uvs, shaped like exported meshes.
+static bool write_grid_obj(const char* filename, unsigned size)
+{
+    FILE* f = fopen(filename, "wb");
+
+    if (f == nullptr)
+        return false;
+
+    for (unsigned y = 0; y <= size; ++y)
+    {
+        for (unsigned x = 0; x <= size; ++x)
+        {
+            float fx = (float)x / (float)size, fy = (float)y / (float)size;
+            fprintf(f, "v %f %f %f\nvt %f %f\nvn 0 1 0\n", fx, 0.1f * sinf(fx * 20.0f) * cosf(fy * 15.0f), fy, fx, fy);
+        }
+    }
+
+    for (unsigned y = 0; y < size; ++y)
+    {
+        for (unsigned x = 0; x < size; ++x)
+        {
+            unsigned i = y * (size + 1) + x + 1;
+            unsigned j = i + size + 1;
+            fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i, i, i, j, j, j, i + 1, i + 1, i + 1);
+            fprintf(f, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", i + 1, i + 1, i + 1, j, j, j, j + 1, j + 1, j + 1);
+        }
+    }
+
+    return fclose(f) == 0;
+}
+
+static void bench_obj_load(Bench* b)
+{
+    const unsigned grid_sizes[] = {32, 128, 512};
+
+    for (unsigned grid_size : grid_sizes)
+    {
+        char filename[64], name[64];
+        snprintf(filename, sizeof(filename), "bench_grid_%u.obj", grid_size);
+
+        if (!write_grid_obj(filename, grid_size))
+        {
+            fprintf(stderr, "Could not write %s.\n", filename);
+            continue;
+        }
+
+        // Loaded like mesh_cache does, into a temp allocator that also holds the parsed file.
+        size_t num_triangles = (size_t)grid_size * grid_size * 2;
+        snprintf(name, sizeof(name), "obj_load/grid_%zu_tris", num_triangles);
+
+        bench_run(b, name, num_triangles, [&]() {
+            Allocator ta = create_temp_allocator();
+            LoadedMesh lm = obj_load(&ta, filename);
+            Assert(lm.valid, "Failed loading generated OBJ file.");
+            bench_sink = bench_sink + (float)lm.mesh.vertices.num;
+        });
+
+        snprintf(name, sizeof(name), "obj_load_streaming/grid_%zu_tris", num_triangles);
+
+        bench_run(b, name, num_triangles, [&]() {
+            Allocator ta = create_temp_allocator();
+            LoadedMesh lm = obj_load_streaming(&ta, filename);
+            Assert(lm.valid, "Failed loading generated OBJ file.");
+            bench_sink = bench_sink + (float)lm.mesh.vertices.num;
+        });
+
+        remove(filename);
+    }
+}
+
+static void bench_math(Bench* b)
+{
+    const unsigned n = 1024;
+    Allocator ta = create_temp_allocator();
+    Matrix4x4* matrices = (Matrix4x4*)ta.alloc(n * sizeof(Matrix4x4));
+    Matrix4x4* matrices_out = (Matrix4x4*)ta.alloc(n * sizeof(Matrix4x4));
+    Quaternion* quaternions = (Quaternion*)ta.alloc(n * sizeof(Quaternion));
+    Vector4* vectors = (Vector4*)ta.alloc(n * sizeof(Vector4));
+    Vector3* points = (Vector3*)ta.alloc(n * sizeof(Vector3));
+    Vector3* points_out = (Vector3*)ta.alloc(n * sizeof(Vector3));
+    unsigned rng = 7;
+
+    for (unsigned i = 0; i < n; ++i)
+    {
+        quaternions[i] = quaternion_normalize({random_float(&rng), random_float(&rng), random_float(&rng), random_float(&rng)});
+        points[i] = {random_float(&rng), random_float(&rng), random_float(&rng)};
+        vectors[i] = {points[i].x, points[i].y, points[i].z, 1};
+        matrices[i] = matrix4x4_from_rotation_and_translation(quaternions[i], points[i]);
+    }
+
+    bench_run(b, "math/matrix4x4_mul", n, [&]() {
+        for (unsigned i = 0; i < n; ++i)
+            matrices_out[i] = matrices[i] * matrices[(i + 1) % n];
+
+        bench_sink = bench_sink + matrices_out[n / 2].x.x;
+    });
+
+    bench_run(b, "math/matrix4x4_inverse", n, [&]() {
+        for (unsigned i = 0; i < n; ++i)
+            matrices_out[i] = matrix4x4_inverse(matrices[i]);
+
+        bench_sink = bench_sink + matrices_out[n / 2].x.x;
+    });
+
+    bench_run(b, "math/vector4_mul_matrix4x4", n, [&]() {
+        Vector4 sum = {};
+
+        for (unsigned i = 0; i < n; ++i)
+            sum += vectors[i] * matrices[i];
+
+        bench_sink = bench_sink + sum.x;
+    });
+
+    bench_run(b, "math/quaternion_mul", n, [&]() {
+        Quaternion q = quaternion_identity();
+
+        for (unsigned i = 0; i < n; ++i)
+            q = q * quaternions[i];
+
+        bench_sink = bench_sink + q.w;
+    });
+
+    bench_run(b, "math/vector3_normalize", n, [&]() {
+        for (unsigned i = 0; i < n; ++i)
+            points_out[i] = vector3_normalize(points[i]);
+
+        bench_sink = bench_sink + points_out[n / 2].x;
+    });
+
+    bench_run(b, "math/camera_calc_view_matrix", n, [&]() {
+        Camera c = camera_create_projection();
+
+        for (unsigned i = 0; i < n; ++i)
+        {
+            c.rotation = quaternions[i];
+            c.position = points[i];
+            matrices_out[i] = camera_calc_view_matrix(c);
+        }
+
+        bench_sink = bench_sink + matrices_out[n / 2].w.x;
+    });
+
+    const char* isa_names[] = {"scalar", "avx2", "avx512"};
+    BatchIsa best_isa = math_batch_isa();
+
+    for (unsigned isa = 0; isa <= (unsigned)best_isa; ++isa)
+    {
+        char name[64];
+        math_batch_force_isa((BatchIsa)isa);
+        snprintf(name, sizeof(name), "math_batch/transform_points_%s", isa_names[isa]);
+
+        bench_run(b, name, n, [&]() {
+            transform_points(matrices[0], points, points_out, n);
+            bench_sink = bench_sink + points_out[n / 2].x;
+        });
+
+        snprintf(name, sizeof(name), "math_batch/transform_normals_%s", isa_names[isa]);
+
+        bench_run(b, name, n, [&]() {
+            transform_normals(matrices[0], points, points_out, n);
+            bench_sink = bench_sink + points_out[n / 2].x;
+        });
+    }
+
+    math_batch_force_isa(best_isa);
+}
+
+static bool write_json(const Bench& b, const char* filename)
+{
+    FILE* f = fopen(filename, "wb");
+
+    if (f == nullptr)
+        return false;
+
+    // One benchmark per line, read_baseline depends on it.
+    fprintf(f, "{\n    \"benchmarks\": [\n");
+
+    for (unsigned i = 0; i < b.num_results; ++i)
+    {
+        const BenchResult& r = b.results[i];
+        fprintf(f, "        {\"name\": \"%s\", \"ops_per_sample\": %zu, \"samples\": %u, \"min_ns\": %.3f, \"p10_ns\": %.3f, \"median_ns\": %.3f, \"p90_ns\": %.3f, \"max_ns\": %.3f}%s\n",
+            r.name, r.ops_per_sample, r.num_samples, r.min_ns, r.p10_ns, r.median_ns, r.p90_ns, r.max_ns, i + 1 < b.num_results ? "," : "");
+    }
+
+    fprintf(f, "    ]\n}\n");
+    return fclose(f) == 0;
+}
+
+// Reads the name and median of each benchmark in a file written by write_json.
+static unsigned read_baseline(const char* filename, BenchResult* results, unsigned max_results)
+{
+    FILE* f = fopen(filename, "rb");
+
+    if (f == nullptr)
+        return 0;
+
+    char line[1024];
+    unsigned num = 0;
+
+    while (num < max_results && fgets(line, sizeof(line), f) != nullptr)
+    {
+        const char* name = strstr(line, "\"name\": \"");
+        const char* median = strstr(line, "\"median_ns\": ");
+
+        if (name == nullptr || median == nullptr)
+            continue;
+
+        name += strlen("\"name\": \"");
+        const char* name_end = strchr(name, '"');
+
+        if (name_end == nullptr || (size_t)(name_end - name) >= sizeof(results[num].name))
+            continue;
+
+        BenchResult& r = results[num++];
+        memset(&r, 0, sizeof(r));
+        memcpy(r.name, name, name_end - name);
+        r.median_ns = atof(median + strlen("\"median_ns\": "));
+    }
+
+    fclose(f);
+    return num;
+}
+
+static unsigned compare_to_baseline(const Bench& b, const BenchResult* baseline, unsigned num_baseline, float threshold_percent)
+{
+    unsigned num_regressions = 0;
+    printf("\n%-40s %12s %12s %9s\n", "compared to baseline", "baseline", "median", "change");
+
+    for (unsigned i = 0; i < b.num_results; ++i)
+    {
+        const BenchResult& r = b.results[i];
+        const BenchResult* base = nullptr;
+
+        for (unsigned j = 0; j < num_baseline && base == nullptr; ++j)
+        {
+            if (strcmp(baseline[j].name, r.name) == 0)
+                base = baseline + j;
+        }
+
+        if (base == nullptr || base->median_ns <= 0)
+        {
+            printf("%-40s %12s %12.2f\n", r.name, "-", r.median_ns);
+            continue;
+        }
+
+        double change = (r.median_ns / base->median_ns - 1.0) * 100.0;
+        bool regressed = change > threshold_percent;
+        num_regressions += regressed ? 1 : 0;
+        printf("%-40s %12.2f %12.2f %8.1f%%%s\n", r.name, base->median_ns, r.median_ns, change, regressed ? "  REGRESSION" : "");
+    }
+
+    return num_regressions;
+}
+
+int main(int argc, char** argv)
+{
+    void* temp_memory_block = malloc(TempMemorySize);
+    Assert(temp_memory_block != nullptr, "Failed allocating temp memory.");
+    temp_memory_blob_init(temp_memory_block, TempMemorySize);
+
+    Bench* b = (Bench*)calloc(1, sizeof(Bench));
+    b->num_samples = DefaultSamples;
+    const char* json_filename = nullptr;
+    const char* baseline_filename = nullptr;
+    const char* profile_filename = nullptr;
+    float threshold_percent = DefaultRegressionThreshold;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--filter") == 0 && has_value)
+            b->filter = argv[++i];
+        else if (strcmp(argv[i], "--samples") == 0 && has_value)
+            b->num_samples = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0 && has_value)
+            json_filename = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0 && has_value)
+            baseline_filename = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && has_value)
+            threshold_percent = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "--profile") == 0 && has_value)
+            profile_filename = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: bench [--filter text] [--samples n] [--json file] [--compare baseline.json] [--threshold percent] [--profile file]\n");
+            return 2;
+        }
+    }
+
+    if (b->num_samples == 0)
+        b->num_samples = 1;
+
+    if (profile_filename != nullptr && !sampling_profiler_start())
+    {
+        fprintf(stderr, "The sampling profiler isn't available.\n");
+        return 2;
+    }
+
+    printf("%-40s %12s %12s %12s %12s %12s\n", "ns/op", "min", "p10", "median", "p90", "max");
+    bench_allocators(b);
+    bench_dynamic_array(b);
+    bench_obj_load(b);
+    bench_math(b);
+    int exit_code = 0;
+
+    if (profile_filename != nullptr && !sampling_profiler_write_folded(profile_filename))
+    {
+        fprintf(stderr, "Could not write %s.\n", profile_filename);
+        exit_code = 2;
+    }
+
+    if (json_filename != nullptr && !write_json(*b, json_filename))
+    {
+        fprintf(stderr, "Could not write %s.\n", json_filename);
+        exit_code = 2;
+    }
+
+    if (baseline_filename != nullptr)
+    {
+        BenchResult* baseline = (BenchResult*)calloc(MaxBenchResults, sizeof(BenchResult));
+        unsigned num_baseline = read_baseline(baseline_filename, baseline, MaxBenchResults);
+
+        if (num_baseline == 0)
+        {
+            fprintf(stderr, "Could not read any results from %s.\n", baseline_filename);
+            exit_code = 2;
+        }
+        else if (compare_to_baseline(*b, baseline, num_baseline, threshold_percent) > 0)
+            exit_code = exit_code == 0 ? 1 : exit_code;
+
+        free(baseline);
+    }
+
+    free(b);
+    free(temp_memory_block);
+    return exit_code;
+}
@@ -17,8 +17,28 @@ function string.replace_end(str, n, new)
     return str:sub(1, new_str_end) .. new
 end
 
+-- Files with their own main, built as separate executables instead of into skugga.exe.
+local separate_targets = {
+    ["memory_test.cpp"] = true,
+    ["handle_table_test.cpp"] = true,
+    ["render_commands_test.cpp"] = true,
+    ["frustum_test.cpp"] = true,
+    ["camera_test.cpp"] = true,
+    ["patch_pvs_test.cpp"] = true,
+    ["trace_test.cpp"] = true,
+    ["sampling_profiler_test.cpp"] = true,
+    ["lightmap_uv_test.cpp"] = true,
+    ["math_batch_test.cpp"] = true,
+    ["mesh_test.cpp"] = true,
+    ["mesh_optimizer_test.cpp"] = true,
+    ["mesh_cache_test.cpp"] = true,
+    ["mesh_simplifier_test.cpp"] = true,
+    ["bench.cpp"] = true,
+    ["bake_bench.cpp"] = true
+}
+
 for filename in lfs.dir(".") do
-    if string.ends_with(filename, ".cpp") and filename ~= "memory_test.cpp" then
+    if string.ends_with(filename, ".cpp") and not separate_targets[filename] then
         table.insert(files_to_build, filename)
     end
 end
@@ -35,6 +55,8 @@ end
 local set_env = arg_contain("set_env")
 local build = arg_contain("build")
 local run = arg_contain("run")
+local bench = arg_contain("bench")
+local bake_bench = arg_contain("bake_bench")
 local use_debug = arg_contain("use_debug")
 
 function run_or_die(cmd)
@@ -55,30 +77,55 @@ if set_env then
     run_or_die("\"" .. vs_dir .. "..\\..\\VC\\vcvarsall.bat\" amd64")
 end
 
-if build then
+local extra_compile_opts = "/Os"
+local extra_link_opts = "/debug"
+local libs = "dbghelp.lib d3d11.lib user32.lib dxgi.lib D3DCompiler.lib"
+
+if use_debug then
+    extra_compile_opts = "/D DEBUG"
+    extra_link_opts = "/debug"
+end
+
+function compile(filename)
+    local object_filename = "build\\" .. string.replace_end(filename, 3, "o")
+    local build_cmd = "cl.exe /FI types.h /FI helpers.h /D _HAS_EXCEPTIONS=0 /nologo /W4 /WX /Gm /EHsc /TP /wd4505 /wd4201 /wd4100 /c /D _CRT_SECURE_NO_WARNINGS /Zi /MTd " .. extra_compile_opts .. " /Fo" .. object_filename .. " " .. filename
+    run_or_die(build_cmd)
+    return object_filename
+end
+
+if build or bench or bake_bench then
     lfs.mkdir("build")
 
     local object_files = ""
-    local extra_compile_opts = "/Os"
-    local extra_link_opts = "/debug"
-
-    if use_debug then
-        extra_compile_opts = "/D DEBUG"
-        extra_link_opts = "/debug"
-    end
+    local engine_object_files = ""
 
     for _, filename in ipairs(files_to_build) do
-        local object_filename = "build\\" .. string.replace_end(filename, 3, "o")
-
-        local build_cmd = "cl.exe /FI types.h /FI helpers.h /D _HAS_EXCEPTIONS=0 /nologo /W4 /WX /Gm /EHsc /TP /wd4505 /wd4201 /wd4100 /c /D _CRT_SECURE_NO_WARNINGS /Zi /MTd " .. extra_compile_opts .. " /Fo" .. object_filename .. " " .. filename
-        run_or_die(build_cmd)
+        local object_filename = compile(filename)
         object_files = object_files .. object_filename .. " "
+
+        if filename ~= "main.cpp" then
+            engine_object_files = engine_object_files .. object_filename .. " "
+        end
+    end
+
+    if build and #object_files > 0 then
+        local link_cmd = "link.exe " .. extra_link_opts .. " /subsystem:windows /entry:mainCRTStartup " .. libs .. " /out:skugga.exe " .. object_files
+        run_or_die(link_cmd)
     end
 
-    if #object_files > 0 then
-        local link_cmd = "link.exe " .. extra_link_opts .. " /subsystem:windows /entry:mainCRTStartup dbghelp.lib d3d11.lib user32.lib dxgi.lib D3DCompiler.lib /out:skugga.exe " .. object_files
+    -- The benchmarks link against everything but main.cpp and print to the console.
+    local function link_benchmark(name)
+        local link_cmd = "link.exe " .. extra_link_opts .. " /subsystem:console " .. libs .. " /out:" .. name .. ".exe " .. compile(name .. ".cpp") .. " " .. engine_object_files
         run_or_die(link_cmd)
     end
+
+    if bench then
+        link_benchmark("bench")
+    end
+
+    if bake_bench then
+        link_benchmark("bake_bench")
+    end
 end
 
 if run then
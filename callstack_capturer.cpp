@@ -1,26 +1,22 @@
 #include "callstack_capturer.h"
+#include <string.h>
+
+#if defined(_WIN32)
+
 #include <Windows.h>
 #pragma warning(push)
 #pragma warning(disable : 4091)
 #include <DbgHelp.h>
 #pragma warning(pop)
 
-CapturedCallstack callstack_capture(unsigned frames_to_skip, void* p)
+CapturedCallstack callstack_capture(unsigned frames_to_skip)
 {
-    const unsigned frames_to_capture = 64;
-    DWORD back_trace_hash = 0; 
+    DWORD back_trace_hash = 0;
     CapturedCallstack cc;
-    cc.num_frames = (unsigned char)CaptureStackBackTrace(frames_to_skip + 2, frames_to_capture, cc.frames, &back_trace_hash);
-    cc.ptr = p;
-    cc.used = true;
+    cc.num_frames = (unsigned char)CaptureStackBackTrace(frames_to_skip + 1, MaxCallstackFrames, cc.frames, &back_trace_hash);
     return cc;
 }
 
-void callstack_destroy(CapturedCallstack* c)
-{
-    c->used = false;
-}
-
 void callstack_print(const char* caption, const CapturedCallstack& captured_callstack)
 {
     HANDLE process = GetCurrentProcess();
@@ -29,7 +25,7 @@ void callstack_print(const char* caption, const CapturedCallstack& captured_call
     symbol->MaxNameLen = 255;
     symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
 
-    auto callstack_str = (char*)malloc(symbol->MaxNameLen * 64);
+    auto callstack_str = (char*)malloc(symbol->MaxNameLen * MaxCallstackFrames);
     unsigned callstack_str_size = 0;
     for (unsigned i = 0; i < captured_callstack.num_frames; i++ )
     {
@@ -43,3 +39,87 @@ void callstack_print(const char* caption, const CapturedCallstack& captured_call
     free(callstack_str);
     free(symbol);
 }
+
+#else
+
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+CapturedCallstack callstack_capture(unsigned frames_to_skip)
+{
+    // backtrace() includes this function, so skip one more than asked for.
+    const unsigned skip = frames_to_skip + 1;
+    void* frames[MaxCallstackFrames + 8];
+    const unsigned max_frames = MaxCallstackFrames + (skip < 8 ? skip : 8);
+    int num_captured = backtrace(frames, (int)max_frames);
+
+    CapturedCallstack cc;
+    cc.num_frames = 0;
+
+    if (num_captured > (int)skip)
+    {
+        cc.num_frames = (unsigned char)(num_captured - skip);
+        memcpy(cc.frames, frames + skip, cc.num_frames * sizeof(void*));
+    }
+
+    return cc;
+}
+
+// Symbols of the executable itself are only visible to dladdr when linked with -rdynamic, otherwise only
+// the module and offset are printed and addr2line can be used.
+void callstack_print(const char* caption, const CapturedCallstack& captured_callstack)
+{
+    fprintf(stderr, "%s\n", caption);
+
+    for (unsigned i = 0; i < captured_callstack.num_frames; ++i)
+    {
+        void* frame = captured_callstack.frames[i];
+        Dl_info info = {};
+
+        if (dladdr(frame, &info) == 0 || info.dli_fname == nullptr)
+        {
+            fprintf(stderr, "    %p\n", frame);
+            continue;
+        }
+
+        if (info.dli_sname == nullptr)
+        {
+            fprintf(stderr, "    %s+0x%zx\n", info.dli_fname, (size_t)((char*)frame - (char*)info.dli_fbase));
+            continue;
+        }
+
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        fprintf(stderr, "    %s+0x%zx (%s)\n", status == 0 ? demangled : info.dli_sname,
+            (size_t)((char*)frame - (char*)info.dli_saddr), info.dli_fname);
+        free(demangled);
+    }
+
+    fprintf(stderr, "\n");
+}
+
+#endif
+
+unsigned callstack_hash(const CapturedCallstack& c)
+{
+    // FNV-1a over the frame addresses.
+    unsigned hash = 2166136261u;
+    const unsigned char* bytes = (const unsigned char*)c.frames;
+    const unsigned num_bytes = c.num_frames * sizeof(void*);
+
+    for (unsigned i = 0; i < num_bytes; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+bool callstack_equal(const CapturedCallstack& c1, const CapturedCallstack& c2)
+{
+    return c1.num_frames == c2.num_frames && memcmp(c1.frames, c2.frames, c1.num_frames * sizeof(void*)) == 0;
+}
@@ -1,13 +1,14 @@
 #pragma once
 
+const unsigned MaxCallstackFrames = 64;
+
 struct CapturedCallstack
 {
     unsigned char num_frames;
-    void* frames[64];
-    void* ptr;
-    bool used;
+    void* frames[MaxCallstackFrames];
 };
 
-CapturedCallstack callstack_capture(unsigned frames_to_skip, void* p);
-void callstack_destroy(CapturedCallstack* c);
+CapturedCallstack callstack_capture(unsigned frames_to_skip);
+unsigned callstack_hash(const CapturedCallstack& c);
+bool callstack_equal(const CapturedCallstack& c1, const CapturedCallstack& c2);
 void callstack_print(const char* caption, const CapturedCallstack& captured_callstack);
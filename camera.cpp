@@ -1,9 +1,12 @@
 #include "camera.h"
 #include <math.h>
 
+// The camera transform is a rotation and a translation, so its inverse is the inverse rotation followed by the
+// inverse translation, no general matrix inverse is needed. Camera rotations are unit quaternions.
 Matrix4x4 camera_calc_view_matrix(const Camera& c)
 {
-    return matrix4x4_inverse(matrix4x4_from_rotation_and_translation(c.rotation, c.position));
+    Quaternion inverse_rotation = quaternion_conjugate(c.rotation);
+    return matrix4x4_from_rotation_and_translation(inverse_rotation, -quaternion_transform_vector3(inverse_rotation, c.position));
 }
 
 Camera camera_create_projection()
@@ -12,7 +15,7 @@ Camera camera_create_projection()
     float far_plane = 1000.0f;
     float fov = 90.0f;
     float aspect = 1.0f;
-    float y_scale = 1.0f / tanf((3.14f / 180.0f) * fov / 2);
+    float y_scale = 1.0f / tanf((PI / 180.0f) * fov / 2);
     float x_scale = y_scale / aspect;
 
     Camera c = {};
@@ -38,3 +41,30 @@ Camera camera_create_uv_rendering()
     c.rotation = quaternion_identity();
     return c;
 }
+
+// The sides turn about the axes of the front camera, so that each of them keeps normal along one of its own axes.
+// Turning about the world space tangents instead leaves the sides rolled by however the front camera is rolled.
+Hemicube camera_create_hemicube(const Vector3& position, const Vector3& normal)
+{
+    Camera base = camera_create_projection();
+    base.position = position;
+
+    Hemicube h;
+    h.front = base;
+    h.front.rotation = quaternion_look_at(vector3_zero, normal);
+
+    // Looking along +x the normal is along -x, the left half of the view.
+    h.right = base;
+    h.right.rotation = quaternion_normalize(h.front.rotation * quaternion_from_axis_angle({0, 1, 0}, PI/2));
+
+    h.left = base;
+    h.left.rotation = quaternion_normalize(h.front.rotation * quaternion_from_axis_angle({0, 1, 0}, -PI/2));
+
+    // Looking along +y the normal is along -y, the bottom half of the view.
+    h.up = base;
+    h.up.rotation = quaternion_normalize(h.front.rotation * quaternion_from_axis_angle({1, 0, 0}, -PI/2));
+
+    h.down = base;
+    h.down.rotation = quaternion_normalize(h.front.rotation * quaternion_from_axis_angle({1, 0, 0}, PI/2));
+    return h;
+}
@@ -11,4 +11,18 @@ struct Camera
 
 Matrix4x4 camera_calc_view_matrix(const Camera& c);
 Camera camera_create_projection();
-Camera camera_create_uv_rendering();
\ No newline at end of file
+Camera camera_create_uv_rendering();
+
+// The five cameras of a hemicube at position facing along normal. The side cameras look along the surface, so only
+// the half of each of their views towards normal is part of the hemicube: the left half for right, the right half
+// for left, the bottom half for up and the top half for down.
+struct Hemicube
+{
+    Camera front;
+    Camera right;
+    Camera left;
+    Camera up;
+    Camera down;
+};
+
+Hemicube camera_create_hemicube(const Vector3& position, const Vector3& normal);
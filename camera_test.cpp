@@ -0,0 +1,87 @@
+#include <assert.h>
+#include "helpers.h"
+#include "math.cpp"
+#include "camera.cpp"
+
+// Part of a view in normalized device coordinates, like the scissor rects of the hemicube sides.
+struct ViewRect
+{
+    float left, right, bottom, top;
+};
+
+static const ViewRect full_view = {-1, 1, -1, 1};
+static const ViewRect left_half = {-1, 0, -1, 1};
+static const ViewRect right_half = {0, 1, -1, 1};
+static const ViewRect bottom_half = {-1, 1, -1, 0};
+static const ViewRect top_half = {-1, 1, 0, 1};
+
+static bool sees(const Camera& c, const ViewRect& r, const Vector3& p)
+{
+    Vector4 clip = Vector4{p.x, p.y, p.z, 1} * (camera_calc_view_matrix(c) * c.projection_matrix);
+
+    if (clip.w <= 0 || clip.z < 0 || clip.z > clip.w)
+        return false;
+
+    float x = clip.x / clip.w;
+    float y = clip.y / clip.w;
+    return x >= r.left && x <= r.right && y >= r.bottom && y <= r.top;
+}
+
+// Evenly spread directions on the unit sphere.
+static Vector3 sphere_direction(unsigned i, unsigned n)
+{
+    float z = 1 - (float)(2 * i + 1) / (float)n;
+    float r = sqrtf(1 - z * z);
+    float a = (float)i * 2.39996323f;
+    return {r * cosf(a), r * sinf(a), z};
+}
+
+static void check_hemicube(const Vector3& position, const Vector3& normal)
+{
+    Hemicube h = camera_create_hemicube(position, normal);
+    const Camera* cameras[] = {&h.front, &h.right, &h.left, &h.up, &h.down};
+    const ViewRect* rects[] = {&full_view, &left_half, &right_half, &bottom_half, &top_half};
+    const unsigned num_directions = 4096;
+
+    for (unsigned i = 0; i < num_directions; ++i)
+    {
+        Vector3 d = sphere_direction(i, num_directions);
+        Vector3 p = position + d * 5;
+        float facing = vector3_dot(normal, d);
+        bool seen = false;
+
+        // No side sees behind the patch.
+        for (unsigned ci = 0; ci < 5; ++ci)
+        {
+            if (sees(*cameras[ci], *rects[ci], p))
+            {
+                assert(facing > -0.001f);
+                seen = true;
+            }
+        }
+
+        // Together they see all of what is in front of it.
+        if (facing > 0.001f)
+            assert(seen);
+    }
+
+    assert(sees(h.front, full_view, position + normal));
+}
+
+int main()
+{
+    Vector3 position = {1, 2, 3};
+    Vector3 normals[] = {
+        {1, 0, 0}, {-1, 0, 0},
+        {0, 1, 0}, {0, -1, 0},
+        {0, 0, 1}, {0, 0, -1},
+        vector3_normalize({1, 1, 0}),
+        vector3_normalize({0.3f, -0.8f, 0.5f}),
+        vector3_normalize({-0.6f, 0.2f, -0.7f}),
+    };
+
+    for (size_t i = 0; i < sizeof(normals) / sizeof(normals[0]); ++i)
+        check_hemicube(position, normals[i]);
+
+    return 0;
+}
@@ -76,7 +76,7 @@ static void create_multiplier_map_texture(float* pixels, unsigned size)
 float* create_distortion_texture(Allocator* alloc, unsigned width)
 {
     unsigned num_pixels = width*width;
-    unsigned size = num_pixels*sizeof(float);
+    size_t size = num_pixels*sizeof(float);
     float* pixels = (float*)alloc->alloc(size);
     memset(pixels, 0, size);
     create_multiplier_map_texture(pixels, width);
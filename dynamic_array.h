@@ -1,4 +1,5 @@
 #pragma once
+#include <stdint.h>
 
 struct Allocator;
 
@@ -7,20 +8,69 @@ struct DynamicArray
 {
     Allocator* allocator;
     T* data;
-    unsigned num;
-    unsigned capacity;
+    size_t num;
+    size_t capacity;
 
-    void grow()
+    void set_capacity(size_t new_capacity)
     {
+        Assert(new_capacity >= num && new_capacity <= SIZE_MAX / sizeof(T), "DynamicArray capacity overflow.");
+
+        // Arena allocators can often resize their latest allocation in place, which saves both the copy and
+        // the old block, which a temp allocator would otherwise keep until it goes out of scope.
+        if (allocator->try_extend(data, new_capacity * sizeof(T)))
+        {
+            capacity = new_capacity;
+            return;
+        }
+
         T* old_data = data;
-        unsigned new_capacity = max(capacity * 2, num + 5);
         data = (T*)allocator->alloc(new_capacity * sizeof(T));
         memcpy(data, old_data, num * sizeof(T));
         allocator->dealloc(old_data);
         capacity = new_capacity;
     }
 
-    void insert(const T&v, unsigned i)
+    void grow()
+    {
+        size_t new_capacity = capacity * 2 > num + 5 ? capacity * 2 : num + 5;
+        Assert(new_capacity > capacity, "DynamicArray capacity overflow.");
+        set_capacity(new_capacity);
+    }
+
+    void reserve(size_t n)
+    {
+        if (n > capacity)
+            set_capacity(n);
+    }
+
+    // New elements are zeroed.
+    void resize(size_t n)
+    {
+        reserve(n);
+
+        if (n > num)
+            memset(data + num, 0, (n - num) * sizeof(T));
+
+        num = n;
+    }
+
+    void shrink_to_fit()
+    {
+        if (data == nullptr || num == capacity)
+            return;
+
+        if (num == 0)
+        {
+            allocator->dealloc(data);
+            data = nullptr;
+            capacity = 0;
+            return;
+        }
+
+        set_capacity(num);
+    }
+
+    void insert(const T&v, size_t i)
     {
         while (data == nullptr || num == capacity || i + 1 > capacity)
             grow();
@@ -47,7 +97,7 @@ struct DynamicArray
         return p;
     }
 
-    void remove(unsigned i)
+    void remove(size_t i)
     {
         if (num == 1 || (num > 1 && i == num - 1))
         {
@@ -83,12 +133,12 @@ struct DynamicArray
         return data[num - 1];
     }
 
-    T& operator[](unsigned i)
+    T& operator[](size_t i)
     {
         return data[i];
     }
 
-    const T& operator[](unsigned i) const
+    const T& operator[](size_t i) const
     {
         return data[i];
     }
@@ -2,6 +2,19 @@
 #include <stdio.h>
 #include "memory.h"
 
+#if defined(_WIN32)
+    #include <windows.h>
+    #define file_seek _fseeki64
+    #define file_tell _ftelli64
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define file_seek fseeko
+    #define file_tell ftello
+#endif
+
 LoadedFile file_load(Allocator* alloc, const char* filename)
 {
     FILE* file_handle = fopen(filename, "rb");
@@ -9,17 +22,24 @@ LoadedFile file_load(Allocator* alloc, const char* filename)
     if (file_handle == nullptr)
         return {false};
 
-    fseek(file_handle, 0, SEEK_END);
-    unsigned filesize = ftell(file_handle);
-    fseek(file_handle, 0, SEEK_SET);
+    file_seek(file_handle, 0, SEEK_END);
+    long long tell = file_tell(file_handle);
+    file_seek(file_handle, 0, SEEK_SET);
 
-    if (filesize == 0)
+    if (tell <= 0)
+    {
+        fclose(file_handle);
         return {false};
+    }
 
-    unsigned char* data = (unsigned char*)alloc->alloc(unsigned(filesize));
+    size_t filesize = size_t(tell);
+    unsigned char* data = (unsigned char*)alloc->alloc(filesize);
 
     if (data == nullptr)
+    {
+        fclose(file_handle);
         return {false};
+    }
 
     fread(data, 1, filesize, file_handle);
     fclose(file_handle);
@@ -29,7 +49,7 @@ LoadedFile file_load(Allocator* alloc, const char* filename)
     return {true, file};
 }
 
-bool file_write(void* data, unsigned size, const char* filename)
+bool file_write(void* data, size_t size, const char* filename)
 {
     FILE* file_handle = fopen(filename, "wb");
 
@@ -40,3 +60,113 @@ bool file_write(void* data, unsigned size, const char* filename)
     fclose(file_handle);
     return true;
 }
+
+#if defined(_WIN32)
+
+FileInfo file_info(const char* filename)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+    if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &attributes))
+        return {false};
+
+    FileInfo fi = {};
+    fi.valid = true;
+    fi.size = (size_t)(((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow);
+    fi.modified_time = (long long)(((unsigned long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+    return fi;
+}
+
+LoadedFile file_map(const char* filename)
+{
+    HANDLE file_handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file_handle == INVALID_HANDLE_VALUE)
+        return {false};
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file_handle, &size) || size.QuadPart <= 0)
+    {
+        CloseHandle(file_handle);
+        return {false};
+    }
+
+    HANDLE mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file_handle);
+
+    if (mapping_handle == nullptr)
+        return {false};
+
+    // The view keeps the mapping alive, so the handle can be closed right away.
+    void* data = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping_handle);
+
+    if (data == nullptr)
+        return {false};
+
+    File file = {};
+    file.data = (unsigned char*)data;
+    file.size = (size_t)size.QuadPart;
+    return {true, file};
+}
+
+void file_unmap(File* file)
+{
+    UnmapViewOfFile(file->data);
+    file->data = nullptr;
+    file->size = 0;
+}
+
+#else
+
+FileInfo file_info(const char* filename)
+{
+    struct stat st;
+
+    if (stat(filename, &st) != 0)
+        return {false};
+
+    FileInfo fi = {};
+    fi.valid = true;
+    fi.size = (size_t)st.st_size;
+    fi.modified_time = (long long)st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+    return fi;
+}
+
+LoadedFile file_map(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+
+    if (fd == -1)
+        return {false};
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return {false};
+    }
+
+    // The mapping keeps the file open, so the descriptor can be closed right away.
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return {false};
+
+    File file = {};
+    file.data = (unsigned char*)data;
+    file.size = (size_t)st.st_size;
+    return {true, file};
+}
+
+void file_unmap(File* file)
+{
+    munmap(file->data, file->size);
+    file->data = nullptr;
+    file->size = 0;
+}
+
+#endif
@@ -1,11 +1,12 @@
 #pragma once
+#include <stddef.h>
 
 struct Allocator;
 
 struct File
 {
     unsigned char* data;
-    unsigned size;
+    size_t size;
 };
 
 struct LoadedFile
@@ -14,5 +15,17 @@ struct LoadedFile
     File file;
 };
 
+struct FileInfo
+{
+    bool valid;
+    size_t size;
+    long long modified_time;
+};
+
 LoadedFile file_load(Allocator* alloc, const char* filename);
-bool file_write(void* data, unsigned size, const char* filename);
+bool file_write(void* data, size_t size, const char* filename);
+FileInfo file_info(const char* filename);
+
+// Maps the file read-only into memory instead of reading it, pages are loaded on first access.
+LoadedFile file_map(const char* filename);
+void file_unmap(File* file);
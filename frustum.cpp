@@ -0,0 +1,77 @@
+#include "frustum.h"
+
+// Clip space coordinates are v * view_projection, so each of them is the dot product of v with a column.
+static Vector4 column(const Matrix4x4& m, unsigned i)
+{
+    const float* x = &m.x.x;
+    const float* y = &m.y.x;
+    const float* z = &m.z.x;
+    const float* w = &m.w.x;
+    return {x[i], y[i], z[i], w[i]};
+}
+
+static void set_plane(Frustum* f, unsigned i, const Vector4& p)
+{
+    f->nx[i] = p.x;
+    f->ny[i] = p.y;
+    f->nz[i] = p.z;
+    f->d[i] = p.w;
+}
+
+Frustum frustum_from_view_projection(const Matrix4x4& view_projection, float ndc_left, float ndc_right, float ndc_bottom, float ndc_top)
+{
+    Vector4 cx = column(view_projection, 0);
+    Vector4 cy = column(view_projection, 1);
+    Vector4 cz = column(view_projection, 2);
+    Vector4 cw = column(view_projection, 3);
+
+    Frustum f = {};
+    set_plane(&f, 0, cx - cw * ndc_left);
+    set_plane(&f, 1, cw * ndc_right - cx);
+    set_plane(&f, 2, cy - cw * ndc_bottom);
+    set_plane(&f, 3, cw * ndc_top - cy);
+    set_plane(&f, 4, cz);
+    set_plane(&f, 5, cw - cz);
+
+    for (unsigned i = 6; i < FrustumNumPlanes; ++i)
+        set_plane(&f, i, {0, 0, 0, 1});
+
+    return f;
+}
+
+// The box is outside a plane if even its corner furthest along the plane normal is behind it. That corner is
+// the center plus the extents with the signs of the normal, so its distance is n.center + |n|.extents + d.
+bool frustum_intersects_aabb(const Frustum& f, const Aabb& box)
+{
+    Vector3 center = (box.min + box.max) * 0.5f;
+    Vector3 extents = (box.max - box.min) * 0.5f;
+
+    #if defined(MATH_USE_SSE)
+        __m128 sign_mask = _mm_set1_ps(-0.0f);
+        __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+        __m128 ex = _mm_set1_ps(extents.x), ey = _mm_set1_ps(extents.y), ez = _mm_set1_ps(extents.z);
+        __m128 outside = _mm_setzero_ps();
+
+        for (unsigned i = 0; i < FrustumNumPlanes; i += 4)
+        {
+            __m128 nx = _mm_loadu_ps(f.nx + i), ny = _mm_loadu_ps(f.ny + i), nz = _mm_loadu_ps(f.nz + i);
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_loadu_ps(f.d + i)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, nx), ex), _mm_mul_ps(_mm_andnot_ps(sign_mask, ny), ey)),
+                _mm_mul_ps(_mm_andnot_ps(sign_mask, nz), ez));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+        }
+
+        return _mm_movemask_ps(outside) == 0;
+    #else
+        for (unsigned i = 0; i < FrustumNumPlanes; ++i)
+        {
+            float dist = f.nx[i] * center.x + f.ny[i] * center.y + f.nz[i] * center.z + f.d[i];
+            float radius = fabsf(f.nx[i]) * extents.x + fabsf(f.ny[i]) * extents.y + fabsf(f.nz[i]) * extents.z;
+
+            if (dist + radius < 0)
+                return false;
+        }
+
+        return true;
+    #endif
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "math.h"
+
+// Planes are stored a component per array so that four of them are tested at once. The six planes of the
+// frustum are padded to two groups of four with planes that nothing is outside of. A point p is inside a plane
+// when n.p + d >= 0.
+const unsigned FrustumNumPlanes = 8;
+
+struct Frustum
+{
+    float nx[FrustumNumPlanes];
+    float ny[FrustumNumPlanes];
+    float nz[FrustumNumPlanes];
+    float d[FrustumNumPlanes];
+};
+
+// The world space volume that view_projection maps into the rectangle [ndc_left, ndc_right] x [ndc_bottom,
+// ndc_top] of normalized device coordinates, between the near and far planes. -1, 1, -1, 1 is the whole view,
+// smaller rectangles give the frustum of a scissor rect. Depth is D3D style, 0 to w.
+Frustum frustum_from_view_projection(const Matrix4x4& view_projection, float ndc_left, float ndc_right, float ndc_bottom, float ndc_top);
+
+// Conservative, boxes that are outside the frustum but not entirely outside any single plane of it, like ones
+// near its corners, count as intersecting.
+bool frustum_intersects_aabb(const Frustum& f, const Aabb& box);
@@ -0,0 +1,56 @@
+#include <assert.h>
+#include "helpers.h"
+#include "math.cpp"
+#include "camera.cpp"
+#include "frustum.cpp"
+
+static Aabb box_at(const Vector3& center, float half_size)
+{
+    Vector3 e = {half_size, half_size, half_size};
+    return {center - e, center + e};
+}
+
+int main()
+{
+    // The camera is at the origin looking down +z with a 90 degree field of view.
+    Camera camera = camera_create_projection();
+    Matrix4x4 view_projection = camera_calc_view_matrix(camera) * camera.projection_matrix;
+
+    {
+        Frustum f = frustum_from_view_projection(view_projection, -1, 1, -1, 1);
+        assert(frustum_intersects_aabb(f, box_at({0, 0, 5}, 0.5f)));
+        assert(!frustum_intersects_aabb(f, box_at({0, 0, -5}, 0.5f)));
+        assert(!frustum_intersects_aabb(f, box_at({100, 0, 5}, 0.5f)));
+        assert(!frustum_intersects_aabb(f, box_at({0, -100, 5}, 0.5f)));
+        assert(!frustum_intersects_aabb(f, box_at({0, 0, 2000}, 0.5f)));
+
+        // Crosses the side plane, and surrounds the camera.
+        assert(frustum_intersects_aabb(f, box_at({5.4f, 0, 5}, 0.5f)));
+        assert(frustum_intersects_aabb(f, box_at({0, 0, 0}, 0.5f)));
+    }
+
+    {
+        // Right half of the view.
+        Frustum f = frustum_from_view_projection(view_projection, 0, 1, -1, 1);
+        assert(frustum_intersects_aabb(f, box_at({2, 0, 5}, 0.5f)));
+        assert(!frustum_intersects_aabb(f, box_at({-2, 0, 5}, 0.5f)));
+        assert(frustum_intersects_aabb(f, box_at({-0.4f, 0, 5}, 0.5f)));
+    }
+
+    {
+        // Top half of the view.
+        Frustum f = frustum_from_view_projection(view_projection, -1, 1, 0, 1);
+        assert(frustum_intersects_aabb(f, box_at({0, 2, 5}, 0.5f)));
+        assert(!frustum_intersects_aabb(f, box_at({0, -2, 5}, 0.5f)));
+    }
+
+    {
+        // A scissor rect covering the middle tenth of the view.
+        Frustum f = frustum_from_view_projection(view_projection, -0.1f, 0.1f, -0.1f, 0.1f);
+        assert(frustum_intersects_aabb(f, box_at({0, 0, 50}, 0.5f)));
+        assert(!frustum_intersects_aabb(f, box_at({3, 0, 5}, 0.5f)));
+        assert(!frustum_intersects_aabb(f, box_at({0, 3, 5}, 0.5f)));
+    }
+
+    return 0;
+}
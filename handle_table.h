@@ -0,0 +1,106 @@
+#pragma once
+#include <stddef.h>
+
+// Hands out handles to the slots of a fixed size array, allocating and freeing in O(1) through a free list of
+// slots. A handle packs the slot index with the generation of the slot, which is bumped whenever the slot is
+// freed, so a handle kept after its slot was freed no longer matches and is caught instead of silently referring
+// to whatever got the slot next. Generations skip 0, so no handle is ever InvalidHandle.
+//
+// The table doesn't own its memory, it lives in handle_table_memory_size(capacity) bytes given to
+// handle_table_create. What the slots hold is up to the user, usually an array indexed by handle_table_index.
+
+const unsigned HandleIndexBits = 20;
+const unsigned HandleIndexMask = (1u << HandleIndexBits) - 1;
+const unsigned HandleGenerationMask = (1u << (32 - HandleIndexBits)) - 1;
+const unsigned HandleTableMaxCapacity = HandleIndexMask + 1;
+
+// Values of HandleTable::next_free that aren't the index of the next free slot.
+const unsigned HandleSlotUsed = 0xffffffffu;
+const unsigned HandleFreeListEnd = 0xfffffffeu;
+
+struct HandleTable
+{
+    unsigned* generations;
+    unsigned* next_free;
+    unsigned capacity;
+    unsigned num_used;
+    unsigned first_free;
+};
+
+inline size_t handle_table_memory_size(unsigned capacity)
+{
+    return 2 * capacity * sizeof(unsigned);
+}
+
+inline HandleTable handle_table_create(void* memory, unsigned capacity)
+{
+    Assert(capacity <= HandleTableMaxCapacity, "Handle table capacity too large for the handle index bits.");
+    HandleTable ht = {};
+    ht.generations = (unsigned*)memory;
+    ht.next_free = ht.generations + capacity;
+    ht.capacity = capacity;
+    ht.first_free = capacity > 0 ? 0 : HandleFreeListEnd;
+
+    for (unsigned i = 0; i < capacity; ++i)
+    {
+        ht.generations[i] = 1;
+        ht.next_free[i] = i + 1 < capacity ? i + 1 : HandleFreeListEnd;
+    }
+
+    return ht;
+}
+
+inline unsigned handle_table_make_handle(unsigned index, unsigned generation)
+{
+    return (generation << HandleIndexBits) | index;
+}
+
+inline bool handle_table_full(const HandleTable& ht)
+{
+    return ht.num_used == ht.capacity;
+}
+
+inline bool handle_table_valid(const HandleTable& ht, unsigned handle)
+{
+    unsigned index = handle & HandleIndexMask;
+    return index < ht.capacity && ht.next_free[index] == HandleSlotUsed
+        && ht.generations[index] == handle >> HandleIndexBits;
+}
+
+// Returns InvalidHandle if the table is full.
+inline unsigned handle_table_alloc(HandleTable* ht)
+{
+    if (handle_table_full(*ht))
+        return InvalidHandle;
+
+    unsigned index = ht->first_free;
+    ht->first_free = ht->next_free[index];
+    ht->next_free[index] = HandleSlotUsed;
+    ++ht->num_used;
+    return handle_table_make_handle(index, ht->generations[index]);
+}
+
+inline void handle_table_free(HandleTable* ht, unsigned handle)
+{
+    Assert(handle_table_valid(*ht, handle), "Freeing a stale or invalid handle.");
+    unsigned index = handle & HandleIndexMask;
+    unsigned generation = (ht->generations[index] + 1) & HandleGenerationMask;
+    ht->generations[index] = generation == 0 ? 1 : generation;
+    ht->next_free[index] = ht->first_free;
+    ht->first_free = index;
+    --ht->num_used;
+}
+
+// The slot of a handle, which must be valid.
+inline unsigned handle_table_index(const HandleTable& ht, unsigned handle)
+{
+    Assert(handle_table_valid(ht, handle), "Using a stale or invalid handle.");
+    return handle & HandleIndexMask;
+}
+
+// The handle of the slot at index, or InvalidHandle if the slot is free. For walking all used slots.
+inline unsigned handle_table_handle_at(const HandleTable& ht, unsigned index)
+{
+    Assert(index < ht.capacity, "Handle table index out of bounds.");
+    return ht.next_free[index] == HandleSlotUsed ? handle_table_make_handle(index, ht.generations[index]) : InvalidHandle;
+}
@@ -0,0 +1,144 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "helpers.h"
+#include "handle_table.h"
+
+int main()
+{
+    {
+        const unsigned capacity = 4;
+        void* memory = malloc(handle_table_memory_size(capacity));
+        HandleTable ht = handle_table_create(memory, capacity);
+        unsigned handles[capacity];
+
+        for (unsigned i = 0; i < capacity; ++i)
+        {
+            handles[i] = handle_table_alloc(&ht);
+            assert(handles[i] != InvalidHandle);
+            assert(handle_table_valid(ht, handles[i]));
+
+            for (unsigned j = 0; j < i; ++j)
+                assert(handle_table_index(ht, handles[i]) != handle_table_index(ht, handles[j]));
+        }
+
+        assert(handle_table_full(ht));
+        assert(handle_table_alloc(&ht) == InvalidHandle);
+
+        // A freed slot is reused by the next alloc, but with a new generation.
+        unsigned index = handle_table_index(ht, handles[2]);
+        handle_table_free(&ht, handles[2]);
+        assert(!handle_table_valid(ht, handles[2]));
+        assert(handle_table_handle_at(ht, index) == InvalidHandle);
+        assert(!handle_table_full(ht));
+        unsigned reused = handle_table_alloc(&ht);
+        assert(reused != handles[2]);
+        assert(handle_table_index(ht, reused) == index);
+        assert(handle_table_handle_at(ht, index) == reused);
+        assert(!handle_table_valid(ht, handles[2]));
+        assert(handle_table_valid(ht, handles[1]));
+        handles[2] = reused;
+
+        for (unsigned i = 0; i < capacity; ++i)
+            handle_table_free(&ht, handles[i]);
+
+        assert(ht.num_used == 0);
+
+        for (unsigned i = 0; i < capacity; ++i)
+        {
+            assert(handle_table_handle_at(ht, i) == InvalidHandle);
+            assert(!handle_table_valid(ht, handles[i]));
+        }
+
+        free(memory);
+    }
+
+    {
+        // Handles that are out of range, or that were never handed out, are invalid.
+        const unsigned capacity = 8;
+        void* memory = malloc(handle_table_memory_size(capacity));
+        HandleTable ht = handle_table_create(memory, capacity);
+        assert(!handle_table_valid(ht, InvalidHandle));
+        assert(!handle_table_valid(ht, handle_table_make_handle(capacity, 1)));
+        assert(!handle_table_valid(ht, handle_table_make_handle(0, 1)));
+        unsigned h = handle_table_alloc(&ht);
+        assert(handle_table_valid(ht, h));
+        assert(!handle_table_valid(ht, handle_table_make_handle(handle_table_index(ht, h), 2)));
+        free(memory);
+    }
+
+    {
+        // Generations wrap around without ever making a handle equal to InvalidHandle.
+        void* memory = malloc(handle_table_memory_size(1));
+        HandleTable ht = handle_table_create(memory, 1);
+        unsigned first = handle_table_alloc(&ht);
+        handle_table_free(&ht, first);
+
+        for (unsigned i = 0; i < HandleGenerationMask + 2; ++i)
+        {
+            unsigned h = handle_table_alloc(&ht);
+            assert(h != InvalidHandle);
+            assert(handle_table_index(ht, h) == 0);
+            handle_table_free(&ht, h);
+        }
+
+        free(memory);
+    }
+
+    {
+        // Churn against a shadow array of which handles are live.
+        const unsigned capacity = 1000;
+        void* memory = malloc(handle_table_memory_size(capacity));
+        HandleTable ht = handle_table_create(memory, capacity);
+        unsigned* live = (unsigned*)calloc(capacity, sizeof(unsigned));
+        unsigned num_live = 0;
+        unsigned rng = 1;
+
+        for (unsigned step = 0; step < 100000; ++step)
+        {
+            rng = rng * 1664525u + 1013904223u;
+            unsigned slot = (rng >> 8) % capacity;
+
+            if (live[slot] == InvalidHandle)
+            {
+                unsigned h = handle_table_alloc(&ht);
+                assert(h != InvalidHandle);
+                live[slot] = h;
+                ++num_live;
+            }
+            else
+            {
+                unsigned h = live[slot];
+                handle_table_free(&ht, h);
+                assert(!handle_table_valid(ht, h));
+                live[slot] = InvalidHandle;
+                --num_live;
+            }
+
+            assert(ht.num_used == num_live);
+        }
+
+        unsigned num_walked = 0;
+
+        for (unsigned i = 0; i < capacity; ++i)
+        {
+            unsigned h = handle_table_handle_at(ht, i);
+
+            if (h != InvalidHandle)
+            {
+                assert(handle_table_valid(ht, h));
+                ++num_walked;
+            }
+        }
+
+        assert(num_walked == num_live);
+
+        for (unsigned i = 0; i < capacity; ++i)
+        {
+            if (live[i] != InvalidHandle)
+                assert(handle_table_valid(ht, live[i]));
+        }
+
+        free(live);
+        free(memory);
+    }
+}
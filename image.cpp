@@ -27,12 +27,12 @@ void image_init_data(Image* i, Allocator* alloc)
     i->data = (unsigned char*)alloc->alloc(image_size(i->pixel_format, i->width, i->height));
 }
 
-unsigned image_size(PixelFormat pf, unsigned size_x, unsigned size_y)
+size_t image_size(PixelFormat pf, unsigned size_x, unsigned size_y)
 {
-    return size_x * size_y * pixel_size(pf);
+    return size_t(size_x) * size_y * pixel_size(pf);
 }
 
-unsigned image_size(const Image& image)
+size_t image_size(const Image& image)
 {
     return image_size(image.pixel_format, image.width, image.height);
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 
 struct Allocator;
 
@@ -23,5 +24,5 @@ struct Image
 };
 
 void image_init_data(Image* i, Allocator* alloc);
-unsigned image_size(PixelFormat pf, unsigned size_x, unsigned size_y);
-unsigned image_size(const Image& image);
+size_t image_size(PixelFormat pf, unsigned size_x, unsigned size_y);
+size_t image_size(const Image& image);
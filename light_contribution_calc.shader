@@ -3,6 +3,9 @@ cbuffer ConstantBuffer : register(b0)
     float4x4 model_view_projection;
     float4x4 model;
     float4x4 projection;
+    float4 position_offset;
+    float4 position_scale;
+    float4x4 normal_model;
 };
 
 struct VOut
@@ -27,6 +30,19 @@ VOut VShader(float4 position : POSITION, float3 normal : NORMAL, float2 uv : TEX
     return output;
 }
 
+float3 oct_decode(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+VOut VShaderPacked(float4 position : POSITION, float2 normal : NORMAL, float2 uv : TEXCOORD, float4 color : COLOR)
+{
+    return VShader(float4(position_offset.xyz + position.xyz * position_scale.xyz, 1.0f), oct_decode(normal), uv, color);
+}
+
 Texture2D lightmap;
 SamplerState patch_offset_ss;
 
@@ -0,0 +1,416 @@
+#include "lightmap_uv.h"
+#include "memory.h"
+#include "mesh.h"
+
+// Triangles join a chart while their normal is within about 25 degrees of the normal of the first triangle in
+// it. Projection shrinks triangles by the cosine of that angle, so texel density varies by at most 10%.
+static const float ChartNormalConeCos = 0.9f;
+
+// Packing scale is found by bisection, this many steps gets within a fraction of a texel.
+static const unsigned PackingScaleSteps = 24;
+
+// Chart orientations tried in the quarter turn, the one with the smallest bounding rectangle is kept.
+static const unsigned ChartOrientations = 16;
+
+struct Chart
+{
+    Vector3 axis;
+    Vector3 u_axis;
+    Vector3 v_axis;
+    Vector2 min;
+    Vector2 max;
+    float x;
+    float y;
+};
+
+static unsigned hash_u64(unsigned long long k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    return (unsigned)k;
+}
+
+static size_t hash_capacity(size_t num)
+{
+    size_t capacity = 16;
+
+    while (capacity < num * 2)
+        capacity *= 2;
+
+    return capacity;
+}
+
+static Vector2 chart_size(const Chart& c)
+{
+    return {c.max.x - c.min.x, c.max.y - c.min.y};
+}
+
+static void chart_calc_bounds(Chart* c, const Vector3* positions, const unsigned* indices, const unsigned* chart_triangles,
+    size_t num_chart_triangles)
+{
+    const Vector3& first = positions[indices[chart_triangles[0] * 3]];
+    c->min = Vector2{vector3_dot(first, c->u_axis), vector3_dot(first, c->v_axis)};
+    c->max = c->min;
+
+    for (size_t i = 0; i < num_chart_triangles; ++i)
+    {
+        for (unsigned corner = 0; corner < 3; ++corner)
+        {
+            const Vector3& p = positions[indices[chart_triangles[i] * 3 + corner]];
+            float u = vector3_dot(p, c->u_axis);
+            float v = vector3_dot(p, c->v_axis);
+            c->min.x = u < c->min.x ? u : c->min.x;
+            c->min.y = v < c->min.y ? v : c->min.y;
+            c->max.x = u > c->max.x ? u : c->max.x;
+            c->max.y = v > c->max.y ? v : c->max.y;
+        }
+    }
+}
+
+// Shelf packing in texels, charts are expected sorted by height. Returns false if they don't fit at this scale.
+// Each chart is given whole texels, so that the padding texels between charts are never partly covered by either.
+static bool pack_charts(Chart* charts, const unsigned* order, size_t num_charts, float scale, float lightmap_size, float padding)
+{
+    float x = 0;
+    float y = 0;
+    float shelf_height = 0;
+
+    for (size_t i = 0; i < num_charts; ++i)
+    {
+        Chart& c = charts[order[i]];
+        Vector2 size = chart_size(c);
+        float w = ceilf(size.x * scale);
+        float h = ceilf(size.y * scale);
+
+        if (x + w > lightmap_size)
+        {
+            x = 0;
+            y += shelf_height;
+            shelf_height = 0;
+        }
+
+        if (x + w > lightmap_size || y + h > lightmap_size)
+            return false;
+
+        c.x = x;
+        c.y = y;
+        x += w + padding;
+        shelf_height = h + padding > shelf_height ? h + padding : shelf_height;
+    }
+
+    return true;
+}
+
+bool mesh_generate_lightmap_uvs(Allocator* alloc, Mesh* m, const Vector3& instance_scale, unsigned lightmap_size, unsigned padding,
+    LightmapUVStats* stats)
+{
+    Allocator ta = create_temp_allocator();
+    size_t num_vertices = m->vertices.num;
+    size_t num_triangles = m->indices.num / 3;
+    const unsigned* indices = m->indices.data;
+
+    if (num_triangles == 0)
+        return false;
+
+    // Charts grow across edges between triangles that share positions, also where the original uvs or normals
+    // were split, so vertices are first mapped to a canonical vertex with the same position.
+    unsigned* position_ids = (unsigned*)ta.alloc(num_vertices * sizeof(unsigned));
+    size_t positions_capacity = hash_capacity(num_vertices);
+    unsigned* positions = (unsigned*)ta.alloc(positions_capacity * sizeof(unsigned));
+    memset(positions, 0, positions_capacity * sizeof(unsigned));
+
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        const Vector3& p = m->vertices[v].position;
+        unsigned bits[3];
+        memcpy(bits, &p, sizeof(bits));
+        size_t slot = hash_u64(((unsigned long long)(bits[0] ^ hash_u64(bits[2])) << 32) | bits[1]) & (positions_capacity - 1);
+        position_ids[v] = (unsigned)v;
+
+        for (; positions[slot] != 0; slot = (slot + 1) & (positions_capacity - 1))
+        {
+            const Vector3& other = m->vertices[positions[slot] - 1].position;
+
+            if (other.x == p.x && other.y == p.y && other.z == p.z)
+            {
+                position_ids[v] = positions[slot] - 1;
+                break;
+            }
+        }
+
+        if (positions[slot] == 0)
+            positions[slot] = (unsigned)v + 1;
+    }
+
+    // neighbours[t * 3 + c] is the triangle across edge c of triangle t, or ~0u. Edges with more than two
+    // triangles only link the first two.
+    unsigned* neighbours = (unsigned*)ta.alloc(num_triangles * 3 * sizeof(unsigned));
+    memset(neighbours, 0xff, num_triangles * 3 * sizeof(unsigned));
+    size_t edges_capacity = hash_capacity(num_triangles * 3);
+    unsigned* edges = (unsigned*)ta.alloc(edges_capacity * sizeof(unsigned));
+    memset(edges, 0, edges_capacity * sizeof(unsigned));
+
+    for (size_t i = 0; i < num_triangles * 3; ++i)
+    {
+        unsigned a = position_ids[indices[i]];
+        unsigned b = position_ids[indices[i - i % 3 + (i + 1) % 3]];
+
+        if (a == b)
+            continue;
+
+        unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+        size_t slot = hash_u64(key) & (edges_capacity - 1);
+        bool linked = false;
+
+        for (; edges[slot] != 0; slot = (slot + 1) & (edges_capacity - 1))
+        {
+            size_t other = edges[slot] - 1;
+            unsigned oa = position_ids[indices[other]];
+            unsigned ob = position_ids[indices[other - other % 3 + (other + 1) % 3]];
+
+            if (!((oa == a && ob == b) || (oa == b && ob == a)))
+                continue;
+
+            if (neighbours[other] == ~0u)
+            {
+                neighbours[other] = (unsigned)(i / 3);
+                neighbours[i] = (unsigned)(other / 3);
+            }
+
+            linked = true;
+            break;
+        }
+
+        if (!linked)
+            edges[slot] = (unsigned)i + 1;
+    }
+
+    // Charts are made from here on in scaled space, only the uvs end up in the mesh.
+    Vector3* scaled = (Vector3*)ta.alloc(num_vertices * sizeof(Vector3));
+
+    for (size_t v = 0; v < num_vertices; ++v)
+        scaled[v] = m->vertices[v].position * instance_scale;
+
+    Vector3* normals = (Vector3*)ta.alloc(num_triangles * sizeof(Vector3));
+
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        const Vector3& p0 = scaled[indices[t * 3]];
+        Vector3 n = vector3_cross(scaled[indices[t * 3 + 1]] - p0, scaled[indices[t * 3 + 2]] - p0);
+        float len = vector3_length(n);
+        normals[t] = len > 0 ? n * (1.0f / len) : Vector3{0, 0, 0};
+    }
+
+    // Segmentation by flood fill from the first triangle without a chart.
+    unsigned* chart_of_triangle = (unsigned*)ta.alloc(num_triangles * sizeof(unsigned));
+    memset(chart_of_triangle, 0xff, num_triangles * sizeof(unsigned));
+    unsigned* triangles_by_chart = (unsigned*)ta.alloc(num_triangles * sizeof(unsigned));
+    unsigned* chart_starts = (unsigned*)ta.alloc((num_triangles + 1) * sizeof(unsigned));
+    DynamicArray<Chart> charts = dynamic_array_create<Chart>(&ta);
+    size_t num_assigned = 0;
+
+    for (size_t seed = 0; seed < num_triangles; ++seed)
+    {
+        if (chart_of_triangle[seed] != ~0u)
+            continue;
+
+        unsigned chart_index = (unsigned)charts.num;
+        Chart* c = charts.push();
+        memset(c, 0, sizeof(Chart));
+        bool degenerate_seed = normals[seed].x == 0 && normals[seed].y == 0 && normals[seed].z == 0;
+        c->axis = degenerate_seed ? Vector3{0, 0, 1} : normals[seed];
+
+        // (u_axis, v_axis, axis) is right handed, so triangles facing the axis keep their winding in uv space.
+        c->v_axis = vector3_tangent(c->axis);
+        c->u_axis = vector3_bitangent(c->axis);
+
+        chart_starts[chart_index] = (unsigned)num_assigned;
+        chart_of_triangle[seed] = chart_index;
+        triangles_by_chart[num_assigned++] = (unsigned)seed;
+
+        // triangles_by_chart doubles as the flood fill queue.
+        for (size_t q = chart_starts[chart_index]; q < num_assigned; ++q)
+        {
+            unsigned t = triangles_by_chart[q];
+
+            for (unsigned e = 0; e < 3; ++e)
+            {
+                unsigned n = neighbours[t * 3 + e];
+
+                if (n == ~0u || chart_of_triangle[n] != ~0u)
+                    continue;
+
+                const Vector3& nn = normals[n];
+                bool degenerate = nn.x == 0 && nn.y == 0 && nn.z == 0;
+
+                if (!degenerate && vector3_dot(nn, c->axis) < ChartNormalConeCos)
+                    continue;
+
+                chart_of_triangle[n] = chart_index;
+                triangles_by_chart[num_assigned++] = n;
+            }
+        }
+    }
+
+    size_t num_charts = charts.num;
+    chart_starts[num_charts] = (unsigned)num_assigned;
+
+    for (size_t ci = 0; ci < num_charts; ++ci)
+    {
+        Chart& c = charts[ci];
+        const unsigned* chart_triangles = triangles_by_chart + chart_starts[ci];
+        size_t num_chart_triangles = chart_starts[ci + 1] - chart_starts[ci];
+        Vector3 u_axis = c.u_axis;
+        Vector3 v_axis = c.v_axis;
+        float best_area = -1;
+        Chart best = c;
+
+        // Rotating the projection axes around the chart axis keeps them right handed.
+        for (unsigned o = 0; o < ChartOrientations; ++o)
+        {
+            float angle = (PI / 2) * (float)o / (float)ChartOrientations;
+            c.u_axis = u_axis * cosf(angle) + v_axis * sinf(angle);
+            c.v_axis = v_axis * cosf(angle) - u_axis * sinf(angle);
+            chart_calc_bounds(&c, scaled, indices, chart_triangles, num_chart_triangles);
+            Vector2 size = chart_size(c);
+
+            if (best_area < 0 || size.x * size.y < best_area)
+            {
+                best_area = size.x * size.y;
+                best = c;
+            }
+        }
+
+        c = best;
+
+        // Shelves waste less space when charts lie down, a quarter turn keeps the winding.
+        if (c.max.y - c.min.y > c.max.x - c.min.x)
+        {
+            Vector3 u = c.u_axis;
+            c.u_axis = c.v_axis;
+            c.v_axis = -u;
+            chart_calc_bounds(&c, scaled, indices, chart_triangles, num_chart_triangles);
+        }
+    }
+
+    // Tallest charts first, insertion sort is fine for the chart counts lightmapped meshes have.
+    unsigned* order = (unsigned*)ta.alloc(num_charts * sizeof(unsigned));
+    float max_extent = 0;
+
+    for (size_t i = 0; i < num_charts; ++i)
+    {
+        Vector2 size = chart_size(charts[i]);
+        max_extent = size.x > max_extent ? size.x : max_extent;
+        size_t j = i;
+
+        while (j > 0 && chart_size(charts[order[j - 1]]).y < size.y)
+        {
+            order[j] = order[j - 1];
+            --j;
+        }
+
+        order[j] = (unsigned)i;
+    }
+
+    float size_in_texels = (float)lightmap_size;
+    float padding_in_texels = (float)padding;
+
+    if (max_extent == 0 || !pack_charts(charts.data, order, num_charts, 0, size_in_texels, padding_in_texels))
+        return false;
+
+    float low = 0;
+    float high = size_in_texels / max_extent;
+
+    for (unsigned step = 0; step < PackingScaleSteps; ++step)
+    {
+        float mid = (low + high) * 0.5f;
+
+        if (pack_charts(charts.data, order, num_charts, mid, size_in_texels, padding_in_texels))
+            low = mid;
+        else
+            high = mid;
+    }
+
+    float scale = low;
+    pack_charts(charts.data, order, num_charts, scale, size_in_texels, padding_in_texels);
+
+    // New vertices are made chart by chart, vertex_chart tells which chart the current copy of a vertex is in.
+    Mesh result = mesh_create(alloc);
+    result.vertices.reserve(num_vertices);
+    result.indices.resize(num_triangles * 3);
+    unsigned* vertex_chart = (unsigned*)ta.alloc(num_vertices * sizeof(unsigned));
+    unsigned* vertex_copy = (unsigned*)ta.alloc(num_vertices * sizeof(unsigned));
+    memset(vertex_chart, 0xff, num_vertices * sizeof(unsigned));
+    float inv_size = 1.0f / size_in_texels;
+    float covered_area = 0;
+
+    for (size_t ci = 0; ci < num_charts; ++ci)
+    {
+        const Chart& c = charts[ci];
+
+        for (unsigned i = chart_starts[ci]; i < chart_starts[ci + 1]; ++i)
+        {
+            unsigned t = triangles_by_chart[i];
+            Vector2 uv[3];
+
+            for (unsigned corner = 0; corner < 3; ++corner)
+            {
+                unsigned v = indices[t * 3 + corner];
+
+                if (vertex_chart[v] != ci)
+                {
+                    Vertex nv = m->vertices[v];
+                    float u = vector3_dot(scaled[v], c.u_axis) - c.min.x;
+                    float w = vector3_dot(scaled[v], c.v_axis) - c.min.y;
+                    nv.uv = {(c.x + u * scale) * inv_size, (c.y + w * scale) * inv_size};
+                    vertex_chart[v] = (unsigned)ci;
+                    vertex_copy[v] = (unsigned)result.vertices.num;
+                    result.vertices.add(nv);
+                }
+
+                result.indices[t * 3 + corner] = vertex_copy[v];
+                uv[corner] = result.vertices[vertex_copy[v]].uv;
+            }
+
+            covered_area += ((uv[1].x - uv[0].x) * (uv[2].y - uv[0].y) - (uv[1].y - uv[0].y) * (uv[2].x - uv[0].x)) * 0.5f;
+        }
+    }
+
+    if (stats != nullptr)
+    {
+        stats->num_charts = (unsigned)num_charts;
+        stats->coverage = covered_area;
+    }
+
+    mesh_destroy(m);
+    *m = result;
+    return true;
+}
+
+LightmapScaleKey lightmap_scale_key(const Vector3& scale)
+{
+    float axes[3] = {fabsf(scale.x), fabsf(scale.y), fabsf(scale.z)};
+    float largest = axes[0] > axes[1] ? axes[0] : axes[1];
+    largest = axes[2] > largest ? axes[2] : largest;
+    LightmapScaleKey key = {};
+
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        int step = LightmapScaleMinStep;
+
+        if (axes[i] > 0)
+            step = (int)floorf(log2f(axes[i] / largest) * (float)LightmapScaleStepsPerOctave + 0.5f);
+
+        key.steps[i] = (signed char)(step > LightmapScaleMinStep ? step : LightmapScaleMinStep);
+    }
+
+    return key;
+}
+
+Vector3 lightmap_scale_from_key(const LightmapScaleKey& key)
+{
+    float octaves_per_step = 1.0f / LightmapScaleStepsPerOctave;
+    return {exp2f((float)key.steps[0] * octaves_per_step), exp2f((float)key.steps[1] * octaves_per_step),
+        exp2f((float)key.steps[2] * octaves_per_step)};
+}
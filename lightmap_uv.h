@@ -0,0 +1,52 @@
+#pragma once
+
+struct Allocator;
+struct Mesh;
+struct Vector3;
+
+const unsigned LightmapSize = 64;
+
+// Texels left empty between charts, so that lightmap texels never belong to more than one chart.
+const unsigned LightmapChartPadding = 1;
+
+struct LightmapUVStats
+{
+    unsigned num_charts;
+
+    // Fraction of the lightmap texels covered by charts, padding excluded.
+    float coverage;
+};
+
+// Replaces the uvs of the mesh with lightmap uvs. Triangles are grouped into charts of connected triangles whose
+// normals lie within a cone, each chart is projected onto the plane facing the cone axis, and the charts are
+// packed into a lightmap_size square lightmap with padding texels between them, scaled to fill it. Charts start
+// on whole texels. Vertices are duplicated where they are shared by several charts. Returns false, leaving the
+// mesh untouched, if the charts don't fit.
+//
+// Charts are made for the mesh as it is when scaled by instance_scale, so that instances drawn with that scale get
+// the same texel density on all their sides. Rotation and translation don't change it.
+bool mesh_generate_lightmap_uvs(Allocator* alloc, Mesh* m, const Vector3& instance_scale, unsigned lightmap_size, unsigned padding,
+    LightmapUVStats* stats = nullptr);
+
+// Instances only share geometry if they share lightmap uvs, so instance scales are rounded before charts are made
+// for them. Charts only depend on the ratios between the axes, so each axis is rounded to a whole number of
+// LightmapScaleStepsPerOctave steps below the largest one, and at most LightmapScaleMinStep steps below it. Axes
+// are then within a quarter octave of what the charts were made for, which keeps texel density within a factor of
+// about 1.41 between the sides of an instance.
+const int LightmapScaleStepsPerOctave = 2;
+const int LightmapScaleMinStep = -16;
+
+struct LightmapScaleKey
+{
+    signed char steps[3];
+};
+
+LightmapScaleKey lightmap_scale_key(const Vector3& scale);
+
+// The scale that charts for key are made for, its largest axis is 1.
+Vector3 lightmap_scale_from_key(const LightmapScaleKey& key);
+
+inline bool lightmap_scale_key_equal(const LightmapScaleKey& a, const LightmapScaleKey& b)
+{
+    return a.steps[0] == b.steps[0] && a.steps[1] == b.steps[1] && a.steps[2] == b.steps[2];
+}
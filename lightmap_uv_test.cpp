@@ -0,0 +1,226 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "helpers.h"
+#include "memory.cpp"
+#include "math.cpp"
+#include "lightmap_uv.cpp"
+
+// A unit cube around the origin with 4 vertices per side, like box.wobj.
+static Mesh create_box(Allocator* alloc)
+{
+    Mesh m = mesh_create(alloc);
+    Vector3 sides[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+    for (unsigned s = 0; s < 6; ++s)
+    {
+        Vector3 n = sides[s];
+        Vector3 u = vector3_tangent(n);
+        Vector3 v = vector3_cross(n, u);
+        unsigned first = (unsigned)m.vertices.num;
+        Vector2 corners[] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+
+        for (unsigned c = 0; c < 4; ++c)
+        {
+            Vertex vertex = {};
+            vertex.position = (n + u * corners[c].x + v * corners[c].y) * 0.5f;
+            vertex.normal = n;
+            m.vertices.add(vertex);
+        }
+
+        unsigned indices[] = {0, 1, 2, 0, 2, 3};
+
+        for (unsigned i = 0; i < 6; ++i)
+            m.indices.add(first + indices[i]);
+    }
+
+    return m;
+}
+
+static float triangle_area(const Vector3& a, const Vector3& b, const Vector3& c)
+{
+    return vector3_length(vector3_cross(b - a, c - a)) * 0.5f;
+}
+
+static float uv_area(const Vector2& a, const Vector2& b, const Vector2& c)
+{
+    return fabsf((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x)) * 0.5f;
+}
+
+// Charts are the groups of triangles that share vertices, generation duplicates vertices between charts.
+static unsigned find_root(unsigned* parents, unsigned i)
+{
+    while (parents[i] != i)
+        i = parents[i] = parents[parents[i]];
+
+    return i;
+}
+
+// Charts are made for chart_scale and the box is drawn with scale, the sides then differ in texel density by at
+// most max_density_ratio.
+static void check_lightmap_uvs(const Vector3& scale, const Vector3& chart_scale, float max_density_ratio)
+{
+    const unsigned lightmap_size = 64;
+    Allocator ta = create_temp_allocator();
+    Mesh m = create_box(&ta);
+    LightmapUVStats stats = {};
+    assert(mesh_generate_lightmap_uvs(&ta, &m, chart_scale, lightmap_size, LightmapChartPadding, &stats));
+    assert(stats.num_charts == 6);
+    assert(m.indices.num == 36);
+
+    unsigned* parents = (unsigned*)ta.alloc(m.vertices.num * sizeof(unsigned));
+
+    for (unsigned i = 0; i < m.vertices.num; ++i)
+        parents[i] = i;
+
+    for (size_t i = 0; i < m.indices.num; i += 3)
+    {
+        parents[find_root(parents, m.indices[i + 1])] = find_root(parents, m.indices[i]);
+        parents[find_root(parents, m.indices[i + 2])] = find_root(parents, m.indices[i]);
+    }
+
+    // Texel rectangle of each chart, in vertex order of their roots.
+    float* rects = (float*)ta.alloc(m.vertices.num * 4 * sizeof(float));
+
+    for (unsigned i = 0; i < m.vertices.num; ++i)
+    {
+        rects[i * 4] = rects[i * 4 + 1] = (float)lightmap_size;
+        rects[i * 4 + 2] = rects[i * 4 + 3] = 0;
+    }
+
+    for (unsigned i = 0; i < m.vertices.num; ++i)
+    {
+        Vector2 uv = m.vertices[i].uv;
+        assert(uv.x >= 0 && uv.x <= 1 && uv.y >= 0 && uv.y <= 1);
+        float* r = rects + find_root(parents, i) * 4;
+        float x = uv.x * (float)lightmap_size;
+        float y = uv.y * (float)lightmap_size;
+        r[0] = x < r[0] ? x : r[0];
+        r[1] = y < r[1] ? y : r[1];
+        r[2] = x > r[2] ? x : r[2];
+        r[3] = y > r[3] ? y : r[3];
+    }
+
+    unsigned num_charts = 0;
+
+    for (unsigned i = 0; i < m.vertices.num; ++i)
+    {
+        if (find_root(parents, i) != i)
+            continue;
+
+        ++num_charts;
+        const float* a = rects + i * 4;
+
+        // Charts start on whole texels.
+        assert(fabsf(a[0] - roundf(a[0])) < 0.001f && fabsf(a[1] - roundf(a[1])) < 0.001f);
+
+        // No texel is touched by two charts, and there are padding texels between them.
+        for (unsigned j = i + 1; j < m.vertices.num; ++j)
+        {
+            if (find_root(parents, j) != j)
+                continue;
+
+            const float* b = rects + j * 4;
+            float pad = (float)LightmapChartPadding;
+            bool apart = ceilf(a[2] - 0.001f) + pad <= b[0] + 0.001f || ceilf(b[2] - 0.001f) + pad <= a[0] + 0.001f
+                || ceilf(a[3] - 0.001f) + pad <= b[1] + 0.001f || ceilf(b[3] - 0.001f) + pad <= a[1] + 0.001f;
+            assert(apart);
+        }
+    }
+
+    assert(num_charts == 6);
+
+    // Every side of the scaled box gets as many texels per area.
+    float min_density = 0;
+    float max_density = 0;
+
+    for (size_t i = 0; i < m.indices.num; i += 3)
+    {
+        const Vertex& a = m.vertices[m.indices[i]];
+        const Vertex& b = m.vertices[m.indices[i + 1]];
+        const Vertex& c = m.vertices[m.indices[i + 2]];
+        float density = uv_area(a.uv, b.uv, c.uv) / triangle_area(a.position * scale, b.position * scale, c.position * scale);
+        min_density = i == 0 || density < min_density ? density : min_density;
+        max_density = i == 0 || density > max_density ? density : max_density;
+    }
+
+    assert(min_density > 0 && max_density < min_density * max_density_ratio);
+    mesh_destroy(&m);
+}
+
+int main()
+{
+    const size_t temp_memory_size = 4 * 1024 * 1024;
+    void* temp_memory_block = malloc(temp_memory_size);
+    temp_memory_blob_init(temp_memory_block, temp_memory_size);
+
+    check_lightmap_uvs({1, 1, 1}, {1, 1, 1}, 1.001f);
+
+    // The floor of the test world and its pillars.
+    check_lightmap_uvs({6, 0.3f, 8}, {6, 0.3f, 8}, 1.001f);
+    check_lightmap_uvs({0.4f, 2, 0.4f}, {0.4f, 2, 0.4f}, 1.001f);
+    check_lightmap_uvs({0.2f, 1.5f, 0.9f}, {0.2f, 1.5f, 0.9f}, 1.001f);
+
+    {
+        // Keys only depend on the ratios between the axes and steps are half octaves below the largest one.
+        LightmapScaleKey unit = {};
+        assert(lightmap_scale_key_equal(lightmap_scale_key({3, 3, 3}), unit));
+        LightmapScaleKey floor = lightmap_scale_key({6, 0.3f, 8});
+        assert(floor.steps[0] == -1 && floor.steps[1] == -9 && floor.steps[2] == 0);
+        assert(lightmap_scale_key_equal(lightmap_scale_key({12, 0.6f, 16}), floor));
+        assert(lightmap_scale_key_equal(lightmap_scale_key({-6, 0.3f, -8}), floor));
+        LightmapScaleKey flat = lightmap_scale_key({1, 0, 1e-9f});
+        assert(flat.steps[0] == 0 && flat.steps[1] == LightmapScaleMinStep && flat.steps[2] == LightmapScaleMinStep);
+        Vector3 floor_scale = lightmap_scale_from_key(floor);
+        assert(floor_scale.z == 1 && fabsf(floor_scale.x - 0.70710678f) < 1e-6f && fabsf(floor_scale.y - 1.0f / 22.627417f) < 1e-6f);
+    }
+
+    {
+        // Boxes of random shape drawn with charts made for their key have sides within the density bound of
+        // lightmap_uv.h, which is a quarter octave on each of two axes.
+        unsigned rng = 7;
+
+        for (unsigned i = 0; i < 64; ++i)
+        {
+            Vector3 scale;
+            float* axes = &scale.x;
+
+            for (unsigned a = 0; a < 3; ++a)
+            {
+                rng = rng * 1664525u + 1013904223u;
+                axes[a] = 0.05f + 4 * (float)(rng >> 8) / (float)(1 << 24);
+            }
+
+            check_lightmap_uvs(scale, lightmap_scale_from_key(lightmap_scale_key(scale)), 1.4143f);
+        }
+    }
+
+    {
+        // The thin sides of a scaled floor get fewer texels than if the charts were made for the unit box.
+        Allocator ta = create_temp_allocator();
+        Mesh unit = create_box(&ta);
+        Mesh floor = create_box(&ta);
+        assert(mesh_generate_lightmap_uvs(&ta, &unit, {1, 1, 1}, 64, LightmapChartPadding));
+        assert(mesh_generate_lightmap_uvs(&ta, &floor, {6, 0.3f, 8}, 64, LightmapChartPadding));
+        float unit_side = 0;
+        float floor_side = 0;
+
+        for (size_t i = 0; i < unit.indices.num; i += 3)
+        {
+            if (fabsf(unit.vertices[unit.indices[i]].normal.x) == 1)
+                unit_side += uv_area(unit.vertices[unit.indices[i]].uv, unit.vertices[unit.indices[i + 1]].uv, unit.vertices[unit.indices[i + 2]].uv);
+        }
+
+        for (size_t i = 0; i < floor.indices.num; i += 3)
+        {
+            if (fabsf(floor.vertices[floor.indices[i]].normal.x) == 1)
+                floor_side += uv_area(floor.vertices[floor.indices[i]].uv, floor.vertices[floor.indices[i + 1]].uv, floor.vertices[floor.indices[i + 2]].uv);
+        }
+
+        assert(floor_side < unit_side * 0.5f);
+        mesh_destroy(&floor);
+        mesh_destroy(&unit);
+    }
+
+    free(temp_memory_block);
+    return 0;
+}
@@ -14,6 +14,7 @@
 #include "mesh.h"
 #include "world.h"
 #include "camera.h"
+#include "trace.h"
 
 static void key_pressed_callback(Key key)
 {
@@ -168,6 +169,7 @@ int main()
         bool run_lightmapper = true;
         if (run_lightmapper)
         {
+            TRACE_SCOPE("lightmapper");
             World mapping_world = world_create(&alloc);
             create_test_world(&mapping_world, &renderer);
             run_radiosity_mapper(mapping_world, &renderer);
@@ -175,7 +177,12 @@ int main()
         }
 
         World world = world_create(&alloc);
-        create_test_world(&world, &renderer);
+
+        {
+            TRACE_SCOPE("create_test_world");
+            create_test_world(&world, &renderer);
+        }
+
         Camera camera = camera_create_projection();
 
         //simulation.camera.rotation = quaternion_normalize(quaternion_from_axis_angle({0,1,0}, -PI/2) * quaternion_look_at(vector3_zero,{-1,0,0}));
@@ -187,6 +194,7 @@ int main()
 
         while(!window.state.closed)
         {
+            TRACE_SCOPE("frame");
             process_all_window_messsages();
             process_input(&camera);
             renderer.pre_draw_frame();
@@ -202,5 +210,9 @@ int main()
     renderer.shutdown();
     heap_allocator_check_clean(&alloc);
 
+    #if defined(ENABLE_TRACING)
+        trace_write_chrome_json("trace.json");
+    #endif
+
     return 0;
 }
\ No newline at end of file
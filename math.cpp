@@ -1,147 +1,6 @@
 #include "math.h"
 #include <cmath>
 
-Matrix4x4 operator*(const Matrix4x4& m1, const Matrix4x4& m2)
-{
-    return
-    {
-        m1.x.x * m2.x.x + m1.x.y * m2.y.x + m1.x.z * m2.z.x + m1.x.w * m2.w.x,
-        m1.x.x * m2.x.y + m1.x.y * m2.y.y + m1.x.z * m2.z.y + m1.x.w * m2.w.y,
-        m1.x.x * m2.x.z + m1.x.y * m2.y.z + m1.x.z * m2.z.z + m1.x.w * m2.w.z,
-        m1.x.x * m2.x.w + m1.x.y * m2.y.w + m1.x.z * m2.z.w + m1.x.w * m2.w.w,
-
-        m1.y.x * m2.x.x + m1.y.y * m2.y.x + m1.y.z * m2.z.x + m1.y.w * m2.w.x,
-        m1.y.x * m2.x.y + m1.y.y * m2.y.y + m1.y.z * m2.z.y + m1.y.w * m2.w.y,
-        m1.y.x * m2.x.z + m1.y.y * m2.y.z + m1.y.z * m2.z.z + m1.y.w * m2.w.z,
-        m1.y.x * m2.x.w + m1.y.y * m2.y.w + m1.y.z * m2.z.w + m1.y.w * m2.w.w,
-
-        m1.z.x * m2.x.x + m1.z.y * m2.y.x + m1.z.z * m2.z.x + m1.z.w * m2.w.x,
-        m1.z.x * m2.x.y + m1.z.y * m2.y.y + m1.z.z * m2.z.y + m1.z.w * m2.w.y,
-        m1.z.x * m2.x.z + m1.z.y * m2.y.z + m1.z.z * m2.z.z + m1.z.w * m2.w.z,
-        m1.z.x * m2.x.w + m1.z.y * m2.y.w + m1.z.z * m2.z.w + m1.z.w * m2.w.w,
-
-        m1.w.x * m2.x.x + m1.w.y * m2.y.x + m1.w.z * m2.z.x + m1.w.w * m2.w.x,
-        m1.w.x * m2.x.y + m1.w.y * m2.y.y + m1.w.z * m2.z.y + m1.w.w * m2.w.y,
-        m1.w.x * m2.x.z + m1.w.y * m2.y.z + m1.w.z * m2.z.z + m1.w.w * m2.w.z,
-        m1.w.x * m2.x.w + m1.w.y * m2.y.w + m1.w.z * m2.z.w + m1.w.w * m2.w.w
-    };
-}
-
-void operator+=(Vector2& v1, const Vector2& v2)
-{
-    v1.x += v2.x;
-    v1.y += v2.y;
-}
-
-Vector2 operator+(const Vector2& v1, const Vector2& v2)
-{
-    return {v1.x + v2.x, v1.y + v2.y};
-}
-
-void operator+=(Vector2i& v1, const Vector2i& v2)
-{
-    v1.x += v2.x;
-    v1.y += v2.y;
-}
-
-Vector2i operator+(const Vector2i& v1, const Vector2i& v2)
-{
-    return {v1.x + v2.x, v1.y + v2.y};
-}
-
-void operator+=(Vector3& v1, const Vector3& v2)
-{
-    v1.x += v2.x;
-    v1.y += v2.y;
-    v1.z += v2.z;
-}
-
-Vector3 operator-(const Vector3& v)
-{
-    return {-v.x, -v.y, -v.z};
-}
-
-Vector3 operator+(const Vector3& v1, const Vector3& v2)
-{
-    return {v1.x + v2.x, v1.y + v2.y, v1.z + v2.z};
-}
-
-Vector3 operator-(const Vector3& v1, const Vector3& v2)
-{
-    return {v1.x - v2.x, v1.y - v2.y, v1.z - v2.z};
-}
-
-Vector3 operator*(const Vector3& v, float s)
-{
-    return {v.x * s, v.y * s, v.z * s};
-}
-
-Vector3 operator*(const Vector3& v1, const Vector3& v2)
-{
-    return {v1.x * v2.x, v1.y * v2.y, v1.z * v2.z};
-}
-
-void operator+=(Vector4& v1, const Vector4& v2)
-{
-    v1.x += v2.x;
-    v1.y += v2.y;
-    v1.z += v2.z;
-    v1.w += v2.w;
-}
-
-Vector4 operator+(const Vector4& v1, const Vector4& v2)
-{
-    return {v1.x * v2.x, v1.y * v2.y, v1.z * v2.z, v1.w + v2.w};
-}
-
-Vector4 operator*(const Vector4& v, float s)
-{
-    return {v.x * s, v.y * s, v.z * s, v.w * s};
-}
-
-Vector4 operator*(const Vector4& v1, const Vector4& v2)
-{
-    return {v1.x * v2.x, v1.y * v2.y, v1.z * v2.z, v1.w * v2.w};
-}
-
-Vector4 operator*(const Vector4& v, const Matrix4x4& m)
-{
-    return
-    {
-        v.x * m.x.x + v.x * m.x.y + v.x * m.x.z + v.x * m.x.w,
-        v.y * m.y.x + v.y * m.y.y + v.y * m.y.z + v.y * m.y.w,
-        v.z * m.z.x + v.z * m.z.y + v.z * m.z.z + v.z * m.z.w,
-        v.x * m.w.x + v.w * m.w.y + v.w * m.w.z + v.w * m.w.w
-    };
-}
-
-Matrix4x4 operator*(const Matrix4x4& m, float s)
-{
-    return
-    {
-        s * m.x.x, s * m.x.y, s * m.x.z, s * m.x.w,
-        s * m.y.x, s * m.y.y, s * m.y.z, s * m.y.w,
-        s * m.z.x, s * m.z.y, s * m.z.z, s * m.z.w,
-        s * m.w.x, s * m.w.y, s * m.w.z, s * m.w.w
-    };
-}
-
-Vector4 operator-(const Vector4& v1, const Vector4& v2)
-{
-    return {v1.x - v2.x, v1.y - v2.y, v1.z - v2.z, v1.w - v2.w};
-}
-
-Quaternion operator*(const Quaternion& a, const Quaternion& b)
-{
-    return
-    {
-        a.x * b.w + a.w * b.x + a.y * b.z - a.z * b.y,
-        a.y * b.w + a.w * b.y + a.z * b.x - a.x * b.z,
-        a.z * b.w + a.w * b.z + a.x * b.y - a.y * b.x,
-        a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
-    };
-}
-
 bool almost_equal(const Vector2& v1, const Vector2& v2)
 {
     return ::almost_equal(v1.x, v2.x) && ::almost_equal(v1.y, v2.y);
@@ -152,17 +11,6 @@ bool almost_equal(const Vector3& v1, const Vector3& v2)
     return ::almost_equal(v1.x, v2.x) && ::almost_equal(v1.y, v2.y) && ::almost_equal(v1.z, v2.z);
 }
 
-Matrix4x4 matrix4x4_identity()
-{
-    return
-    {
-        1, 0, 0, 0,
-        0, 1, 0, 0,
-        0, 0, 1, 0,
-        0, 0, 0, 1
-    };
-}
-
 Matrix4x4 matrix4x4_inverse(const Matrix4x4& m)
 {
     const float* a = &m.x.x;
@@ -244,52 +92,6 @@ Matrix4x4 matrix4x4_from_rotation_and_translation(const Quaternion& q, const Vec
     return out;
 }
 
-Vector3 matrix4x4_right(const Matrix4x4& m)
-{
-    return {m.x.x, m.x.y, m.x.z};
-}
-
-Vector3 matrix4x4_up(const Matrix4x4& m)
-{
-    return {m.y.x, m.y.y, m.y.z};
-}
-
-Vector3 vector3_cross(const Vector3& v1, const Vector3& v2)
-{
-    return 
-    {
-        v1.y * v2.z - v1.z * v2.y,
-        v1.z * v2.x - v1.x * v2.z,
-        v1.x * v2.y - v1.y * v2.x
-    };
-}
-
-float vector3_length(const Vector3& v)
-{
-    return sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
-}
-
-float vector3_squared_length(const Vector3& v)
-{
-    return v.x * v.x + v.y * v.y + v.z * v.z;
-}
-
-float vector3_dot(const Vector3& v1, const Vector3& v2)
-{
-    return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
-}
-
-Vector3 vector3_normalize(const Vector3& v)
-{
-    float len = vector3_length(v);
-    return
-    {
-        v.x / len,
-        v.y / len,
-        v.z / len
-    };
-}
-
 Vector3 vector3_tangent(const Vector3& v)
 {
     Vector3 c1 = vector3_cross(v, {0.0, 0.0, 1.0});
@@ -302,11 +104,6 @@ Vector3 vector3_bitangent(const Vector3& v)
     return vector3_normalize(vector3_cross(vector3_tangent(v), v));
 }
 
-float vector4_dot(const Vector4& v1, const Vector4& v2)
-{
-    return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w;
-}
-
 Quaternion quaternion_rotate_x(const Quaternion& q, float rads)
 {
     float adjusted_rads = rads * 0.5f; 
@@ -362,23 +159,6 @@ Quaternion quaternion_from_axis_angle(const Vector3& axis, float angle)
     });
 }
 
-Quaternion quaternion_identity()
-{
-    return {0, 0, 0, 1};
-}
-
-Quaternion quaternion_normalize(const Quaternion& q)
-{
-    float len = sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
-    return
-    {
-        q.x / len,
-        q.y / len,
-        q.z / len,
-        q.w / len
-    };
-}
-
 Quaternion quaternion_look_at(const Vector3& source, const Vector3& dest)
 {
     Vector3 source_to_dest = vector3_normalize(dest - source);
@@ -399,21 +179,3 @@ Quaternion quaternion_look_at(const Vector3& source, const Vector3& dest)
     return quaternion_from_axis_angle(rot_axis, rot_angle);
 }
 
-Quaternion quaternion_conjugate(const Quaternion& q)
-{
-    return
-    {
-        -q.x,
-        -q.y,
-        -q.z,
-        q.w
-    };
-}
-
-Vector3 quaternion_transform_vector3(const Quaternion& q, const Vector3& v)
-{
-    const Vector3 qv = {q.x, q.y, q.z};
-    const Vector3 uv = vector3_cross(qv, v);
-    const Vector3 uuv = vector3_cross(qv, uv);
-    return v + ((uv * q.w) + uuv) * 2.0f;
-}
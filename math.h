@@ -1,4 +1,12 @@
 #pragma once
+#include <math.h>
+
+// Small operations are defined inline below so they can be inlined into loops in other files. Vector4, Matrix4x4
+// and Quaternion operations use SSE when it is available, everything else is scalar.
+#if defined(_M_X64) || defined(__SSE__)
+    #include <xmmintrin.h>
+    #define MATH_USE_SSE
+#endif
 
 struct Vector2
 {
@@ -30,58 +38,295 @@ struct Quaternion
     float x, y, z, w;
 };
 
-static const float PI = 3.1415926535897932f;
+struct Aabb
+{
+    Vector3 min;
+    Vector3 max;
+};
 
-Matrix4x4 operator*(const Matrix4x4& m1, const Matrix4x4& m2);
-void operator+=(Vector2& v1, const Vector2& v2);
-Vector2 operator+(const Vector2& v1, const Vector2& v2);
-void operator+=(Vector2i& v1, const Vector2i& v2);
-Vector2i operator+(const Vector2i& v1, const Vector2i& v2);
-void operator+=(Vector3& v1, const Vector3& v2);
-Vector3 operator-(const Vector3& v);
-Vector3 operator+(const Vector3& v1, const Vector3& v2);
-Vector3 operator-(const Vector3& v1, const Vector3& v2);
-Vector3 operator*(const Vector3& v, float s);
-Vector3 operator*(const Vector3& v1, const Vector3& v2);
-void operator+=(Vector4& v1, const Vector4& v2);
-Vector4 operator+(const Vector4& v1, const Vector4& v2);
-Vector4 operator*(const Vector4& v, float s);
-Vector4 operator*(const Vector4& v1, const Vector4& v2);
-Vector4 operator*(const Vector4& v, const Matrix4x4& m);
-Matrix4x4 operator*(const Matrix4x4& m, float s);
-Vector4 operator-(const Vector4& v1, const Vector4& v2);
-Quaternion operator*(const Quaternion& a, const Quaternion& b);
+static const float PI = 3.1415926535897932f;
 
 bool almost_equal(const Vector2& v1, const Vector2& v2);
 bool almost_equal(const Vector3& v1, const Vector3& v2);
 
-Matrix4x4 matrix4x4_identity();
 Matrix4x4 matrix4x4_inverse(const Matrix4x4& m);
 Matrix4x4 matrix4x4_from_rotation_and_translation(const Quaternion& q, const Vector3& t);
-Vector3 matrix4x4_right(const Matrix4x4& m);
-Vector3 matrix4x4_up(const Matrix4x4& m);
 
-Vector3 vector3_cross(const Vector3& v1, const Vector3& v2);
-float vector3_length(const Vector3& v);
-float vector3_squared_length(const Vector3& v);
-float vector3_dot(const Vector3& v1, const Vector3& v2);
 Vector3 vector3_tangent(const Vector3& v);
 Vector3 vector3_bitangent(const Vector3& v);
-Vector3 vector3_normalize(const Vector3& v);
 
 static const Vector3 vector3_up = {0, 1, 0};
 static const Vector3 vector3_forward = {0, 0, 1};
 static const Vector3 vector3_zero = {0, 0, 0};
 static const Vector3 vector3_lookdir = {0, 0, -1};
 
-float vector4_dot(const Vector4& v1, const Vector4& v2);
-
 Quaternion quaternion_rotate_x(const Quaternion& q, float rads);
 Quaternion quaternion_rotate_y(const Quaternion& q, float rads);
 Quaternion quaternion_rotate_z(const Quaternion& q, float rads);
 Quaternion quaternion_from_axis_angle(const Vector3& axis, float angle);
-Quaternion quaternion_identity();
-Quaternion quaternion_normalize(const Quaternion& q);
 Quaternion quaternion_look_at(const Vector3& source, const Vector3& dest);
-Quaternion quaternion_conjugate(const Quaternion& q);
-Vector3 quaternion_transform_vector3(const Quaternion&q, const Vector3& v);
+
+#if defined(MATH_USE_SSE)
+
+inline __m128 vector4_load(const Vector4& v)
+{
+    return _mm_loadu_ps(&v.x);
+}
+
+inline Vector4 vector4_store(__m128 v)
+{
+    Vector4 r;
+    _mm_storeu_ps(&r.x, v);
+    return r;
+}
+
+// Row vector times matrix, the sum of the matrix rows scaled by the vector components.
+inline __m128 vector4_transform(__m128 v, const Matrix4x4& m)
+{
+    __m128 r = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), vector4_load(m.x));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), vector4_load(m.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), vector4_load(m.z)));
+    return _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), vector4_load(m.w)));
+}
+
+#endif
+
+inline void operator+=(Vector2& v1, const Vector2& v2)
+{
+    v1.x += v2.x;
+    v1.y += v2.y;
+}
+
+inline Vector2 operator+(const Vector2& v1, const Vector2& v2)
+{
+    return {v1.x + v2.x, v1.y + v2.y};
+}
+
+inline void operator+=(Vector2i& v1, const Vector2i& v2)
+{
+    v1.x += v2.x;
+    v1.y += v2.y;
+}
+
+inline Vector2i operator+(const Vector2i& v1, const Vector2i& v2)
+{
+    return {v1.x + v2.x, v1.y + v2.y};
+}
+
+inline void operator+=(Vector3& v1, const Vector3& v2)
+{
+    v1.x += v2.x;
+    v1.y += v2.y;
+    v1.z += v2.z;
+}
+
+inline Vector3 operator-(const Vector3& v)
+{
+    return {-v.x, -v.y, -v.z};
+}
+
+inline Vector3 operator+(const Vector3& v1, const Vector3& v2)
+{
+    return {v1.x + v2.x, v1.y + v2.y, v1.z + v2.z};
+}
+
+inline Vector3 operator-(const Vector3& v1, const Vector3& v2)
+{
+    return {v1.x - v2.x, v1.y - v2.y, v1.z - v2.z};
+}
+
+inline Vector3 operator*(const Vector3& v, float s)
+{
+    return {v.x * s, v.y * s, v.z * s};
+}
+
+inline Vector3 operator*(const Vector3& v1, const Vector3& v2)
+{
+    return {v1.x * v2.x, v1.y * v2.y, v1.z * v2.z};
+}
+
+inline Vector4 operator+(const Vector4& v1, const Vector4& v2)
+{
+    #if defined(MATH_USE_SSE)
+        return vector4_store(_mm_add_ps(vector4_load(v1), vector4_load(v2)));
+    #else
+        return {v1.x + v2.x, v1.y + v2.y, v1.z + v2.z, v1.w + v2.w};
+    #endif
+}
+
+inline void operator+=(Vector4& v1, const Vector4& v2)
+{
+    v1 = v1 + v2;
+}
+
+inline Vector4 operator-(const Vector4& v1, const Vector4& v2)
+{
+    #if defined(MATH_USE_SSE)
+        return vector4_store(_mm_sub_ps(vector4_load(v1), vector4_load(v2)));
+    #else
+        return {v1.x - v2.x, v1.y - v2.y, v1.z - v2.z, v1.w - v2.w};
+    #endif
+}
+
+inline Vector4 operator*(const Vector4& v, float s)
+{
+    #if defined(MATH_USE_SSE)
+        return vector4_store(_mm_mul_ps(vector4_load(v), _mm_set1_ps(s)));
+    #else
+        return {v.x * s, v.y * s, v.z * s, v.w * s};
+    #endif
+}
+
+inline Vector4 operator*(const Vector4& v1, const Vector4& v2)
+{
+    #if defined(MATH_USE_SSE)
+        return vector4_store(_mm_mul_ps(vector4_load(v1), vector4_load(v2)));
+    #else
+        return {v1.x * v2.x, v1.y * v2.y, v1.z * v2.z, v1.w * v2.w};
+    #endif
+}
+
+// Row vector times matrix, like the transforms in the shaders.
+inline Vector4 operator*(const Vector4& v, const Matrix4x4& m)
+{
+    #if defined(MATH_USE_SSE)
+        return vector4_store(vector4_transform(vector4_load(v), m));
+    #else
+        return
+        {
+            v.x * m.x.x + v.y * m.y.x + v.z * m.z.x + v.w * m.w.x,
+            v.x * m.x.y + v.y * m.y.y + v.z * m.z.y + v.w * m.w.y,
+            v.x * m.x.z + v.y * m.y.z + v.z * m.z.z + v.w * m.w.z,
+            v.x * m.x.w + v.y * m.y.w + v.z * m.z.w + v.w * m.w.w
+        };
+    #endif
+}
+
+inline Matrix4x4 operator*(const Matrix4x4& m1, const Matrix4x4& m2)
+{
+    return {m1.x * m2, m1.y * m2, m1.z * m2, m1.w * m2};
+}
+
+inline Matrix4x4 operator*(const Matrix4x4& m, float s)
+{
+    return {m.x * s, m.y * s, m.z * s, m.w * s};
+}
+
+inline Quaternion operator*(const Quaternion& a, const Quaternion& b)
+{
+    #if defined(MATH_USE_SSE)
+        __m128 bv = _mm_loadu_ps(&b.x);
+        __m128 r = _mm_mul_ps(_mm_set1_ps(a.w), bv);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.x), _mm_mul_ps(_mm_shuffle_ps(bv, bv, _MM_SHUFFLE(0, 1, 2, 3)), _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f))));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.y), _mm_mul_ps(_mm_shuffle_ps(bv, bv, _MM_SHUFFLE(1, 0, 3, 2)), _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f))));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.z), _mm_mul_ps(_mm_shuffle_ps(bv, bv, _MM_SHUFFLE(2, 3, 0, 1)), _mm_setr_ps(-1.0f, 1.0f, 1.0f, -1.0f))));
+        Quaternion q;
+        _mm_storeu_ps(&q.x, r);
+        return q;
+    #else
+        return
+        {
+            a.x * b.w + a.w * b.x + a.y * b.z - a.z * b.y,
+            a.y * b.w + a.w * b.y + a.z * b.x - a.x * b.z,
+            a.z * b.w + a.w * b.z + a.x * b.y - a.y * b.x,
+            a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+        };
+    #endif
+}
+
+inline Matrix4x4 matrix4x4_identity()
+{
+    return
+    {
+        1, 0, 0, 0,
+        0, 1, 0, 0,
+        0, 0, 1, 0,
+        0, 0, 0, 1
+    };
+}
+
+inline Matrix4x4 matrix4x4_transpose(const Matrix4x4& m)
+{
+    #if defined(MATH_USE_SSE)
+        __m128 x = vector4_load(m.x), y = vector4_load(m.y), z = vector4_load(m.z), w = vector4_load(m.w);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        return {vector4_store(x), vector4_store(y), vector4_store(z), vector4_store(w)};
+    #else
+        return
+        {
+            m.x.x, m.y.x, m.z.x, m.w.x,
+            m.x.y, m.y.y, m.z.y, m.w.y,
+            m.x.z, m.y.z, m.z.z, m.w.z,
+            m.x.w, m.y.w, m.z.w, m.w.w
+        };
+    #endif
+}
+
+inline Vector3 matrix4x4_right(const Matrix4x4& m)
+{
+    return {m.x.x, m.x.y, m.x.z};
+}
+
+inline Vector3 matrix4x4_up(const Matrix4x4& m)
+{
+    return {m.y.x, m.y.y, m.y.z};
+}
+
+inline Vector3 vector3_cross(const Vector3& v1, const Vector3& v2)
+{
+    return
+    {
+        v1.y * v2.z - v1.z * v2.y,
+        v1.z * v2.x - v1.x * v2.z,
+        v1.x * v2.y - v1.y * v2.x
+    };
+}
+
+inline float vector3_squared_length(const Vector3& v)
+{
+    return v.x * v.x + v.y * v.y + v.z * v.z;
+}
+
+inline float vector3_length(const Vector3& v)
+{
+    return sqrtf(vector3_squared_length(v));
+}
+
+inline float vector3_dot(const Vector3& v1, const Vector3& v2)
+{
+    return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+}
+
+inline Vector3 vector3_normalize(const Vector3& v)
+{
+    return v * (1.0f / vector3_length(v));
+}
+
+inline float vector4_dot(const Vector4& v1, const Vector4& v2)
+{
+    return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w;
+}
+
+inline Quaternion quaternion_identity()
+{
+    return {0, 0, 0, 1};
+}
+
+inline Quaternion quaternion_normalize(const Quaternion& q)
+{
+    float inv_len = 1.0f / sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    return {q.x * inv_len, q.y * inv_len, q.z * inv_len, q.w * inv_len};
+}
+
+inline Quaternion quaternion_conjugate(const Quaternion& q)
+{
+    return {-q.x, -q.y, -q.z, q.w};
+}
+
+inline Vector3 quaternion_transform_vector3(const Quaternion& q, const Vector3& v)
+{
+    const Vector3 qv = {q.x, q.y, q.z};
+    const Vector3 uv = vector3_cross(qv, v);
+    const Vector3 uuv = vector3_cross(qv, uv);
+    return v + ((uv * q.w) + uuv) * 2.0f;
+}
@@ -0,0 +1,490 @@
+#include "math_batch.h"
+#include "math.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+    #include <immintrin.h>
+    #define MATH_BATCH_X86
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define TARGET_AVX2
+        #define TARGET_AVX512
+    #else
+        #include <cpuid.h>
+        #define TARGET_AVX2 __attribute__((target("avx2,fma")))
+        #define TARGET_AVX512 __attribute__((target("avx512f")))
+    #endif
+#endif
+
+// Rows of the matrix that is applied, for normals that is the inverse transpose.
+struct BatchMatrix
+{
+    float m[3][3];
+    float t[3];
+};
+
+static BatchMatrix batch_matrix(const Matrix4x4& m)
+{
+    BatchMatrix bm;
+    const Vector4* rows = &m.x;
+
+    for (unsigned r = 0; r < 3; ++r)
+    {
+        const float* row = &rows[r].x;
+        bm.m[r][0] = row[0];
+        bm.m[r][1] = row[1];
+        bm.m[r][2] = row[2];
+    }
+
+    bm.t[0] = m.w.x;
+    bm.t[1] = m.w.y;
+    bm.t[2] = m.w.z;
+    return bm;
+}
+
+static BatchMatrix batch_normal_matrix(const Matrix4x4& m)
+{
+    BatchMatrix bm = batch_matrix(matrix4x4_transpose(matrix4x4_inverse(m)));
+    bm.t[0] = bm.t[1] = bm.t[2] = 0;
+    return bm;
+}
+
+static void transform_points_scalar(const BatchMatrix& bm, const Vector3* in, Vector3* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        Vector3 p = in[i];
+        out[i].x = p.x * bm.m[0][0] + p.y * bm.m[1][0] + p.z * bm.m[2][0] + bm.t[0];
+        out[i].y = p.x * bm.m[0][1] + p.y * bm.m[1][1] + p.z * bm.m[2][1] + bm.t[1];
+        out[i].z = p.x * bm.m[0][2] + p.y * bm.m[1][2] + p.z * bm.m[2][2] + bm.t[2];
+    }
+}
+
+static void transform_normals_scalar(const BatchMatrix& bm, const Vector3* in, Vector3* out, size_t n)
+{
+    transform_points_scalar(bm, in, out, n);
+
+    for (size_t i = 0; i < n; ++i)
+        out[i] = vector3_normalize(out[i]);
+}
+
+// Arvo's method, the transformed center plus the extents transformed by the absolute matrix.
+static void transform_aabbs_scalar(const BatchMatrix& bm, const Aabb* in, Aabb* out, size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        const float* mn = &in[i].min.x;
+        const float* mx = &in[i].max.x;
+        float c[3] = {(mn[0] + mx[0]) * 0.5f, (mn[1] + mx[1]) * 0.5f, (mn[2] + mx[2]) * 0.5f};
+        float e[3] = {(mx[0] - mn[0]) * 0.5f, (mx[1] - mn[1]) * 0.5f, (mx[2] - mn[2]) * 0.5f};
+        float* out_min = &out[i].min.x;
+        float* out_max = &out[i].max.x;
+
+        for (unsigned k = 0; k < 3; ++k)
+        {
+            float tc = c[0] * bm.m[0][k] + c[1] * bm.m[1][k] + c[2] * bm.m[2][k] + bm.t[k];
+            float te = e[0] * fabsf(bm.m[0][k]) + e[1] * fabsf(bm.m[1][k]) + e[2] * fabsf(bm.m[2][k]);
+            out_min[k] = tc - te;
+            out_max[k] = tc + te;
+        }
+    }
+}
+
+#if defined(MATH_BATCH_X86)
+
+// 8 Vector3 are 24 floats, loaded as six 4 float halves and shuffled into one register per component. The lane
+// order isn't the point order, but store_soa_8 undoes it.
+TARGET_AVX2 static void load_soa_8(const Vector3* p, __m256* x, __m256* y, __m256* z)
+{
+    const float* f = &p->x;
+    __m256 m03 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(f)), _mm_loadu_ps(f + 12), 1);
+    __m256 m14 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(f + 4)), _mm_loadu_ps(f + 16), 1);
+    __m256 m25 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(f + 8)), _mm_loadu_ps(f + 20), 1);
+    __m256 xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+    __m256 yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+    *x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    *y = _mm256_shuffle_ps(yz, xy, _MM_SHUFFLE(3, 1, 2, 0));
+    *z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+TARGET_AVX2 static void store_soa_8(Vector3* p, __m256 x, __m256 y, __m256 z)
+{
+    float* f = &p->x;
+    __m256 rxy = _mm256_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 ryz = _mm256_shuffle_ps(y, z, _MM_SHUFFLE(3, 1, 3, 1));
+    __m256 rzx = _mm256_shuffle_ps(z, x, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256 r03 = _mm256_shuffle_ps(rxy, rzx, _MM_SHUFFLE(2, 0, 2, 0));
+    __m256 r14 = _mm256_shuffle_ps(ryz, rxy, _MM_SHUFFLE(3, 1, 2, 0));
+    __m256 r25 = _mm256_shuffle_ps(rzx, ryz, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(f, _mm256_castps256_ps128(r03));
+    _mm_storeu_ps(f + 4, _mm256_castps256_ps128(r14));
+    _mm_storeu_ps(f + 8, _mm256_castps256_ps128(r25));
+    _mm_storeu_ps(f + 12, _mm256_extractf128_ps(r03, 1));
+    _mm_storeu_ps(f + 16, _mm256_extractf128_ps(r14, 1));
+    _mm_storeu_ps(f + 20, _mm256_extractf128_ps(r25, 1));
+}
+
+TARGET_AVX2 static void transform_soa_8(const BatchMatrix& bm, __m256* x, __m256* y, __m256* z)
+{
+    __m256 r[3];
+
+    for (unsigned k = 0; k < 3; ++k)
+    {
+        r[k] = _mm256_fmadd_ps(*z, _mm256_set1_ps(bm.m[2][k]), _mm256_set1_ps(bm.t[k]));
+        r[k] = _mm256_fmadd_ps(*y, _mm256_set1_ps(bm.m[1][k]), r[k]);
+        r[k] = _mm256_fmadd_ps(*x, _mm256_set1_ps(bm.m[0][k]), r[k]);
+    }
+
+    *x = r[0];
+    *y = r[1];
+    *z = r[2];
+}
+
+TARGET_AVX2 static void transform_points_avx2(const BatchMatrix& bm, const Vector3* in, Vector3* out, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 x, y, z;
+        load_soa_8(in + i, &x, &y, &z);
+        transform_soa_8(bm, &x, &y, &z);
+        store_soa_8(out + i, x, y, z);
+    }
+
+    transform_points_scalar(bm, in + i, out + i, n - i);
+}
+
+TARGET_AVX2 static void transform_normals_avx2(const BatchMatrix& bm, const Vector3* in, Vector3* out, size_t n)
+{
+    size_t i = 0;
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 x, y, z;
+        load_soa_8(in + i, &x, &y, &z);
+        transform_soa_8(bm, &x, &y, &z);
+        __m256 squared_length = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)));
+        __m256 inv_length = _mm256_div_ps(one, _mm256_sqrt_ps(squared_length));
+        store_soa_8(out + i, _mm256_mul_ps(x, inv_length), _mm256_mul_ps(y, inv_length), _mm256_mul_ps(z, inv_length));
+    }
+
+    transform_normals_scalar(bm, in + i, out + i, n - i);
+}
+
+// Boxes are 6 floats apart, their components are gathered into lanes and written back through a small buffer.
+TARGET_AVX2 static void transform_aabbs_avx2(const BatchMatrix& bm, const Aabb* in, Aabb* out, size_t n)
+{
+    size_t i = 0;
+    const __m256i stride = _mm256_setr_epi32(0, 6, 12, 18, 24, 30, 36, 42);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+
+    for (; i + 8 <= n; i += 8)
+    {
+        const float* f = &in[i].min.x;
+        __m256 c[3], e[3];
+
+        for (unsigned k = 0; k < 3; ++k)
+        {
+            __m256 mn = _mm256_i32gather_ps(f + k, stride, 4);
+            __m256 mx = _mm256_i32gather_ps(f + 3 + k, stride, 4);
+            c[k] = _mm256_mul_ps(_mm256_add_ps(mn, mx), half);
+            e[k] = _mm256_mul_ps(_mm256_sub_ps(mx, mn), half);
+        }
+
+        float result[6][8];
+
+        for (unsigned k = 0; k < 3; ++k)
+        {
+            __m256 tc = _mm256_fmadd_ps(c[2], _mm256_set1_ps(bm.m[2][k]), _mm256_set1_ps(bm.t[k]));
+            tc = _mm256_fmadd_ps(c[1], _mm256_set1_ps(bm.m[1][k]), tc);
+            tc = _mm256_fmadd_ps(c[0], _mm256_set1_ps(bm.m[0][k]), tc);
+            __m256 te = _mm256_mul_ps(e[2], _mm256_andnot_ps(sign_mask, _mm256_set1_ps(bm.m[2][k])));
+            te = _mm256_fmadd_ps(e[1], _mm256_andnot_ps(sign_mask, _mm256_set1_ps(bm.m[1][k])), te);
+            te = _mm256_fmadd_ps(e[0], _mm256_andnot_ps(sign_mask, _mm256_set1_ps(bm.m[0][k])), te);
+            _mm256_storeu_ps(result[k], _mm256_sub_ps(tc, te));
+            _mm256_storeu_ps(result[3 + k], _mm256_add_ps(tc, te));
+        }
+
+        float* o = &out[i].min.x;
+
+        for (unsigned b = 0; b < 8; ++b)
+        {
+            for (unsigned k = 0; k < 6; ++k)
+                o[b * 6 + k] = result[k][b];
+        }
+    }
+
+    transform_aabbs_scalar(bm, in + i, out + i, n - i);
+}
+
+// 16 Vector3 are three registers. Each component is collected with two permutes, the first takes what it can
+// from the first two registers and the second fills in the rest from the third. Lanes are in point order.
+struct Soa16Permutes
+{
+    __m512i load_first[3];
+    __m512i load_second[3];
+    __m512i store_first[3];
+    __m512i store_second[3];
+};
+
+TARGET_AVX512 static Soa16Permutes soa_16_permutes()
+{
+    int load_first[3][16], load_second[3][16], store_first[3][16], store_second[3][16];
+
+    for (int k = 0; k < 3; ++k)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            int load_index = i * 3 + k;
+            load_first[k][i] = load_index < 32 ? load_index : 0;
+            load_second[k][i] = load_index < 32 ? i : 16 + load_index - 32;
+
+            // Register k of the output holds floats 16k to 16k + 15.
+            int float_index = k * 16 + i;
+            int point = float_index / 3;
+            int component = float_index % 3;
+            store_first[k][i] = component == 0 ? point : (component == 1 ? 16 + point : 0);
+            store_second[k][i] = component == 2 ? 16 + point : i;
+        }
+    }
+
+    Soa16Permutes p;
+
+    for (int k = 0; k < 3; ++k)
+    {
+        p.load_first[k] = _mm512_loadu_si512(load_first[k]);
+        p.load_second[k] = _mm512_loadu_si512(load_second[k]);
+        p.store_first[k] = _mm512_loadu_si512(store_first[k]);
+        p.store_second[k] = _mm512_loadu_si512(store_second[k]);
+    }
+
+    return p;
+}
+
+TARGET_AVX512 static void load_soa_16(const Soa16Permutes& p, const Vector3* v, __m512* soa)
+{
+    const float* f = &v->x;
+    __m512 a = _mm512_loadu_ps(f);
+    __m512 b = _mm512_loadu_ps(f + 16);
+    __m512 c = _mm512_loadu_ps(f + 32);
+
+    for (unsigned k = 0; k < 3; ++k)
+        soa[k] = _mm512_permutex2var_ps(_mm512_permutex2var_ps(a, p.load_first[k], b), p.load_second[k], c);
+}
+
+TARGET_AVX512 static void store_soa_16(const Soa16Permutes& p, Vector3* v, const __m512* soa)
+{
+    float* f = &v->x;
+
+    for (unsigned k = 0; k < 3; ++k)
+        _mm512_storeu_ps(f + k * 16, _mm512_permutex2var_ps(_mm512_permutex2var_ps(soa[0], p.store_first[k], soa[1]), p.store_second[k], soa[2]));
+}
+
+TARGET_AVX512 static void transform_soa_16(const BatchMatrix& bm, __m512* soa)
+{
+    __m512 r[3];
+
+    for (unsigned k = 0; k < 3; ++k)
+    {
+        r[k] = _mm512_fmadd_ps(soa[2], _mm512_set1_ps(bm.m[2][k]), _mm512_set1_ps(bm.t[k]));
+        r[k] = _mm512_fmadd_ps(soa[1], _mm512_set1_ps(bm.m[1][k]), r[k]);
+        r[k] = _mm512_fmadd_ps(soa[0], _mm512_set1_ps(bm.m[0][k]), r[k]);
+    }
+
+    soa[0] = r[0];
+    soa[1] = r[1];
+    soa[2] = r[2];
+}
+
+TARGET_AVX512 static void transform_points_avx512(const BatchMatrix& bm, const Vector3* in, Vector3* out, size_t n)
+{
+    Soa16Permutes p = soa_16_permutes();
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512 soa[3];
+        load_soa_16(p, in + i, soa);
+        transform_soa_16(bm, soa);
+        store_soa_16(p, out + i, soa);
+    }
+
+    transform_points_scalar(bm, in + i, out + i, n - i);
+}
+
+TARGET_AVX512 static void transform_normals_avx512(const BatchMatrix& bm, const Vector3* in, Vector3* out, size_t n)
+{
+    Soa16Permutes p = soa_16_permutes();
+    size_t i = 0;
+    const __m512 one = _mm512_set1_ps(1.0f);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m512 soa[3];
+        load_soa_16(p, in + i, soa);
+        transform_soa_16(bm, soa);
+        __m512 squared_length = _mm512_fmadd_ps(soa[0], soa[0], _mm512_fmadd_ps(soa[1], soa[1], _mm512_mul_ps(soa[2], soa[2])));
+        __m512 inv_length = _mm512_div_ps(one, _mm512_sqrt_ps(squared_length));
+
+        for (unsigned k = 0; k < 3; ++k)
+            soa[k] = _mm512_mul_ps(soa[k], inv_length);
+
+        store_soa_16(p, out + i, soa);
+    }
+
+    transform_normals_scalar(bm, in + i, out + i, n - i);
+}
+
+TARGET_AVX512 static void transform_aabbs_avx512(const BatchMatrix& bm, const Aabb* in, Aabb* out, size_t n)
+{
+    size_t i = 0;
+    const __m512i stride = _mm512_setr_epi32(0, 6, 12, 18, 24, 30, 36, 42, 48, 54, 60, 66, 72, 78, 84, 90);
+    const __m512 half = _mm512_set1_ps(0.5f);
+
+    for (; i + 16 <= n; i += 16)
+    {
+        const float* f = &in[i].min.x;
+        float* o = &out[i].min.x;
+        __m512 c[3], e[3];
+
+        for (unsigned k = 0; k < 3; ++k)
+        {
+            __m512 mn = _mm512_i32gather_ps(stride, f + k, 4);
+            __m512 mx = _mm512_i32gather_ps(stride, f + 3 + k, 4);
+            c[k] = _mm512_mul_ps(_mm512_add_ps(mn, mx), half);
+            e[k] = _mm512_mul_ps(_mm512_sub_ps(mx, mn), half);
+        }
+
+        for (unsigned k = 0; k < 3; ++k)
+        {
+            __m512 tc = _mm512_fmadd_ps(c[2], _mm512_set1_ps(bm.m[2][k]), _mm512_set1_ps(bm.t[k]));
+            tc = _mm512_fmadd_ps(c[1], _mm512_set1_ps(bm.m[1][k]), tc);
+            tc = _mm512_fmadd_ps(c[0], _mm512_set1_ps(bm.m[0][k]), tc);
+            __m512 te = _mm512_mul_ps(e[2], _mm512_set1_ps(fabsf(bm.m[2][k])));
+            te = _mm512_fmadd_ps(e[1], _mm512_set1_ps(fabsf(bm.m[1][k])), te);
+            te = _mm512_fmadd_ps(e[0], _mm512_set1_ps(fabsf(bm.m[0][k])), te);
+            _mm512_i32scatter_ps(o + k, stride, _mm512_sub_ps(tc, te), 4);
+            _mm512_i32scatter_ps(o + 3 + k, stride, _mm512_add_ps(tc, te), 4);
+        }
+    }
+
+    transform_aabbs_scalar(bm, in + i, out + i, n - i);
+}
+
+static void cpuid(int leaf, int subleaf, int regs[4])
+{
+    #if defined(_MSC_VER)
+        __cpuidex(regs, leaf, subleaf);
+    #else
+        unsigned a, b, c, d;
+        __cpuid_count(leaf, subleaf, a, b, c, d);
+        regs[0] = (int)a;
+        regs[1] = (int)b;
+        regs[2] = (int)c;
+        regs[3] = (int)d;
+    #endif
+}
+
+static unsigned long long xgetbv0()
+{
+    #if defined(_MSC_VER)
+        return _xgetbv(0);
+    #else
+        unsigned a, d;
+        __asm__ volatile("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+        return ((unsigned long long)d << 32) | a;
+    #endif
+}
+
+// The CPU must support the instructions and the OS must save the registers they use.
+static BatchIsa detect_isa()
+{
+    int regs[4];
+    cpuid(0, 0, regs);
+
+    if (regs[0] < 7)
+        return BatchIsa::Scalar;
+
+    cpuid(1, 0, regs);
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool fma = (regs[2] & (1 << 12)) != 0;
+
+    if (!osxsave)
+        return BatchIsa::Scalar;
+
+    unsigned long long xcr0 = xgetbv0();
+    cpuid(7, 0, regs);
+    bool avx2 = (regs[1] & (1 << 5)) != 0 && fma && (xcr0 & 0x6) == 0x6;
+    bool avx512 = (regs[1] & (1 << 16)) != 0 && (xcr0 & 0xe6) == 0xe6;
+
+    if (avx512 && avx2)
+        return BatchIsa::Avx512;
+
+    return avx2 ? BatchIsa::Avx2 : BatchIsa::Scalar;
+}
+
+#else
+
+static BatchIsa detect_isa()
+{
+    return BatchIsa::Scalar;
+}
+
+#endif
+
+static BatchIsa max_isa = BatchIsa::Avx512;
+
+BatchIsa math_batch_isa()
+{
+    static const BatchIsa detected = detect_isa();
+    return max_isa < detected ? max_isa : detected;
+}
+
+void math_batch_force_isa(BatchIsa isa)
+{
+    max_isa = isa;
+}
+
+void transform_points(const Matrix4x4& m, const Vector3* in, Vector3* out, size_t n)
+{
+    BatchMatrix bm = batch_matrix(m);
+
+    switch (math_batch_isa())
+    {
+    #if defined(MATH_BATCH_X86)
+        case BatchIsa::Avx512: transform_points_avx512(bm, in, out, n); return;
+        case BatchIsa::Avx2: transform_points_avx2(bm, in, out, n); return;
+    #endif
+        default: transform_points_scalar(bm, in, out, n); return;
+    }
+}
+
+void transform_normals(const Matrix4x4& m, const Vector3* in, Vector3* out, size_t n)
+{
+    BatchMatrix bm = batch_normal_matrix(m);
+
+    switch (math_batch_isa())
+    {
+    #if defined(MATH_BATCH_X86)
+        case BatchIsa::Avx512: transform_normals_avx512(bm, in, out, n); return;
+        case BatchIsa::Avx2: transform_normals_avx2(bm, in, out, n); return;
+    #endif
+        default: transform_normals_scalar(bm, in, out, n); return;
+    }
+}
+
+void transform_aabbs(const Matrix4x4& m, const Aabb* in, Aabb* out, size_t n)
+{
+    BatchMatrix bm = batch_matrix(m);
+
+    switch (math_batch_isa())
+    {
+    #if defined(MATH_BATCH_X86)
+        case BatchIsa::Avx512: transform_aabbs_avx512(bm, in, out, n); return;
+        case BatchIsa::Avx2: transform_aabbs_avx2(bm, in, out, n); return;
+    #endif
+        default: transform_aabbs_scalar(bm, in, out, n); return;
+    }
+}
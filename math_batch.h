@@ -0,0 +1,26 @@
+#pragma once
+#include <stddef.h>
+
+struct Vector3;
+struct Matrix4x4;
+struct Aabb;
+
+// Transforms of many values at once. The kernel is picked on first use from what the CPU supports: AVX-512 and
+// AVX2 kernels transform 16 or 8 values at a time, deinterleaved into one register per component. in and out may
+// be the same array but must not otherwise overlap.
+enum struct BatchIsa { Scalar, Avx2, Avx512 };
+
+BatchIsa math_batch_isa();
+
+// Limits the kernels to isa, or to the best the CPU supports if that is lower. Used to compare the kernels.
+void math_batch_force_isa(BatchIsa isa);
+
+// Points are row vectors with w = 1, transformed like Vector4 * Matrix4x4.
+void transform_points(const Matrix4x4& m, const Vector3* in, Vector3* out, size_t n);
+
+// Normals are transformed by the inverse transpose of m, so that they stay perpendicular to surfaces under
+// non-uniform scale, and are normalized.
+void transform_normals(const Matrix4x4& m, const Vector3* in, Vector3* out, size_t n);
+
+// The smallest box around each transformed box.
+void transform_aabbs(const Matrix4x4& m, const Aabb* in, Aabb* out, size_t n);
@@ -0,0 +1,151 @@
+#include <assert.h>
+#include <stdio.h>
+#include "helpers.h"
+#include "math.cpp"
+#include "math_batch.cpp"
+
+static const size_t MaxCount = 33;
+
+// Counts around the 8 and 16 wide kernels, so that every one of them also runs its tail.
+static const size_t counts[] = {0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33};
+
+// The kernels use fused multiply-adds where the scalar code doesn't.
+static bool nearly_equal(float a, float b)
+{
+    float d = fabsf(a - b);
+    return d <= 1e-5f || d <= 1e-5f * fabsf(b);
+}
+
+static bool nearly_equal(const Vector3& a, const Vector3& b)
+{
+    return nearly_equal(a.x, b.x) && nearly_equal(a.y, b.y) && nearly_equal(a.z, b.z);
+}
+
+static bool same(const Vector3& a, const Vector3& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static float value(unsigned i)
+{
+    return (float)((i * 7919u) % 2001u) / 100.0f - 10.0f;
+}
+
+static void check_isa(BatchIsa isa, const Matrix4x4& m)
+{
+    // Past the count the outputs must stay as they were.
+    const Vector3 untouched = {12345, 12345, 12345};
+    Vector3 points[MaxCount];
+    Vector3 normals[MaxCount];
+    Aabb boxes[MaxCount];
+
+    for (unsigned i = 0; i < MaxCount; ++i)
+    {
+        points[i] = {value(i * 3), value(i * 3 + 1), value(i * 3 + 2)};
+        normals[i] = vector3_normalize({value(i * 3 + 100), value(i * 3 + 101), value(i * 3 + 102) + 0.5f});
+        Vector3 size = {fabsf(value(i + 200)), fabsf(value(i + 300)), fabsf(value(i + 400))};
+        boxes[i] = {points[i], points[i] + size};
+    }
+
+    for (size_t ci = 0; ci < sizeof(counts) / sizeof(counts[0]); ++ci)
+    {
+        size_t n = counts[ci];
+        Vector3 expected_points[MaxCount], expected_normals[MaxCount];
+        Aabb expected_boxes[MaxCount];
+        math_batch_force_isa(BatchIsa::Scalar);
+        transform_points(m, points, expected_points, n);
+        transform_normals(m, normals, expected_normals, n);
+        transform_aabbs(m, boxes, expected_boxes, n);
+
+        Vector3 out_points[MaxCount], out_normals[MaxCount];
+        Aabb out_boxes[MaxCount];
+
+        for (unsigned i = 0; i < MaxCount; ++i)
+        {
+            out_points[i] = untouched;
+            out_normals[i] = untouched;
+            out_boxes[i] = {untouched, untouched};
+        }
+
+        math_batch_force_isa(isa);
+        assert(math_batch_isa() == isa);
+        transform_points(m, points, out_points, n);
+        transform_normals(m, normals, out_normals, n);
+        transform_aabbs(m, boxes, out_boxes, n);
+
+        for (size_t i = 0; i < MaxCount; ++i)
+        {
+            if (i < n)
+            {
+                assert(nearly_equal(out_points[i], expected_points[i]));
+                assert(nearly_equal(out_normals[i], expected_normals[i]));
+                assert(nearly_equal(out_boxes[i].min, expected_boxes[i].min));
+                assert(nearly_equal(out_boxes[i].max, expected_boxes[i].max));
+            }
+            else
+            {
+                assert(same(out_points[i], untouched));
+                assert(same(out_normals[i], untouched));
+                assert(same(out_boxes[i].min, untouched) && same(out_boxes[i].max, untouched));
+            }
+        }
+
+        // in and out may be the same array.
+        Vector3 in_place_points[MaxCount], in_place_normals[MaxCount];
+        Aabb in_place_boxes[MaxCount];
+        memcpy(in_place_points, points, sizeof(points));
+        memcpy(in_place_normals, normals, sizeof(normals));
+        memcpy(in_place_boxes, boxes, sizeof(boxes));
+        transform_points(m, in_place_points, in_place_points, n);
+        transform_normals(m, in_place_normals, in_place_normals, n);
+        transform_aabbs(m, in_place_boxes, in_place_boxes, n);
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            assert(nearly_equal(in_place_points[i], expected_points[i]));
+            assert(nearly_equal(in_place_normals[i], expected_normals[i]));
+            assert(nearly_equal(in_place_boxes[i].min, expected_boxes[i].min));
+            assert(nearly_equal(in_place_boxes[i].max, expected_boxes[i].max));
+        }
+    }
+}
+
+int main()
+{
+    // Non-uniform scale, rotation and translation, so that every matrix element takes part.
+    Matrix4x4 scale = matrix4x4_identity();
+    scale.x.x = 2;
+    scale.y.y = 0.5f;
+    scale.z.z = 3;
+    Quaternion rotation = quaternion_from_axis_angle(vector3_normalize({1, 2, 3}), 0.7f);
+    Matrix4x4 m = scale * matrix4x4_from_rotation_and_translation(rotation, {1, -2, 3});
+
+    {
+        // The scalar kernel against the inline math it stands for.
+        Vector3 p = {1, 2, 3};
+        Vector3 out;
+        math_batch_force_isa(BatchIsa::Scalar);
+        transform_points(m, &p, &out, 1);
+        Vector4 expected = Vector4{p.x, p.y, p.z, 1} * m;
+        assert(nearly_equal(out, {expected.x, expected.y, expected.z}));
+    }
+
+    // Kernels the CPU doesn't support can't be checked here.
+    BatchIsa isas[] = {BatchIsa::Avx2, BatchIsa::Avx512};
+
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        math_batch_force_isa(isas[i]);
+
+        if (math_batch_isa() != isas[i])
+        {
+            printf("Skipping kernels the CPU doesn't support.\n");
+            continue;
+        }
+
+        check_isa(isas[i], m);
+    }
+
+    math_batch_force_isa(BatchIsa::Avx512);
+    return 0;
+}
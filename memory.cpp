@@ -1,18 +1,30 @@
 #include "memory.h"
 #include "types.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <atomic>
+#include <mutex>
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #include <intrin.h>
+#else
+    #include <sys/mman.h>
+#endif
 
-unsigned mem_ptr_diff(void* ptr1, void* ptr2)
+size_t mem_ptr_diff(void* ptr1, void* ptr2)
 {
-    return (unsigned)((unsigned char*)ptr2 - (unsigned char*)ptr1);
+    return (size_t)((unsigned char*)ptr2 - (unsigned char*)ptr1);
 }
 
-void* mem_ptr_add(void* ptr1, unsigned offset)
+void* mem_ptr_add(void* ptr1, size_t offset)
 {
     return (void*)((unsigned char*)ptr1 + offset);
 }
 
-void* mem_ptr_sub(void* ptr1, unsigned offset)
+void* mem_ptr_sub(void* ptr1, size_t offset)
 {
     return (void*)((unsigned char*)ptr1 - offset);
 }
@@ -20,7 +32,7 @@ void* mem_ptr_sub(void* ptr1, unsigned offset)
 void* mem_align_forward(void* p, unsigned align)
 {
     uintptr_t pi = uintptr_t(p);
-    const unsigned mod = pi % align;
+    const uintptr_t mod = pi % align;
 
     if (mod)
         pi += (align - mod);
@@ -32,22 +44,22 @@ struct PermanentMemoryStorage
 {
     unsigned char* start;
     unsigned char* head;
-    unsigned capacity;
+    size_t capacity;
 };
 
 static PermanentMemoryStorage pms;
 
-void permanent_memory_blob_init(void* start, unsigned capacity)
+void permanent_memory_blob_init(void* start, size_t capacity)
 {
-    memzero(&pms, PermanentMemorySize);
+    memzero(&pms, PermanentMemoryStorage);
     pms.start = (unsigned char*)start;
     pms.head = pms.start;
     pms.capacity = capacity;
 }
 
-void* permanent_alloc(unsigned size, unsigned align)
+void* permanent_alloc(size_t size, unsigned align)
 {
-    Assert(mem_ptr_diff(pms.start, pms.head) + size + align <= pms.capacity, "Out of permanent memory.");
+    Assert(size <= pms.capacity && mem_ptr_diff(pms.start, pms.head) + size + align <= pms.capacity, "Out of permanent memory.");
     void* p = mem_align_forward(pms.head, align);
     pms.head += size + align;
     return p;
@@ -57,12 +69,12 @@ struct TempMemoryStorage
 {
     unsigned char* start;
     unsigned char* head;
-    unsigned capacity;
+    size_t capacity;
 };
 
 static TempMemoryStorage tms;
 
-void temp_memory_blob_init(void* start, unsigned capacity)
+void temp_memory_blob_init(void* start, size_t capacity)
 {
     memzero(&tms, TempMemoryStorage);
     tms.start = (unsigned char*)start;
@@ -75,16 +87,16 @@ struct TempMemoryHeader
     bool freed;
     TempMemoryHeader* prev;
     TempMemoryHeader* prev_for_allocator;
-    unsigned offset_to_next;
+    size_t offset_to_next;
 };
 
-static void* temp_memory_blob_alloc(unsigned size, void* allocator_latest, unsigned align)
+static void* temp_memory_blob_alloc(size_t size, void* allocator_latest, unsigned align)
 {
-    static const unsigned header_align = alignof(TempMemoryHeader);
-    static const unsigned header_size = sizeof(TempMemoryHeader);
-    static const unsigned diff_to_header_size = sizeof(unsigned);
-    Assert(mem_ptr_diff(tms.start, tms.head + align + header_align + size + header_size + diff_to_header_size) < tms.capacity, "Out of temp memory");
-    TempMemoryHeader* tmh = (TempMemoryHeader*)mem_align_forward(tms.head, header_align);
+    static const size_t header_align = alignof(TempMemoryHeader);
+    static const size_t header_size = sizeof(TempMemoryHeader);
+    static const size_t diff_to_header_size = sizeof(unsigned);
+    Assert(size < tms.capacity && mem_ptr_diff(tms.start, tms.head) + align + header_align + header_size + diff_to_header_size + size < tms.capacity, "Out of temp memory");
+    TempMemoryHeader* tmh = (TempMemoryHeader*)mem_align_forward(tms.head, unsigned(header_align));
     tmh->freed = false;
 
     tmh->prev_for_allocator = allocator_latest == nullptr
@@ -100,14 +112,14 @@ static void* temp_memory_blob_alloc(unsigned size, void* allocator_latest, unsig
     // Set next block's prev to this one.
     if (mem_ptr_diff(tms.start, tms.head + header_align + diff_to_header_size + header_size) < tms.capacity)
     {
-        TempMemoryHeader* next_header = (TempMemoryHeader*)mem_align_forward(tms.head, header_align);
+        TempMemoryHeader* next_header = (TempMemoryHeader*)mem_align_forward(tms.head, unsigned(header_align));
         next_header->prev = tmh;
     }
     
     // The reason we add the diff_to_header is so we know how far back the header is, since the diff caused by the alignment varies.
     void* after_header = mem_ptr_add(tmh, header_size + diff_to_header_size);
     void* ptr_return = mem_align_forward(after_header, align);
-    unsigned diff_to_header = mem_ptr_diff(tmh, ptr_return);
+    unsigned diff_to_header = unsigned(mem_ptr_diff(tmh, ptr_return));
     *(unsigned*)mem_ptr_sub(ptr_return, diff_to_header_size) = diff_to_header;
     return ptr_return;
 }
@@ -144,7 +156,7 @@ static void temp_memory_blob_dealloc(void* ptr)
         : (unsigned char*)mem_ptr_add(tmh, tmh->offset_to_next);
 }
 
-void* temp_allocator_alloc(Allocator* allocator, unsigned size, unsigned align)
+void* temp_allocator_alloc(Allocator* allocator, size_t size, unsigned align)
 {
     void* p = temp_memory_blob_alloc(size, allocator->last_alloc, align);
     Assert(p != nullptr, "Failed to allocate memory.");
@@ -156,6 +168,29 @@ void temp_allocator_dealloc(Allocator* allocator, void* ptr)
 {
 }
 
+// Only the block at the very end of temp memory can be resized, which is the common case for an array that
+// keeps growing while nothing else is allocated.
+bool temp_allocator_try_extend(Allocator* allocator, void* ptr, size_t new_size)
+{
+    static const size_t header_align = alignof(TempMemoryHeader);
+    static const size_t header_size = sizeof(TempMemoryHeader);
+    static const size_t diff_to_header_size = sizeof(unsigned);
+    unsigned diff_to_header = *(unsigned*)mem_ptr_sub(ptr, diff_to_header_size);
+    TempMemoryHeader* tmh = (TempMemoryHeader*)mem_ptr_sub(ptr, diff_to_header);
+
+    if (mem_ptr_add(tmh, tmh->offset_to_next) != tms.head)
+        return false;
+
+    if (new_size >= tms.capacity || mem_ptr_diff(tms.start, ptr) + new_size + header_align + header_size + diff_to_header_size >= tms.capacity)
+        return false;
+
+    tms.head = (unsigned char*)mem_ptr_add(ptr, new_size);
+    tmh->offset_to_next = mem_ptr_diff(tmh, tms.head);
+    TempMemoryHeader* next_header = (TempMemoryHeader*)mem_align_forward(tms.head, unsigned(header_align));
+    next_header->prev = tmh;
+    return true;
+}
+
 void temp_allocator_dealloc_all(Allocator* allocator)
 {
     if (allocator->last_alloc == nullptr)
@@ -165,92 +200,769 @@ void temp_allocator_dealloc_all(Allocator* allocator)
 }
 
 #if defined(ENABLE_MEMORY_TRACING)
-static const unsigned max_captured_callstacks = 1024;
+#include <stdio.h>
+
+// Every unique callstack is stored once in callstacks, found through the open-addressed callstack_lookup
+// (hash -> index + 1). Live allocations map pointer -> callstack index in another open-addressed table, so
+// tracing costs a stack capture plus two hash lookups per malloc/free instead of linear scans.
+
+struct TracedCallstack
+{
+    CapturedCallstack callstack;
+    unsigned hash;
+    unsigned num_allocations;
+    size_t num_bytes;
+};
+
+struct TracedAllocation
+{
+    void* ptr;
+    size_t size;
+    unsigned callstack_index;
+};
+
+struct MemoryTracer
+{
+    TracedCallstack* callstacks;
+    unsigned num_callstacks;
+    unsigned callstacks_capacity;
+    unsigned* callstack_lookup;
+    unsigned callstack_lookup_capacity;
+    TracedAllocation* allocations;
+    unsigned allocations_capacity;
+    unsigned num_allocations;
+    unsigned num_tombstones;
+};
+
+static void* const tombstone_ptr = (void*)1;
+
+static unsigned hash_ptr(void* p)
+{
+    uintptr_t pi = uintptr_t(p) >> 3;
+    return (unsigned)(pi ^ (pi >> 32)) * 2654435761u;
+}
+
+static void* tracer_calloc(size_t num, size_t size)
+{
+    void* p = calloc(num, size);
+    Assert(p != nullptr, "Out of memory in memory tracer.");
+    return p;
+}
 
-static void add_captured_callstack(CapturedCallstack* callstacks, const CapturedCallstack& cc)
+static void tracer_insert_allocation(MemoryTracer* t, const TracedAllocation& ta)
 {
-    for (unsigned i = 0; i < max_captured_callstacks; ++i)
+    unsigned mask = t->allocations_capacity - 1;
+
+    for (unsigned i = hash_ptr(ta.ptr) & mask;; i = (i + 1) & mask)
     {
-        if (!callstacks[i].used)
+        TracedAllocation& slot = t->allocations[i];
+
+        if (slot.ptr == nullptr || slot.ptr == tombstone_ptr)
         {
-            callstacks[i] = cc;
+            if (slot.ptr == tombstone_ptr)
+                --t->num_tombstones;
+
+            slot = ta;
+            ++t->num_allocations;
             return;
         }
     }
+}
+
+static void tracer_grow_allocations(MemoryTracer* t)
+{
+    TracedAllocation* old_allocations = t->allocations;
+    unsigned old_capacity = t->allocations_capacity;
+
+    // Only grow if the table is full of live entries, otherwise just rehash to get rid of tombstones.
+    if (t->allocations_capacity == 0)
+        t->allocations_capacity = 4096;
+    else if (t->num_allocations * 2 >= t->allocations_capacity)
+        t->allocations_capacity *= 2;
+
+    t->allocations = (TracedAllocation*)tracer_calloc(t->allocations_capacity, sizeof(TracedAllocation));
+    t->num_allocations = 0;
+    t->num_tombstones = 0;
 
-    Error("Out of callstacks. Increase max_captured_callstacks in memory.h.");
+    for (unsigned i = 0; i < old_capacity; ++i)
+    {
+        if (old_allocations[i].ptr != nullptr && old_allocations[i].ptr != tombstone_ptr)
+            tracer_insert_allocation(t, old_allocations[i]);
+    }
+
+    free(old_allocations);
 }
 
-static void remove_captured_callstack(CapturedCallstack* callstacks, void* p)
+static void tracer_insert_callstack_lookup(MemoryTracer* t, unsigned hash, unsigned index)
 {
-    for (unsigned i = 0; i < max_captured_callstacks; ++i) {
-        if (callstacks[i].ptr == p)
+    unsigned mask = t->callstack_lookup_capacity - 1;
+    unsigned i = hash & mask;
+
+    while (t->callstack_lookup[i] != 0)
+        i = (i + 1) & mask;
+
+    t->callstack_lookup[i] = index + 1;
+}
+
+static unsigned tracer_find_or_add_callstack(MemoryTracer* t, const CapturedCallstack& cc)
+{
+    unsigned hash = callstack_hash(cc);
+    unsigned mask = t->callstack_lookup_capacity - 1;
+
+    for (unsigned i = hash & mask; t->callstack_lookup[i] != 0; i = (i + 1) & mask)
+    {
+        unsigned index = t->callstack_lookup[i] - 1;
+        const TracedCallstack& tc = t->callstacks[index];
+
+        if (tc.hash == hash && callstack_equal(tc.callstack, cc))
+            return index;
+    }
+
+    if (t->num_callstacks == t->callstacks_capacity)
+    {
+        t->callstacks_capacity *= 2;
+        t->callstacks = (TracedCallstack*)realloc(t->callstacks, t->callstacks_capacity * sizeof(TracedCallstack));
+        Assert(t->callstacks != nullptr, "Out of memory in memory tracer.");
+    }
+
+    unsigned index = t->num_callstacks++;
+    TracedCallstack& tc = t->callstacks[index];
+    tc.callstack = cc;
+    tc.hash = hash;
+    tc.num_allocations = 0;
+    tc.num_bytes = 0;
+
+    if (t->num_callstacks * 2 > t->callstack_lookup_capacity)
+    {
+        free(t->callstack_lookup);
+        t->callstack_lookup_capacity *= 2;
+        t->callstack_lookup = (unsigned*)tracer_calloc(t->callstack_lookup_capacity, sizeof(unsigned));
+
+        for (unsigned i = 0; i < t->num_callstacks; ++i)
+            tracer_insert_callstack_lookup(t, t->callstacks[i].hash, i);
+    }
+    else
+        tracer_insert_callstack_lookup(t, hash, index);
+
+    return index;
+}
+
+static MemoryTracer* tracer_create()
+{
+    MemoryTracer* t = (MemoryTracer*)tracer_calloc(1, sizeof(MemoryTracer));
+    t->callstacks_capacity = 256;
+    t->callstacks = (TracedCallstack*)tracer_calloc(t->callstacks_capacity, sizeof(TracedCallstack));
+    t->callstack_lookup_capacity = 1024;
+    t->callstack_lookup = (unsigned*)tracer_calloc(t->callstack_lookup_capacity, sizeof(unsigned));
+    tracer_grow_allocations(t);
+    return t;
+}
+
+static void tracer_destroy(MemoryTracer* t)
+{
+    free(t->callstacks);
+    free(t->callstack_lookup);
+    free(t->allocations);
+    free(t);
+}
+
+static void tracer_add_allocation(MemoryTracer* t, void* p, size_t size, const CapturedCallstack& cc)
+{
+    if ((t->num_allocations + t->num_tombstones + 1) * 4 > t->allocations_capacity * 3)
+        tracer_grow_allocations(t);
+
+    TracedAllocation ta = {};
+    ta.ptr = p;
+    ta.size = size;
+    ta.callstack_index = tracer_find_or_add_callstack(t, cc);
+    TracedCallstack& tc = t->callstacks[ta.callstack_index];
+    ++tc.num_allocations;
+    tc.num_bytes += size;
+    tracer_insert_allocation(t, ta);
+}
+
+static TracedAllocation* tracer_find_allocation(MemoryTracer* t, void* p)
+{
+    unsigned mask = t->allocations_capacity - 1;
+
+    for (unsigned i = hash_ptr(p) & mask; t->allocations[i].ptr != nullptr; i = (i + 1) & mask)
+    {
+        if (t->allocations[i].ptr == p)
+            return t->allocations + i;
+    }
+
+    Error("Failed to find traced allocation.");
+    return nullptr;
+}
+
+static void tracer_resize_allocation(MemoryTracer* t, void* p, size_t new_size)
+{
+    TracedAllocation* ta = tracer_find_allocation(t, p);
+    TracedCallstack& tc = t->callstacks[ta->callstack_index];
+    tc.num_bytes = tc.num_bytes - ta->size + new_size;
+    ta->size = new_size;
+}
+
+static void tracer_remove_allocation(MemoryTracer* t, void* p)
+{
+    TracedAllocation* ta = tracer_find_allocation(t, p);
+    TracedCallstack& tc = t->callstacks[ta->callstack_index];
+    --tc.num_allocations;
+    tc.num_bytes -= ta->size;
+    ta->ptr = tombstone_ptr;
+    --t->num_allocations;
+    ++t->num_tombstones;
+}
+
+static int compare_leaks(const void* p1, const void* p2)
+{
+    const TracedCallstack* c1 = *(const TracedCallstack**)p1;
+    const TracedCallstack* c2 = *(const TracedCallstack**)p2;
+    return c1->num_bytes < c2->num_bytes ? 1 : (c1->num_bytes > c2->num_bytes ? -1 : 0);
+}
+
+// Prints one report per leaking callstack, largest leak first.
+static void tracer_report_leaks(MemoryTracer* t)
+{
+    unsigned num_leaking = 0;
+    TracedCallstack** leaking = (TracedCallstack**)tracer_calloc(t->num_callstacks + 1, sizeof(TracedCallstack*));
+
+    for (unsigned i = 0; i < t->num_callstacks; ++i)
+    {
+        if (t->callstacks[i].num_allocations > 0)
+            leaking[num_leaking++] = t->callstacks + i;
+    }
+
+    qsort(leaking, num_leaking, sizeof(TracedCallstack*), compare_leaks);
+
+    for (unsigned i = 0; i < num_leaking; ++i)
+    {
+        char caption[128];
+        snprintf(caption, sizeof(caption), "Memory leak %u/%u: %u allocations, %zu bytes", i + 1, num_leaking,
+            leaking[i]->num_allocations, leaking[i]->num_bytes);
+        callstack_print(caption, leaking[i]->callstack);
+    }
+
+    free(leaking);
+}
+#endif
+
+// The heap allocator is a TLSF (two-level segregated fit) allocator: free blocks are binned by a first level
+// power of two and 32 linear second level subdivisions, with bitmaps to find a non-empty bin, so both alloc and
+// dealloc are O(1). Every thread gets its own heap carved from large OS regions. Each block header points back
+// at its heap; frees from the owning thread coalesce immediately, frees from other threads are pushed onto the
+// owner's lock-free remote list and coalesced the next time the owner allocates.
+
+static const size_t HeapRegionSize = 64 * 1024 * 1024;
+static const unsigned HeapAlignLog2 = 3;
+static const size_t HeapAlign = size_t(1) << HeapAlignLog2;
+static const unsigned HeapSlLog2 = 5;
+static const unsigned HeapSlCount = 1 << HeapSlLog2;
+static const unsigned HeapFlShift = HeapSlLog2 + HeapAlignLog2;
+static const unsigned HeapMaxBlockLog2 = 48;
+static const unsigned HeapFlCount = HeapMaxBlockLog2 - HeapFlShift + 1;
+static const size_t HeapSmallBlockSize = size_t(1) << HeapFlShift;
+static const size_t HeapBlockFree = 1;
+
+struct Heap;
+
+struct HeapBlock
+{
+    HeapBlock* prev_physical;
+    size_t size; // Payload size, lowest bit is HeapBlockFree.
+    Heap* heap;
+
+    // Only valid while the block is free or pending on a remote free list, lives in the payload.
+    HeapBlock* next_free;
+    HeapBlock* prev_free;
+};
+
+static const size_t HeapBlockHeaderSize = offsetof(HeapBlock, next_free);
+static const size_t HeapMinPayloadSize = sizeof(HeapBlock) - HeapBlockHeaderSize;
+static const size_t HeapMinBlockSize = sizeof(HeapBlock);
+
+// Lives at the start of every OS region, followed by one big block and a zero-sized sentinel block.
+struct HeapRegion
+{
+    size_t size;
+    size_t padding;
+};
+
+struct Heap
+{
+    unsigned long long fl_bitmap;
+    unsigned sl_bitmap[HeapFlCount];
+    HeapBlock* free_lists[HeapFlCount][HeapSlCount];
+    std::atomic<HeapBlock*> remote_frees;
+    Heap* next_abandoned;
+};
+
+static void* os_alloc(size_t size)
+{
+    #if defined(_WIN32)
+        return VirtualAlloc(nullptr, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    #else
+        void* p = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        return p == MAP_FAILED ? nullptr : p;
+    #endif
+}
+
+static void os_free(void* p, size_t size)
+{
+    #if defined(_WIN32)
+        Unused(size);
+        VirtualFree(p, 0, MEM_RELEASE);
+    #else
+        munmap(p, size);
+    #endif
+}
+
+static unsigned bit_scan_reverse(unsigned long long v)
+{
+    #if defined(_MSC_VER)
+        unsigned long i;
+        _BitScanReverse64(&i, v);
+        return i;
+    #else
+        return 63 - __builtin_clzll(v);
+    #endif
+}
+
+static unsigned bit_scan_forward(unsigned long long v)
+{
+    #if defined(_MSC_VER)
+        unsigned long i;
+        _BitScanForward64(&i, v);
+        return i;
+    #else
+        return __builtin_ctzll(v);
+    #endif
+}
+
+static size_t heap_block_size(const HeapBlock* b)
+{
+    return b->size & ~HeapBlockFree;
+}
+
+static bool heap_block_is_free(const HeapBlock* b)
+{
+    return (b->size & HeapBlockFree) != 0;
+}
+
+static void* heap_block_payload(HeapBlock* b)
+{
+    return mem_ptr_add(b, HeapBlockHeaderSize);
+}
+
+static HeapBlock* heap_block_from_payload(void* p)
+{
+    return (HeapBlock*)mem_ptr_sub(p, HeapBlockHeaderSize);
+}
+
+static HeapBlock* heap_block_next(HeapBlock* b)
+{
+    return (HeapBlock*)mem_ptr_add(b, HeapBlockHeaderSize + heap_block_size(b));
+}
+
+static void heap_mapping_insert(size_t size, unsigned* fl, unsigned* sl)
+{
+    if (size < HeapSmallBlockSize)
+    {
+        *fl = 0;
+        *sl = unsigned(size >> HeapAlignLog2);
+        return;
+    }
+
+    unsigned f = bit_scan_reverse(size);
+    *sl = unsigned(size >> (f - HeapSlLog2)) ^ HeapSlCount;
+    *fl = f - HeapFlShift + 1;
+}
+
+// Rounds up to the next bin so that any block found there is large enough.
+static void heap_mapping_search(size_t size, unsigned* fl, unsigned* sl)
+{
+    if (size >= HeapSmallBlockSize)
+        size += (size_t(1) << (bit_scan_reverse(size) - HeapSlLog2)) - 1;
+
+    heap_mapping_insert(size, fl, sl);
+}
+
+static void heap_insert_free_block(Heap* heap, HeapBlock* b)
+{
+    unsigned fl, sl;
+    heap_mapping_insert(heap_block_size(b), &fl, &sl);
+    HeapBlock* head = heap->free_lists[fl][sl];
+    b->size |= HeapBlockFree;
+    b->prev_free = nullptr;
+    b->next_free = head;
+
+    if (head != nullptr)
+        head->prev_free = b;
+
+    heap->free_lists[fl][sl] = b;
+    heap->fl_bitmap |= 1ull << fl;
+    heap->sl_bitmap[fl] |= 1u << sl;
+}
+
+static void heap_remove_free_block(Heap* heap, HeapBlock* b)
+{
+    unsigned fl, sl;
+    heap_mapping_insert(heap_block_size(b), &fl, &sl);
+
+    if (b->prev_free != nullptr)
+        b->prev_free->next_free = b->next_free;
+    else
+        heap->free_lists[fl][sl] = b->next_free;
+
+    if (b->next_free != nullptr)
+        b->next_free->prev_free = b->prev_free;
+
+    if (heap->free_lists[fl][sl] == nullptr)
+    {
+        heap->sl_bitmap[fl] &= ~(1u << sl);
+
+        if (heap->sl_bitmap[fl] == 0)
+            heap->fl_bitmap &= ~(1ull << fl);
+    }
+
+    b->size &= ~HeapBlockFree;
+}
+
+static HeapBlock* heap_find_free_block(Heap* heap, size_t size)
+{
+    unsigned fl, sl;
+    heap_mapping_search(size, &fl, &sl);
+
+    if (fl >= HeapFlCount)
+        return nullptr;
+
+    unsigned sl_map = heap->sl_bitmap[fl] & (~0u << sl);
+
+    if (sl_map == 0)
+    {
+        unsigned long long fl_map = heap->fl_bitmap & (~0ull << (fl + 1));
+
+        if (fl_map == 0)
+            return nullptr;
+
+        fl = bit_scan_forward(fl_map);
+        sl_map = heap->sl_bitmap[fl];
+    }
+
+    return heap->free_lists[fl][bit_scan_forward(sl_map)];
+}
+
+// Splits off everything after the first size bytes of the payload into a new free block, if it is big enough.
+static void heap_split_block(Heap* heap, HeapBlock* b, size_t size)
+{
+    size_t block_size = heap_block_size(b);
+
+    if (block_size < size + HeapMinBlockSize)
+        return;
+
+    HeapBlock* rest = (HeapBlock*)mem_ptr_add(heap_block_payload(b), size);
+    rest->prev_physical = b;
+    rest->size = block_size - size - HeapBlockHeaderSize;
+    rest->heap = heap;
+    heap_block_next(rest)->prev_physical = rest;
+    b->size = size | (b->size & HeapBlockFree);
+    heap_insert_free_block(heap, rest);
+}
+
+static void heap_free_block(Heap* heap, HeapBlock* b)
+{
+    HeapBlock* prev = b->prev_physical;
+
+    if (prev != nullptr && heap_block_is_free(prev))
+    {
+        heap_remove_free_block(heap, prev);
+        prev->size += HeapBlockHeaderSize + heap_block_size(b);
+        heap_block_next(prev)->prev_physical = prev;
+        b = prev;
+    }
+
+    HeapBlock* next = heap_block_next(b);
+
+    if (heap_block_is_free(next))
+    {
+        heap_remove_free_block(heap, next);
+        b->size = (heap_block_size(b) + HeapBlockHeaderSize + heap_block_size(next)) | (b->size & HeapBlockFree);
+        heap_block_next(b)->prev_physical = b;
+    }
+
+    // Oversized regions, made for single huge allocations, are given back to the OS once empty.
+    if (b->prev_physical == nullptr && heap_block_size(heap_block_next(b)) == 0)
+    {
+        HeapRegion* region = (HeapRegion*)mem_ptr_sub(b, sizeof(HeapRegion));
+
+        if (region->size > HeapRegionSize)
         {
-            callstack_destroy(callstacks + i);
+            os_free(region, region->size);
             return;
         }
     }
 
-    Error("Failed to find callstack in remove_captured_callstack.");
+    heap_insert_free_block(heap, b);
 }
 
-static void ensure_captured_callstacks_unused(CapturedCallstack* callstacks)
+static bool heap_add_region(Heap* heap, size_t min_payload_size)
 {
-    for (unsigned i = 0; i < max_captured_callstacks; ++i)
+    static const size_t overhead = sizeof(HeapRegion) + 2 * HeapBlockHeaderSize;
+    static const size_t granularity = 64 * 1024;
+    size_t region_size = min_payload_size + overhead > HeapRegionSize
+        ? (min_payload_size + overhead + granularity - 1) & ~(granularity - 1)
+        : HeapRegionSize;
+
+    HeapRegion* region = (HeapRegion*)os_alloc(region_size);
+
+    if (region == nullptr)
+        return false;
+
+    region->size = region_size;
+    HeapBlock* b = (HeapBlock*)mem_ptr_add(region, sizeof(HeapRegion));
+    b->prev_physical = nullptr;
+    b->size = region_size - overhead;
+    b->heap = heap;
+    HeapBlock* sentinel = heap_block_next(b);
+    sentinel->prev_physical = b;
+    sentinel->size = 0;
+    sentinel->heap = heap;
+    heap_insert_free_block(heap, b);
+    return true;
+}
+
+static void heap_process_remote_frees(Heap* heap)
+{
+    if (heap->remote_frees.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+    HeapBlock* b = heap->remote_frees.exchange(nullptr, std::memory_order_acquire);
+
+    while (b != nullptr)
     {
-        if (!callstacks[i].used)
-            continue;
+        HeapBlock* next = b->next_free;
+        heap_free_block(heap, b);
+        b = next;
+    }
+}
 
-        callstack_print("Memory leak stack trace", callstacks[i]);
+static size_t greatest_common_divisor(size_t a, size_t b)
+{
+    while (b != 0)
+    {
+        size_t t = a % b;
+        a = b;
+        b = t;
     }
+
+    return a;
 }
-#endif
 
-void* heap_allocator_alloc(Allocator* allocator, unsigned size, unsigned align)
+static size_t heap_round_size(size_t size)
 {
-    ++allocator->num_allocations;
-    static const unsigned diff_to_header_size = sizeof(unsigned);
-    void* p = malloc(size + align + diff_to_header_size);
+    size = (size + HeapAlign - 1) & ~(HeapAlign - 1);
+    return size < HeapMinPayloadSize ? HeapMinPayloadSize : size;
+}
 
-    #if defined(ENABLE_MEMORY_TRACING)
-        if (allocator->captured_callstacks == nullptr)
+static void* heap_alloc(Heap* heap, size_t size, size_t align)
+{
+    heap_process_remote_frees(heap);
+    size = heap_round_size(size);
+
+    // Payloads are always HeapAlign aligned, so other alignments need to be combined with that. Instead of
+    // over-allocating the block itself, a larger block is searched for and the unused head is split off as
+    // a free block of its own.
+    const bool needs_alignment = HeapAlign % align != 0;
+    const size_t block_align = needs_alignment ? align / greatest_common_divisor(align, HeapAlign) * HeapAlign : HeapAlign;
+    const size_t search_size = needs_alignment ? size + block_align + HeapMinBlockSize : size;
+    HeapBlock* b = heap_find_free_block(heap, search_size);
+
+    if (b == nullptr)
+    {
+        if (!heap_add_region(heap, search_size + (search_size >> HeapSlLog2) + HeapSmallBlockSize))
+            return nullptr;
+
+        b = heap_find_free_block(heap, search_size);
+        Assert(b != nullptr, "Failed finding block in newly added heap region.");
+    }
+
+    heap_remove_free_block(heap, b);
+
+    if (needs_alignment)
+    {
+        void* payload = heap_block_payload(b);
+        void* aligned = mem_align_forward(payload, unsigned(block_align));
+
+        if (aligned != payload && mem_ptr_diff(payload, aligned) < HeapMinBlockSize)
+            aligned = mem_align_forward(mem_ptr_add(payload, HeapMinBlockSize), unsigned(block_align));
+
+        if (aligned != payload)
         {
-            unsigned cc_size = sizeof(CapturedCallstack) * max_captured_callstacks;
-            allocator->captured_callstacks = (CapturedCallstack*)malloc(cc_size);
-            memset(allocator->captured_callstacks, 0, cc_size);
+            size_t head_size = mem_ptr_diff(payload, aligned);
+            HeapBlock* aligned_block = heap_block_from_payload(aligned);
+            aligned_block->prev_physical = b;
+            aligned_block->size = heap_block_size(b) - head_size;
+            aligned_block->heap = heap;
+            heap_block_next(aligned_block)->prev_physical = aligned_block;
+            b->size = head_size - HeapBlockHeaderSize;
+            heap_insert_free_block(heap, b);
+            b = aligned_block;
         }
+    }
 
-        add_captured_callstack(allocator->captured_callstacks, callstack_capture(1, p));
-    #endif
+    heap_split_block(heap, b, size);
+    return heap_block_payload(b);
+}
 
-    void* after_header = mem_ptr_add(p, diff_to_header_size);
-    void* ptr_return = mem_align_forward(after_header, align);
-    // Since we don't know how much we align every time, we have a little header which says how far back the actual ptr lives.
-    unsigned diff_to_header = mem_ptr_diff(p, ptr_return);
-    *(unsigned*)mem_ptr_sub(ptr_return, diff_to_header_size) = diff_to_header;
-    return ptr_return;
+// Grows the block into the physically next block if that one is free, or shrinks it by splitting off the end.
+static bool heap_try_resize(Heap* current_heap, void* p, size_t new_size)
+{
+    HeapBlock* b = heap_block_from_payload(p);
+    Heap* heap = b->heap;
+
+    if (heap != current_heap)
+        return false;
+
+    heap_process_remote_frees(heap);
+    new_size = heap_round_size(new_size);
+    size_t size = heap_block_size(b);
+    HeapBlock* next = heap_block_next(b);
+    bool next_free = heap_block_is_free(next);
+
+    if (new_size > size && (!next_free || size + HeapBlockHeaderSize + heap_block_size(next) < new_size))
+        return false;
+
+    if (next_free)
+    {
+        heap_remove_free_block(heap, next);
+        b->size = size + HeapBlockHeaderSize + heap_block_size(next);
+        heap_block_next(b)->prev_physical = b;
+    }
+
+    heap_split_block(heap, b, new_size);
+    return true;
 }
 
-void heap_allocator_dealloc(Allocator* allocator, void* aligned_ptr)
+static void heap_dealloc(Heap* current_heap, void* p)
 {
-    if (aligned_ptr == nullptr)
+    HeapBlock* b = heap_block_from_payload(p);
+    Heap* owner = b->heap;
+
+    if (owner == current_heap)
+    {
+        heap_free_block(owner, b);
         return;
+    }
+
+    HeapBlock* head = owner->remote_frees.load(std::memory_order_relaxed);
+
+    do
+    {
+        b->next_free = head;
+    }
+    while (!owner->remote_frees.compare_exchange_weak(head, b, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// Heaps of exited threads are kept and handed to the next thread that needs a heap, so that blocks still alive
+// in them, and remote frees made to them, are not lost.
+static std::mutex abandoned_heaps_mutex;
+static Heap* abandoned_heaps;
+
+struct HeapThreadCache
+{
+    ~HeapThreadCache()
+    {
+        if (heap == nullptr)
+            return;
+
+        std::lock_guard<std::mutex> lock(abandoned_heaps_mutex);
+        heap->next_abandoned = abandoned_heaps;
+        abandoned_heaps = heap;
+    }
+
+    Heap* heap;
+};
+
+static thread_local HeapThreadCache heap_thread_cache;
 
-    unsigned diff_to_header = *(unsigned*)mem_ptr_sub(aligned_ptr, sizeof(unsigned));
-    void* p = mem_ptr_sub(aligned_ptr, diff_to_header);
+static Heap* heap_for_current_thread()
+{
+    if (heap_thread_cache.heap != nullptr)
+        return heap_thread_cache.heap;
+
+    Heap* heap = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(abandoned_heaps_mutex);
+
+        if (abandoned_heaps != nullptr)
+        {
+            heap = abandoned_heaps;
+            abandoned_heaps = heap->next_abandoned;
+        }
+    }
+
+    if (heap == nullptr)
+    {
+        void* heap_memory = os_alloc(sizeof(Heap));
+        Assert(heap_memory != nullptr, "Failed allocating heap.");
+        heap = new (heap_memory) Heap();
+    }
+
+    heap_thread_cache.heap = heap;
+    return heap;
+}
+
+void* heap_allocator_alloc(Allocator* allocator, size_t size, unsigned align)
+{
+    ++allocator->num_allocations;
+    void* p = heap_alloc(heap_for_current_thread(), size, align);
+    Assert(p != nullptr, "Out of heap memory.");
 
     #if defined(ENABLE_MEMORY_TRACING)
-        remove_captured_callstack(allocator->captured_callstacks, p);
+        if (allocator->tracer == nullptr)
+            allocator->tracer = tracer_create();
+
+        tracer_add_allocation(allocator->tracer, p, size, callstack_capture(1));
     #endif
 
-    free(p);
+    return p;
+}
+
+void heap_allocator_dealloc(Allocator* allocator, void* p)
+{
+    if (p == nullptr)
+        return;
+
+    #if defined(ENABLE_MEMORY_TRACING)
+        tracer_remove_allocation(allocator->tracer, p);
+    #endif
+
+    heap_dealloc(heap_for_current_thread(), p);
     --allocator->num_allocations;
 }
 
+bool heap_allocator_try_extend(Allocator* allocator, void* ptr, size_t new_size)
+{
+    if (!heap_try_resize(heap_for_current_thread(), ptr, new_size))
+        return false;
+
+    #if defined(ENABLE_MEMORY_TRACING)
+        tracer_resize_allocation(allocator->tracer, ptr, new_size);
+    #endif
+
+    return true;
+}
+
 void heap_allocator_check_clean(Allocator* allocator)
 {
     #if defined(ENABLE_MEMORY_TRACING)
-        ensure_captured_callstacks_unused(allocator->captured_callstacks);
+        if (allocator->tracer != nullptr)
+        {
+            tracer_report_leaks(allocator->tracer);
+            tracer_destroy(allocator->tracer);
+            allocator->tracer = nullptr;
+        }
     #endif
 
     Assert(allocator->num_allocations == 0, "Heap allocator not clean on shutdown.");
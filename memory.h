@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 
 //#define ENABLE_MEMORY_TRACING
 
@@ -16,7 +17,7 @@ struct Allocator
             out_of_scope(this);
     }
 
-    void* alloc(unsigned size, unsigned align = DefaultMemoryAlign)
+    void* alloc(size_t size, unsigned align = DefaultMemoryAlign)
     {
         return alloc_internal(this, size, align);
     }
@@ -26,36 +27,45 @@ struct Allocator
         dealloc_internal(this, ptr);
     }
 
-    void*(*alloc_internal)(Allocator* alloc, unsigned size, unsigned align);
+    // Tries to grow or shrink the allocation in place, returns false if ptr has to be moved.
+    bool try_extend(void* ptr, size_t new_size)
+    {
+        return try_extend_internal != nullptr && ptr != nullptr && try_extend_internal(this, ptr, new_size);
+    }
+
+    void*(*alloc_internal)(Allocator* alloc, size_t size, unsigned align);
     void(*dealloc_internal)(Allocator* alloc, void* ptr);
     void(*out_of_scope)(Allocator* alloc);
+    bool(*try_extend_internal)(Allocator* alloc, void* ptr, size_t new_size);
     void* last_alloc;
     unsigned num_allocations;
 
     #if defined(ENABLE_MEMORY_TRACING)
-        CapturedCallstack* captured_callstacks;
+        struct MemoryTracer* tracer;
     #endif
 };
 
-unsigned mem_ptr_diff(void* ptr1, void* ptr2);
-void* mem_ptr_add(void* ptr1, unsigned offset);
-void* mem_ptr_sub(void* ptr1, unsigned offset);
+size_t mem_ptr_diff(void* ptr1, void* ptr2);
+void* mem_ptr_add(void* ptr1, size_t offset);
+void* mem_ptr_sub(void* ptr1, size_t offset);
 void* mem_align_forward(void* p, unsigned align);
 
-void permanent_memory_blob_init(void* start, unsigned capacity);
-const unsigned PermanentMemorySize = 32 * 1024 * 1024;
-void* permanent_alloc(unsigned size, unsigned align = DefaultMemoryAlign);
+void permanent_memory_blob_init(void* start, size_t capacity);
+const size_t PermanentMemorySize = 32 * 1024 * 1024;
+void* permanent_alloc(size_t size, unsigned align = DefaultMemoryAlign);
 
-const unsigned TempMemorySize = 1024 * 1024 * 1024;
-void temp_memory_blob_init(void* start, unsigned capacity);
-void* temp_allocator_alloc(Allocator* allocator, unsigned size, unsigned align);
+const size_t TempMemorySize = size_t(1024) * 1024 * 1024;
+void temp_memory_blob_init(void* start, size_t capacity);
+void* temp_allocator_alloc(Allocator* allocator, size_t size, unsigned align);
 void temp_allocator_dealloc(Allocator* allocator, void* ptr);
 void temp_allocator_dealloc_all(Allocator* allocator);
+bool temp_allocator_try_extend(Allocator* allocator, void* ptr, size_t new_size);
 
-#define create_temp_allocator() {temp_allocator_alloc, temp_allocator_dealloc, temp_allocator_dealloc_all}
+#define create_temp_allocator() {temp_allocator_alloc, temp_allocator_dealloc, temp_allocator_dealloc_all, temp_allocator_try_extend}
 
 void heap_allocator_check_clean(Allocator* allocator);
-void* heap_allocator_alloc(Allocator* allocator, unsigned size, unsigned align);
+void* heap_allocator_alloc(Allocator* allocator, size_t size, unsigned align);
 void heap_allocator_dealloc(Allocator* allocator, void* ptr);
+bool heap_allocator_try_extend(Allocator* allocator, void* ptr, size_t new_size);
 
-#define create_heap_allocator() {heap_allocator_alloc, heap_allocator_dealloc, nullptr};
+#define create_heap_allocator() {heap_allocator_alloc, heap_allocator_dealloc, nullptr, heap_allocator_try_extend};
@@ -1,7 +1,10 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <thread>
 #include "helpers.h"
 #include "memory.cpp"
+#include "dynamic_array.h"
+#include "small_array.h"
 
 int main()
 {
@@ -58,6 +61,85 @@ int main()
 
     assert(tms.head == tms.start);
 
+    {
+        // Only the allocation at the end of temp memory can be resized in place.
+        Allocator ta = create_temp_allocator();
+        unsigned char* p1 = (unsigned char*)ta.alloc(128);
+        memset(p1, 0xa1, 128);
+        assert(ta.try_extend(p1, 1024));
+        memset(p1, 0xa2, 1024);
+        unsigned char* p2 = (unsigned char*)ta.alloc(128);
+        memset(p2, 0xa3, 128);
+        assert(mem_ptr_diff(p1, p2) >= 1024);
+        assert(!ta.try_extend(p1, 2048));
+        assert(ta.try_extend(p2, 64));
+        unsigned char* p3 = (unsigned char*)ta.alloc(128);
+        assert(mem_ptr_diff(p2, p3) < 128);
+
+        // Growing an array at the end of temp memory should not leave old copies behind.
+        DynamicArray<unsigned> da = dynamic_array_create<unsigned>(&ta);
+        unsigned char* before = tms.head;
+
+        for (unsigned i = 0; i < 100000; ++i)
+            da.add(i);
+
+        assert(mem_ptr_diff(before, tms.head) < da.capacity * sizeof(unsigned) + 128);
+        da.shrink_to_fit();
+        assert(da.capacity == da.num);
+        da.resize(da.num + 10);
+        assert(da[100005] == 0 && da[99999] == 99999);
+    }
+
+    assert(tms.head == tms.start);
+
+    {
+        Allocator a = create_heap_allocator();
+        unsigned char* p1 = (unsigned char*)a.alloc(128);
+        memset(p1, 0xc1, 128);
+        assert(a.try_extend(p1, 4096));
+        memset(p1, 0xc2, 4096);
+        assert(a.try_extend(p1, 64));
+        unsigned char* p2 = (unsigned char*)a.alloc(64);
+        memset(p2, 0xc3, 64);
+        assert(p1[63] == 0xc2);
+        a.dealloc(p1);
+        a.dealloc(p2);
+
+        DynamicArray<unsigned> da = dynamic_array_create<unsigned>(&a);
+        da.reserve(1000);
+        assert(da.capacity == 1000 && da.num == 0);
+
+        for (unsigned i = 0; i < 100000; ++i)
+            da.add(i);
+
+        for (unsigned i = 0; i < 100000; ++i)
+            assert(da[i] == i);
+
+        dynamic_array_destroy(&da);
+
+        // Small arrays only touch the allocator once they outgrow their inline storage.
+        SmallArray<unsigned, 4> sa = small_array_create<unsigned, 4>(&a);
+
+        for (unsigned i = 0; i < 4; ++i)
+            sa.add(i);
+
+        assert(sa.heap_data == nullptr && a.num_allocations == 0);
+
+        for (unsigned i = 4; i < 100; ++i)
+            sa.add(i);
+
+        assert(sa.heap_data != nullptr && a.num_allocations == 1);
+
+        for (unsigned i = 0; i < 100; ++i)
+            assert(sa[i] == i);
+
+        sa.resize(3);
+        sa.shrink_to_fit();
+        assert(sa.heap_data == nullptr && sa[2] == 2);
+        small_array_destroy(&sa);
+        heap_allocator_check_clean(&a);
+    }
+
     {
         Allocator a = create_heap_allocator();
         unsigned s = 128;
@@ -82,4 +164,65 @@ int main()
         a.dealloc(p4);
         a.dealloc(p5);
     }
+
+    {
+        // Blocks freed by another thread go through the owning heap's remote free list.
+        Allocator a = create_heap_allocator();
+        const unsigned num = 1024;
+        void* ptrs[num];
+
+        for (unsigned i = 0; i < num; ++i)
+        {
+            ptrs[i] = a.alloc(16 + i, i % 2 == 0 ? 64 : DefaultMemoryAlign);
+            memset(ptrs[i], 0xba, 16 + i);
+        }
+
+        std::thread t([&a, &ptrs, num]() {
+            for (unsigned i = 0; i < num; ++i)
+                a.dealloc(ptrs[i]);
+        });
+        t.join();
+
+        unsigned char* p = (unsigned char*)a.alloc(256, 4096);
+        memset(p, 0xbe, 256);
+        assert(uintptr_t(p) % 4096 == 0);
+        a.dealloc(p);
+        heap_allocator_check_clean(&a);
+    }
+
+    {
+        // Arenas and allocations larger than 4 GB. Only the ends are touched, so the pages in between are never committed.
+        const size_t big_arena_size = size_t(5) * 1024 * 1024 * 1024;
+        const size_t big_alloc_size = size_t(4) * 1024 * 1024 * 1024 + 1024;
+        void* big_arena = malloc(big_arena_size);
+
+        if (big_arena != nullptr)
+        {
+            temp_memory_blob_init(big_arena, big_arena_size);
+
+            {
+                Allocator ta = create_temp_allocator();
+                unsigned char* p1 = (unsigned char*)ta.alloc(big_alloc_size);
+                p1[0] = 0xa1;
+                p1[big_alloc_size - 1] = 0xa2;
+                unsigned char* p2 = (unsigned char*)ta.alloc(128, 64);
+                memset(p2, 0xa3, 128);
+                assert(uintptr_t(p2) % 64 == 0);
+                assert(mem_ptr_diff(p1, p2) >= big_alloc_size);
+                assert(p1[0] == 0xa1 && p1[big_alloc_size - 1] == 0xa2);
+            }
+
+            assert(tms.head == tms.start);
+            free(big_arena);
+            temp_memory_blob_init(temp_memory_block, temp_memory_size);
+        }
+
+        Allocator a = create_heap_allocator();
+        unsigned char* p = (unsigned char*)a.alloc(big_alloc_size, 64);
+        assert(p != nullptr && uintptr_t(p) % 64 == 0);
+        p[0] = 0xb1;
+        p[big_alloc_size - 1] = 0xb2;
+        a.dealloc(p);
+        heap_allocator_check_clean(&a);
+    }
 }
\ No newline at end of file
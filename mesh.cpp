@@ -0,0 +1,241 @@
+#include "memory.h"
+#include "mesh.h"
+
+static unsigned short float_to_half(float f)
+{
+    unsigned bits;
+    memcpy(&bits, &f, sizeof(bits));
+    unsigned sign = (bits >> 16) & 0x8000;
+    unsigned exponent = (bits >> 23) & 0xff;
+    unsigned mantissa = bits & 0x7fffff;
+
+    // Infinity and NaN, NaNs keep a mantissa bit so they stay NaN.
+    if (exponent == 0xff)
+        return (unsigned short)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+
+    int half_exponent = (int)exponent - 127 + 15;
+
+    if (half_exponent >= 0x1f)
+        return (unsigned short)(sign | 0x7c00);
+
+    if (half_exponent <= 0)
+    {
+        // Denormal half, or zero if it's too small for that too.
+        if (half_exponent < -10)
+            return (unsigned short)sign;
+
+        mantissa |= 0x800000;
+        unsigned shift = (unsigned)(14 - half_exponent);
+        unsigned half_mantissa = mantissa >> shift;
+        unsigned rest = mantissa & ((1u << shift) - 1);
+        unsigned halfway = 1u << (shift - 1);
+
+        if (rest > halfway || (rest == halfway && (half_mantissa & 1) != 0))
+            ++half_mantissa;
+
+        return (unsigned short)(sign | half_mantissa);
+    }
+
+    unsigned half = sign | ((unsigned)half_exponent << 10) | (mantissa >> 13);
+    unsigned rest = mantissa & 0x1fff;
+
+    // Round to nearest even. A carry out of the mantissa correctly bumps the exponent, up to infinity.
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1) != 0))
+        ++half;
+
+    return (unsigned short)half;
+}
+
+static float half_to_float(unsigned short h)
+{
+    unsigned sign = (unsigned)(h & 0x8000) << 16;
+    unsigned exponent = (h >> 10) & 0x1f;
+    unsigned mantissa = h & 0x3ff;
+    unsigned bits;
+
+    if (exponent == 0x1f)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else if (exponent != 0)
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    else if (mantissa == 0)
+        bits = sign;
+    else
+    {
+        // Denormal half, normalize it.
+        exponent = 127 - 15 + 1;
+
+        while ((mantissa & 0x400) == 0)
+        {
+            mantissa <<= 1;
+            --exponent;
+        }
+
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static float sign_not_zero(float f)
+{
+    return f >= 0.0f ? 1.0f : -1.0f;
+}
+
+static short float_to_snorm16(float f)
+{
+    f = f < -1.0f ? -1.0f : (f > 1.0f ? 1.0f : f);
+    return (short)(f >= 0.0f ? f * 32767.0f + 0.5f : f * 32767.0f - 0.5f);
+}
+
+static float snorm16_to_float(short s)
+{
+    float f = s / 32767.0f;
+    return f < -1.0f ? -1.0f : f;
+}
+
+static unsigned short float_to_unorm16(float f)
+{
+    f = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+    return (unsigned short)(f * 65535.0f + 0.5f);
+}
+
+static unsigned char float_to_unorm8(float f)
+{
+    f = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+    return (unsigned char)(f * 255.0f + 0.5f);
+}
+
+// Octahedral normal encoding: the normal is projected onto the octahedron |x| + |y| + |z| = 1, the lower half is
+// folded over the upper one, and the result is flattened to x and y.
+static void normal_encode(const Vector3& n, short* out)
+{
+    float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+
+    if (l1 == 0.0f)
+    {
+        out[0] = 0;
+        out[1] = 0;
+        return;
+    }
+
+    float x = n.x / l1;
+    float y = n.y / l1;
+
+    if (n.z < 0.0f)
+    {
+        float folded_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+        y = (1.0f - fabsf(x)) * sign_not_zero(y);
+        x = folded_x;
+    }
+
+    out[0] = float_to_snorm16(x);
+    out[1] = float_to_snorm16(y);
+}
+
+static Vector3 normal_decode(const short* e)
+{
+    Vector3 n = {snorm16_to_float(e[0]), snorm16_to_float(e[1]), 0.0f};
+    n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+
+    if (n.z < 0.0f)
+    {
+        float unfolded_x = (1.0f - fabsf(n.y)) * sign_not_zero(n.x);
+        n.y = (1.0f - fabsf(n.x)) * sign_not_zero(n.y);
+        n.x = unfolded_x;
+    }
+
+    return vector3_normalize(n);
+}
+
+PackedVertex vertex_pack(const Vertex& v, const Vector3& position_offset, const Vector3& position_scale)
+{
+    PackedVertex pv;
+    pv.position[0] = float_to_unorm16((v.position.x - position_offset.x) / position_scale.x);
+    pv.position[1] = float_to_unorm16((v.position.y - position_offset.y) / position_scale.y);
+    pv.position[2] = float_to_unorm16((v.position.z - position_offset.z) / position_scale.z);
+    pv.position[3] = 65535;
+    normal_encode(v.normal, pv.normal);
+    pv.uv[0] = float_to_half(v.uv.x);
+    pv.uv[1] = float_to_half(v.uv.y);
+    pv.color.r = float_to_unorm8(v.color.r);
+    pv.color.g = float_to_unorm8(v.color.g);
+    pv.color.b = float_to_unorm8(v.color.b);
+    pv.color.a = float_to_unorm8(v.color.a);
+    return pv;
+}
+
+Vertex vertex_unpack(const PackedVertex& pv, const Vector3& position_offset, const Vector3& position_scale)
+{
+    Vertex v;
+    v.position.x = position_offset.x + pv.position[0] / 65535.0f * position_scale.x;
+    v.position.y = position_offset.y + pv.position[1] / 65535.0f * position_scale.y;
+    v.position.z = position_offset.z + pv.position[2] / 65535.0f * position_scale.z;
+    v.normal = normal_decode(pv.normal);
+    v.uv.x = half_to_float(pv.uv[0]);
+    v.uv.y = half_to_float(pv.uv[1]);
+    v.color.r = pv.color.r / 255.0f;
+    v.color.g = pv.color.g / 255.0f;
+    v.color.b = pv.color.b / 255.0f;
+    v.color.a = pv.color.a / 255.0f;
+    return v;
+}
+
+Aabb vertices_bounds(const Vertex* vertices, size_t num_vertices)
+{
+    if (num_vertices == 0)
+        return {};
+
+    Aabb b = {vertices[0].position, vertices[0].position};
+
+    for (size_t i = 1; i < num_vertices; ++i)
+    {
+        const Vector3& p = vertices[i].position;
+        b.min = {p.x < b.min.x ? p.x : b.min.x, p.y < b.min.y ? p.y : b.min.y, p.z < b.min.z ? p.z : b.min.z};
+        b.max = {p.x > b.max.x ? p.x : b.max.x, p.y > b.max.y ? p.y : b.max.y, p.z > b.max.z ? p.z : b.max.z};
+    }
+
+    return b;
+}
+
+PackedMesh mesh_pack(Allocator* alloc, const Mesh& m)
+{
+    PackedMesh pm = {};
+    pm.vertices = dynamic_array_create<PackedVertex>(alloc);
+    pm.indices = dynamic_array_create<unsigned>(alloc);
+    pm.position_scale = {1, 1, 1};
+
+    if (m.vertices.num == 0)
+        return pm;
+
+    Aabb bounds = vertices_bounds(m.vertices.data, m.vertices.num);
+
+    // Flat meshes would divide by zero, any scale works for them.
+    pm.position_offset = bounds.min;
+    pm.position_scale = bounds.max - bounds.min;
+    pm.position_scale.x = pm.position_scale.x > 0.0f ? pm.position_scale.x : 1.0f;
+    pm.position_scale.y = pm.position_scale.y > 0.0f ? pm.position_scale.y : 1.0f;
+    pm.position_scale.z = pm.position_scale.z > 0.0f ? pm.position_scale.z : 1.0f;
+    pm.vertices.resize(m.vertices.num);
+
+    for (size_t i = 0; i < m.vertices.num; ++i)
+        pm.vertices[i] = vertex_pack(m.vertices[i], pm.position_offset, pm.position_scale);
+
+    pm.indices.resize(m.indices.num);
+    memcpy(pm.indices.data, m.indices.data, m.indices.num * sizeof(unsigned));
+    return pm;
+}
+
+Mesh mesh_unpack(Allocator* alloc, const PackedMesh& pm)
+{
+    Mesh m = mesh_create(alloc);
+    m.vertices.resize(pm.vertices.num);
+
+    for (size_t i = 0; i < pm.vertices.num; ++i)
+        m.vertices[i] = vertex_unpack(pm.vertices[i], pm.position_offset, pm.position_scale);
+
+    m.indices.resize(pm.indices.num);
+    memcpy(m.indices.data, pm.indices.data, pm.indices.num * sizeof(unsigned));
+    return m;
+}
@@ -8,6 +8,16 @@ struct Mesh
     DynamicArray<unsigned> indices;
 };
 
+// Mesh with packed vertices, see PackedVertex. A vertex position is position_offset + position * position_scale,
+// where each position component is a unorm16 in [0, 1].
+struct PackedMesh
+{
+    DynamicArray<PackedVertex> vertices;
+    DynamicArray<unsigned> indices;
+    Vector3 position_offset;
+    Vector3 position_scale;
+};
+
 inline Mesh mesh_create(Allocator* alloc)
 {
     Mesh m;
@@ -21,3 +31,19 @@ inline void mesh_destroy(Mesh* m)
     dynamic_array_destroy(&m->vertices);
     dynamic_array_destroy(&m->indices);
 }
+
+inline void packed_mesh_destroy(PackedMesh* m)
+{
+    dynamic_array_destroy(&m->vertices);
+    dynamic_array_destroy(&m->indices);
+}
+
+PackedVertex vertex_pack(const Vertex& v, const Vector3& position_offset, const Vector3& position_scale);
+Vertex vertex_unpack(const PackedVertex& pv, const Vector3& position_offset, const Vector3& position_scale);
+
+// The smallest box around the vertex positions, all zero if there are no vertices.
+Aabb vertices_bounds(const Vertex* vertices, size_t num_vertices);
+
+// Zero normals, which obj_load uses for vertices without one, can't be represented and unpack as (0, 0, 1).
+PackedMesh mesh_pack(Allocator* alloc, const Mesh& m);
+Mesh mesh_unpack(Allocator* alloc, const PackedMesh& pm);
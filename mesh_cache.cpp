@@ -0,0 +1,198 @@
+#include "mesh_cache.h"
+#include "memory.h"
+#include "mesh.h"
+#include "obj.h"
+#include "mesh_optimizer.h"
+#include "lightmap_uv.h"
+#include <stdio.h>
+
+static const unsigned MeshCacheMagic = 0x434d4b53; // "SKMC"
+static const unsigned MeshCacheVersion = 5;
+static const size_t MeshCacheAlign = 64;
+
+struct MeshCacheHeader
+{
+    unsigned magic;
+    unsigned version;
+    unsigned vertex_size;
+    unsigned index_format;
+    unsigned long long num_vertices;
+    unsigned long long num_indices;
+    unsigned long long indices_offset;
+    unsigned long long source_size;
+    long long source_modified_time;
+    unsigned lightmap_size;
+    LightmapScaleKey scale_key;
+    unsigned char padding[1];
+};
+
+static_assert(sizeof(MeshCacheHeader) == MeshCacheAlign, "Vertices must start aligned right after the header.");
+
+static size_t index_size(IndexFormat f)
+{
+    return f == IndexFormat::UInt16 ? sizeof(unsigned short) : sizeof(unsigned);
+}
+
+static size_t align_size(size_t s)
+{
+    return (s + MeshCacheAlign - 1) & ~(MeshCacheAlign - 1);
+}
+
+bool mesh_cache_write(Allocator* alloc, const Mesh& m, const FileInfo& source, unsigned lightmap_size, const LightmapScaleKey& scale_key,
+    const char* filename)
+{
+    IndexFormat index_format = m.vertices.num <= 0xffff ? IndexFormat::UInt16 : IndexFormat::UInt32;
+    size_t indices_offset = align_size(sizeof(MeshCacheHeader) + m.vertices.num * sizeof(Vertex));
+    size_t size = indices_offset + m.indices.num * index_size(index_format);
+    unsigned char* data = (unsigned char*)alloc->alloc(size, MeshCacheAlign);
+    memset(data, 0, indices_offset);
+
+    MeshCacheHeader* h = (MeshCacheHeader*)data;
+    h->magic = MeshCacheMagic;
+    h->version = MeshCacheVersion;
+    h->vertex_size = sizeof(Vertex);
+    h->index_format = (unsigned)index_format;
+    h->num_vertices = m.vertices.num;
+    h->num_indices = m.indices.num;
+    h->indices_offset = indices_offset;
+    h->source_size = source.size;
+    h->source_modified_time = source.modified_time;
+    h->lightmap_size = lightmap_size;
+    h->scale_key = scale_key;
+    memcpy(data + sizeof(MeshCacheHeader), m.vertices.data, m.vertices.num * sizeof(Vertex));
+
+    if (index_format == IndexFormat::UInt16)
+    {
+        unsigned short* indices = (unsigned short*)(data + indices_offset);
+
+        for (size_t i = 0; i < m.indices.num; ++i)
+            indices[i] = (unsigned short)m.indices[i];
+    }
+    else
+        memcpy(data + indices_offset, m.indices.data, m.indices.num * sizeof(unsigned));
+
+    bool written = file_write(data, size, filename);
+    alloc->dealloc(data);
+    return written;
+}
+
+CachedMesh mesh_cache_load(const char* filename, const FileInfo& source, unsigned lightmap_size, const LightmapScaleKey& scale_key)
+{
+    LoadedFile lf = file_map(filename);
+
+    if (!lf.valid)
+        return {false};
+
+    const MeshCacheHeader* h = (const MeshCacheHeader*)lf.file.data;
+    bool header_ok = lf.file.size >= sizeof(MeshCacheHeader)
+        && h->magic == MeshCacheMagic
+        && h->version == MeshCacheVersion
+        && h->vertex_size == sizeof(Vertex)
+        && h->index_format <= (unsigned)IndexFormat::UInt32
+        && h->source_size == source.size
+        && h->source_modified_time == source.modified_time
+        && h->lightmap_size == lightmap_size
+        && lightmap_scale_key_equal(h->scale_key, scale_key);
+
+    // A cache from a write that was cut short is shorter than the header says.
+    if (!header_ok || h->indices_offset < sizeof(MeshCacheHeader) + h->num_vertices * sizeof(Vertex)
+        || lf.file.size < h->indices_offset + h->num_indices * index_size((IndexFormat)h->index_format))
+    {
+        file_unmap(&lf.file);
+        return {false};
+    }
+
+    CachedMesh cm = {};
+    cm.valid = true;
+    cm.vertices = (const Vertex*)(lf.file.data + sizeof(MeshCacheHeader));
+    cm.num_vertices = (size_t)h->num_vertices;
+    cm.indices = lf.file.data + h->indices_offset;
+    cm.index_format = (IndexFormat)h->index_format;
+    cm.num_indices = (size_t)h->num_indices;
+    cm.mapped_file = lf.file;
+    return cm;
+}
+
+void mesh_cache_unload(CachedMesh* cm)
+{
+    if (cm->mapped_file.data != nullptr)
+        file_unmap(&cm->mapped_file);
+
+    if (cm->parsed_mesh.vertices.allocator != nullptr)
+    {
+        mesh_destroy(&cm->parsed_mesh);
+        cm->parsed_mesh = {};
+    }
+
+    cm->valid = false;
+}
+
+CachedMesh mesh_load_cached(Allocator* alloc, const char* obj_filename, unsigned lightmap_size, const LightmapScaleKey& scale_key)
+{
+    FileInfo source = file_info(obj_filename);
+
+    if (!source.valid)
+        return {false};
+
+    // Steps are at most 0, they are named by how many steps each axis is below the largest.
+    const signed char* steps = scale_key.steps;
+    bool unit_scale = steps[0] == 0 && steps[1] == 0 && steps[2] == 0;
+    char cache_filename[512];
+    int len = unit_scale
+        ? snprintf(cache_filename, sizeof(cache_filename), "%s.%u.cache", obj_filename, lightmap_size)
+        : snprintf(cache_filename, sizeof(cache_filename), "%s.%u.%d_%d_%d.cache", obj_filename, lightmap_size, -steps[0], -steps[1], -steps[2]);
+
+    if (len < 0 || (size_t)len >= sizeof(cache_filename))
+        return {false};
+
+    CachedMesh cm = mesh_cache_load(cache_filename, source, lightmap_size, scale_key);
+
+    if (cm.valid)
+        return cm;
+
+    // obj_load leaves its parse buffers in the allocator it is given, only the mesh that is returned goes in alloc.
+    Allocator ta = create_temp_allocator();
+    LoadedMesh lm = obj_load(&ta, obj_filename);
+
+    if (!lm.valid)
+        return {false};
+
+    // Keeps the uvs from the OBJ file if the charts don't fit.
+    mesh_generate_lightmap_uvs(&ta, &lm.mesh, lightmap_scale_from_key(scale_key), lightmap_size, LightmapChartPadding);
+    mesh_optimize(&ta, &lm.mesh);
+
+    if (mesh_cache_write(&ta, lm.mesh, source, lightmap_size, scale_key, cache_filename))
+    {
+        cm = mesh_cache_load(cache_filename, source, lightmap_size, scale_key);
+
+        if (cm.valid)
+            return cm;
+    }
+
+    cm.valid = true;
+    cm.parsed_mesh.vertices = lm.mesh.vertices.clone(alloc);
+    cm.parsed_mesh.indices = lm.mesh.indices.clone(alloc);
+    cm.vertices = cm.parsed_mesh.vertices.data;
+    cm.num_vertices = cm.parsed_mesh.vertices.num;
+    cm.indices = cm.parsed_mesh.indices.data;
+    cm.index_format = IndexFormat::UInt32;
+    cm.num_indices = cm.parsed_mesh.indices.num;
+    return cm;
+}
+
+Mesh mesh_cache_copy(Allocator* alloc, const CachedMesh& cm)
+{
+    Mesh m = mesh_create(alloc);
+    m.vertices.resize(cm.num_vertices);
+    memcpy(m.vertices.data, cm.vertices, cm.num_vertices * sizeof(Vertex));
+    m.indices.resize(cm.num_indices);
+
+    for (size_t i = 0; i < cm.num_indices; ++i)
+    {
+        m.indices[i] = cm.index_format == IndexFormat::UInt16
+            ? ((const unsigned short*)cm.indices)[i]
+            : ((const unsigned*)cm.indices)[i];
+    }
+
+    return m;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stddef.h>
+#include "file.h"
+#include "render_resource.h"
+#include "lightmap_uv.h"
+#include "mesh.h"
+
+struct Allocator;
+
+// Binary mesh files: a 64 byte header followed by the vertex array and the index array, both 64 byte aligned.
+// Loading maps the file, so vertices and indices point straight into the mapped file and are read-only.
+struct CachedMesh
+{
+    bool valid;
+    const Vertex* vertices;
+    size_t num_vertices;
+    const void* indices;
+    IndexFormat index_format;
+    size_t num_indices;
+    File mapped_file;
+
+    // Owns vertices and indices when they come from the parsed OBJ file instead of the mapped cache.
+    Mesh parsed_mesh;
+};
+
+// Indices are stored in 16 bits if the mesh has few enough vertices. source is the file the mesh was made from,
+// its size and modification time are stored so that stale caches are detected, as are the lightmap size and the
+// scale key the lightmap uvs were made for.
+bool mesh_cache_write(Allocator* alloc, const Mesh& m, const FileInfo& source, unsigned lightmap_size, const LightmapScaleKey& scale_key,
+    const char* filename);
+CachedMesh mesh_cache_load(const char* filename, const FileInfo& source, unsigned lightmap_size, const LightmapScaleKey& scale_key);
+void mesh_cache_unload(CachedMesh* cm);
+
+// Loads obj_filename through its cache file next to it, the cache is (re)written from the OBJ file if it is
+// missing or stale. Meshes get lightmap uvs for lightmap_size from mesh_generate_lightmap_uvs and are run through
+// mesh_optimize before they are cached. Each lightmap size has its own cache file, named
+// <obj_filename>.<lightmap_size>.cache. If the cache can't be written the parsed mesh, allocated with alloc, is
+// returned instead, mesh_cache_unload frees it.
+//
+// Instances scaled to a different shape need lightmap uvs of their own to get even texel density, scale_key is
+// the lightmap_scale_key of their scale. Each key has its own cache file, named
+// <obj_filename>.<lightmap_size>.<x>_<y>_<z>.cache after the number of steps each axis is below the largest.
+CachedMesh mesh_load_cached(Allocator* alloc, const char* obj_filename, unsigned lightmap_size = LightmapSize,
+    const LightmapScaleKey& scale_key = {});
+
+// Copies the cached mesh into a Mesh allocated with alloc, with 32 bit indices.
+Mesh mesh_cache_copy(Allocator* alloc, const CachedMesh& cm);
@@ -0,0 +1,103 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(_WIN32)
+    #include <direct.h>
+    #define make_directory(path) _mkdir(path)
+    #define remove_directory(path) _rmdir(path)
+#else
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define make_directory(path) mkdir(path, 0755)
+    #define remove_directory(path) rmdir(path)
+#endif
+#include "helpers.h"
+#include "memory.cpp"
+#include "math.cpp"
+#include "file.cpp"
+#include "mesh.cpp"
+#include "obj.cpp"
+#include "mesh_optimizer.cpp"
+#include "lightmap_uv.cpp"
+#include "mesh_cache.cpp"
+
+// A copy of box.wobj, so that the caches of the real one are left alone.
+static const char* ObjFilename = "mesh_cache_test.wobj";
+
+int main()
+{
+    const size_t temp_memory_size = 16 * 1024 * 1024;
+    void* temp_memory_block = malloc(temp_memory_size);
+    temp_memory_blob_init(temp_memory_block, temp_memory_size);
+
+    {
+        Allocator ta = create_temp_allocator();
+        LoadedFile box = file_load(&ta, "box.wobj");
+        assert(box.valid);
+        assert(file_write(box.file.data, box.file.size, ObjFilename));
+    }
+
+    char cache_filename[64];
+    snprintf(cache_filename, sizeof(cache_filename), "%s.%u.cache", ObjFilename, LightmapSize);
+    remove(cache_filename);
+
+    {
+        // The first load writes the cache and maps it, the second one only maps it.
+        Allocator ha = create_heap_allocator();
+
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            CachedMesh cm = mesh_load_cached(&ha, ObjFilename);
+            assert(cm.valid && cm.mapped_file.data != nullptr);
+            assert(cm.num_vertices > 0 && cm.num_indices > 0 && cm.index_format == IndexFormat::UInt16);
+            mesh_cache_unload(&cm);
+            assert(ha.num_allocations == 0);
+        }
+
+        heap_allocator_check_clean(&ha);
+    }
+
+    char scaled_cache_filename[64];
+    snprintf(scaled_cache_filename, sizeof(scaled_cache_filename), "%s.%u.1_9_0.cache", ObjFilename, LightmapSize);
+    remove(scaled_cache_filename);
+
+    {
+        // Each scale key gets a cache of its own, charts made for the floor's shape don't replace the unit ones.
+        Allocator ha = create_heap_allocator();
+        LightmapScaleKey floor = lightmap_scale_key({6, 0.3f, 8});
+        CachedMesh scaled = mesh_load_cached(&ha, ObjFilename, LightmapSize, floor);
+        assert(scaled.valid && scaled.mapped_file.data != nullptr);
+        CachedMesh unit = mesh_load_cached(&ha, ObjFilename);
+        assert(unit.valid && unit.mapped_file.data != nullptr);
+        assert(scaled.num_vertices == unit.num_vertices);
+        assert(memcmp(scaled.vertices, unit.vertices, unit.num_vertices * sizeof(Vertex)) != 0);
+        assert(!mesh_cache_load(scaled_cache_filename, file_info(ObjFilename), LightmapSize, {}).valid);
+        mesh_cache_unload(&unit);
+        mesh_cache_unload(&scaled);
+        heap_allocator_check_clean(&ha);
+    }
+
+    {
+        // A directory in the way of the cache file makes writing it fail, the parsed mesh is returned instead and
+        // has to be freed by mesh_cache_unload.
+        const unsigned lightmap_size = 32;
+        char blocked_filename[64];
+        snprintf(blocked_filename, sizeof(blocked_filename), "%s.%u.cache", ObjFilename, lightmap_size);
+        make_directory(blocked_filename);
+        Allocator ha = create_heap_allocator();
+        CachedMesh cm = mesh_load_cached(&ha, ObjFilename, lightmap_size);
+        assert(cm.valid && cm.mapped_file.data == nullptr);
+        assert(cm.num_vertices > 0 && cm.num_indices > 0 && cm.index_format == IndexFormat::UInt32);
+        assert(ha.num_allocations > 0);
+        mesh_cache_unload(&cm);
+        assert(!cm.valid && ha.num_allocations == 0);
+        heap_allocator_check_clean(&ha);
+        remove_directory(blocked_filename);
+    }
+
+    remove(scaled_cache_filename);
+    remove(cache_filename);
+    remove(ObjFilename);
+    free(temp_memory_block);
+    return 0;
+}
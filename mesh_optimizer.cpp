@@ -0,0 +1,255 @@
+#include "mesh_optimizer.h"
+#include "memory.h"
+#include "mesh.h"
+
+VertexCacheStats mesh_analyze_vertex_cache(Allocator* alloc, const unsigned* indices, size_t num_indices, size_t num_vertices, unsigned cache_size)
+{
+    VertexCacheStats stats = {};
+
+    if (num_indices < 3 || num_vertices == 0)
+        return stats;
+
+    size_t* cache_timestamps = (size_t*)alloc->alloc(num_vertices * sizeof(size_t));
+    memset(cache_timestamps, 0, num_vertices * sizeof(size_t));
+
+    // A vertex is in the FIFO if it was pushed less than cache_size misses ago. Timestamps start at cache_size + 1
+    // so that zeroed entries count as never pushed.
+    size_t timestamp = cache_size + 1;
+    size_t num_misses = 0;
+
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        unsigned v = indices[i];
+
+        if (timestamp - cache_timestamps[v] > cache_size)
+        {
+            cache_timestamps[v] = timestamp++;
+            ++num_misses;
+        }
+    }
+
+    stats.acmr = (float)num_misses / (float)(num_indices / 3);
+    stats.atvr = (float)num_misses / (float)num_vertices;
+    alloc->dealloc(cache_timestamps);
+    return stats;
+}
+
+static const unsigned InvalidTriangle = (unsigned)-1;
+static const unsigned OptimizerCacheSize = 32;
+static const float CacheDecayPower = 1.5f;
+static const float LastTriangleScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+static float vertex_score(int cache_position, unsigned num_remaining_triangles)
+{
+    if (num_remaining_triangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+
+    // The three vertices of the last triangle get a fixed score, otherwise it would be best to emit that same
+    // triangle again.
+    if (cache_position >= 0 && cache_position < 3)
+        score = LastTriangleScore;
+    else if (cache_position >= 3)
+        score = powf(1.0f - (float)(cache_position - 3) / (float)(OptimizerCacheSize - 3), CacheDecayPower);
+
+    // Vertices with few triangles left get a boost, so that they are finished off instead of being left behind.
+    score += ValenceBoostScale * powf((float)num_remaining_triangles, -ValenceBoostPower);
+    return score;
+}
+
+void mesh_optimize_vertex_cache(Allocator* alloc, unsigned* indices, size_t num_indices, size_t num_vertices)
+{
+    size_t num_triangles = num_indices / 3;
+
+    if (num_triangles == 0)
+        return;
+
+    // Triangles of each vertex. The list of a vertex is kept compact as triangles are emitted, its first
+    // num_remaining entries are the triangles that are left.
+    unsigned* num_remaining = (unsigned*)alloc->alloc(num_vertices * sizeof(unsigned));
+    unsigned* adjacency_offsets = (unsigned*)alloc->alloc((num_vertices + 1) * sizeof(unsigned));
+    unsigned* adjacency = (unsigned*)alloc->alloc(num_triangles * 3 * sizeof(unsigned));
+    int* cache_positions = (int*)alloc->alloc(num_vertices * sizeof(int));
+    float* vertex_scores = (float*)alloc->alloc(num_vertices * sizeof(float));
+    float* triangle_scores = (float*)alloc->alloc(num_triangles * sizeof(float));
+    bool* triangle_emitted = (bool*)alloc->alloc(num_triangles * sizeof(bool));
+    unsigned* output = (unsigned*)alloc->alloc(num_triangles * 3 * sizeof(unsigned));
+    memset(num_remaining, 0, num_vertices * sizeof(unsigned));
+    memset(triangle_emitted, 0, num_triangles * sizeof(bool));
+
+    for (size_t i = 0; i < num_triangles * 3; ++i)
+        ++num_remaining[indices[i]];
+
+    unsigned offset = 0;
+
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        adjacency_offsets[v] = offset;
+        offset += num_remaining[v];
+        num_remaining[v] = 0;
+    }
+
+    adjacency_offsets[num_vertices] = offset;
+
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            unsigned v = indices[t * 3 + c];
+            adjacency[adjacency_offsets[v] + num_remaining[v]++] = (unsigned)t;
+        }
+    }
+
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        cache_positions[v] = -1;
+        vertex_scores[v] = vertex_score(-1, num_remaining[v]);
+    }
+
+    unsigned best_triangle = InvalidTriangle;
+    float best_score = -1.0f;
+
+    for (size_t t = 0; t < num_triangles; ++t)
+    {
+        const unsigned* tri = indices + t * 3;
+        triangle_scores[t] = vertex_scores[tri[0]] + vertex_scores[tri[1]] + vertex_scores[tri[2]];
+
+        if (triangle_scores[t] > best_score)
+        {
+            best_score = triangle_scores[t];
+            best_triangle = (unsigned)t;
+        }
+    }
+
+    // Room for the cache plus the three vertices pushed by a triangle before the oldest ones fall off.
+    unsigned cache[OptimizerCacheSize + 3];
+    unsigned cache_num = 0;
+    size_t dead_end_cursor = 0;
+
+    for (size_t num_emitted = 0; num_emitted < num_triangles; ++num_emitted)
+    {
+        // When no triangle touches the cache, continue with the first triangle left in input order.
+        if (best_triangle == InvalidTriangle)
+        {
+            while (triangle_emitted[dead_end_cursor])
+                ++dead_end_cursor;
+
+            best_triangle = (unsigned)dead_end_cursor;
+        }
+
+        const unsigned* tri = indices + best_triangle * 3;
+        memcpy(output + num_emitted * 3, tri, 3 * sizeof(unsigned));
+        triangle_emitted[best_triangle] = true;
+
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            unsigned v = tri[c];
+            unsigned* triangles = adjacency + adjacency_offsets[v];
+
+            for (unsigned i = 0; i < num_remaining[v]; ++i)
+            {
+                if (triangles[i] == best_triangle)
+                {
+                    triangles[i] = triangles[num_remaining[v] - 1];
+                    --num_remaining[v];
+                    break;
+                }
+            }
+        }
+
+        unsigned new_cache[OptimizerCacheSize + 3];
+        unsigned new_cache_num = 0;
+
+        for (unsigned c = 0; c < 3; ++c)
+            new_cache[new_cache_num++] = tri[c];
+
+        for (unsigned i = 0; i < cache_num; ++i)
+        {
+            unsigned v = cache[i];
+
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                new_cache[new_cache_num++] = v;
+        }
+
+        // Vertices that fell off the cache also need new scores, so they are updated along with the rest.
+        for (unsigned i = 0; i < new_cache_num; ++i)
+        {
+            unsigned v = new_cache[i];
+            cache_positions[v] = i < OptimizerCacheSize ? (int)i : -1;
+            float new_score = vertex_score(cache_positions[v], num_remaining[v]);
+            float score_delta = new_score - vertex_scores[v];
+            vertex_scores[v] = new_score;
+            const unsigned* triangles = adjacency + adjacency_offsets[v];
+
+            for (unsigned j = 0; j < num_remaining[v]; ++j)
+                triangle_scores[triangles[j]] += score_delta;
+        }
+
+        best_triangle = InvalidTriangle;
+        best_score = -1.0f;
+
+        for (unsigned i = 0; i < new_cache_num; ++i)
+        {
+            unsigned v = new_cache[i];
+            const unsigned* triangles = adjacency + adjacency_offsets[v];
+
+            for (unsigned j = 0; j < num_remaining[v]; ++j)
+            {
+                if (triangle_scores[triangles[j]] > best_score)
+                {
+                    best_score = triangle_scores[triangles[j]];
+                    best_triangle = triangles[j];
+                }
+            }
+        }
+
+        cache_num = new_cache_num < OptimizerCacheSize ? new_cache_num : OptimizerCacheSize;
+        memcpy(cache, new_cache, cache_num * sizeof(unsigned));
+    }
+
+    memcpy(indices, output, num_triangles * 3 * sizeof(unsigned));
+    alloc->dealloc(output);
+    alloc->dealloc(triangle_emitted);
+    alloc->dealloc(triangle_scores);
+    alloc->dealloc(vertex_scores);
+    alloc->dealloc(cache_positions);
+    alloc->dealloc(adjacency);
+    alloc->dealloc(adjacency_offsets);
+    alloc->dealloc(num_remaining);
+}
+
+void mesh_optimize_vertex_fetch(Allocator* alloc, Mesh* m)
+{
+    const unsigned unused = (unsigned)-1;
+    unsigned* remap = (unsigned*)alloc->alloc(m->vertices.num * sizeof(unsigned));
+    memset(remap, 0xff, m->vertices.num * sizeof(unsigned));
+    Vertex* vertices = (Vertex*)alloc->alloc(m->vertices.num * sizeof(Vertex));
+    unsigned num_vertices = 0;
+
+    for (size_t i = 0; i < m->indices.num; ++i)
+    {
+        unsigned v = m->indices[i];
+
+        if (remap[v] == unused)
+        {
+            remap[v] = num_vertices;
+            vertices[num_vertices++] = m->vertices[v];
+        }
+
+        m->indices[i] = remap[v];
+    }
+
+    memcpy(m->vertices.data, vertices, num_vertices * sizeof(Vertex));
+    m->vertices.num = num_vertices;
+    alloc->dealloc(vertices);
+    alloc->dealloc(remap);
+}
+
+void mesh_optimize(Allocator* alloc, Mesh* m)
+{
+    mesh_optimize_vertex_cache(alloc, m->indices.data, m->indices.num, m->vertices.num);
+    mesh_optimize_vertex_fetch(alloc, m);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stddef.h>
+
+struct Allocator;
+struct Mesh;
+
+struct VertexCacheStats
+{
+    // Average cache miss ratio, vertex shader invocations per triangle. 0.5 is the best possible for a regular
+    // grid, 3 means no reuse at all.
+    float acmr;
+
+    // Average transform to vertex ratio, vertex shader invocations per vertex. 1 is optimal.
+    float atvr;
+};
+
+// Simulates a FIFO post-transform cache with cache_size entries.
+VertexCacheStats mesh_analyze_vertex_cache(Allocator* alloc, const unsigned* indices, size_t num_indices, size_t num_vertices, unsigned cache_size);
+
+// Reorders the triangles to reuse recently transformed vertices, using Tom Forsyth's linear-speed vertex cache
+// optimization. The vertices are left in place.
+void mesh_optimize_vertex_cache(Allocator* alloc, unsigned* indices, size_t num_indices, size_t num_vertices);
+
+// Reorders the vertices in the order they are first used by the indices, so that vertex fetches move linearly
+// through memory. Vertices that no index uses are removed.
+void mesh_optimize_vertex_fetch(Allocator* alloc, Mesh* m);
+
+// Both of the above, triangle order first since vertex order depends on it.
+void mesh_optimize(Allocator* alloc, Mesh* m);
@@ -0,0 +1,227 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "helpers.h"
+#include "memory.cpp"
+#include "math.cpp"
+#include "mesh.cpp"
+#include "mesh_optimizer.cpp"
+
+static const unsigned GridSize = 32;
+static const unsigned AnalyzeCacheSize = 16;
+
+static unsigned next_random(unsigned* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// A grid of GridSize by GridSize quads with its triangles in random order, so that the cache is of little use.
+static Mesh create_shuffled_grid(Allocator* alloc)
+{
+    Mesh m = mesh_create(alloc);
+
+    for (unsigned y = 0; y <= GridSize; ++y)
+    {
+        for (unsigned x = 0; x <= GridSize; ++x)
+        {
+            Vertex v = {};
+            v.position = {(float)x, 0, (float)y};
+            v.normal = {0, 1, 0};
+            m.vertices.add(v);
+        }
+    }
+
+    for (unsigned y = 0; y < GridSize; ++y)
+    {
+        for (unsigned x = 0; x < GridSize; ++x)
+        {
+            unsigned i = y * (GridSize + 1) + x;
+            unsigned quad[] = {i, i + GridSize + 1, i + 1, i + 1, i + GridSize + 1, i + GridSize + 2};
+
+            for (unsigned q = 0; q < 6; ++q)
+                m.indices.add(quad[q]);
+        }
+    }
+
+    unsigned rng = 1;
+
+    for (size_t t = m.indices.num / 3 - 1; t > 0; --t)
+    {
+        size_t other = next_random(&rng) % (t + 1);
+
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            unsigned tmp = m.indices[t * 3 + c];
+            m.indices[t * 3 + c] = m.indices[other * 3 + c];
+            m.indices[other * 3 + c] = tmp;
+        }
+    }
+
+    return m;
+}
+
+static Mesh mesh_copy(Allocator* alloc, const Mesh& source)
+{
+    Mesh m = mesh_create(alloc);
+
+    for (size_t i = 0; i < source.vertices.num; ++i)
+        m.vertices.add(source.vertices[i]);
+
+    for (size_t i = 0; i < source.indices.num; ++i)
+        m.indices.add(source.indices[i]);
+
+    return m;
+}
+
+struct Triangle
+{
+    Vector3 corners[3];
+};
+
+static bool position_less(const Vector3& a, const Vector3& b)
+{
+    if (a.x != b.x)
+        return a.x < b.x;
+
+    if (a.y != b.y)
+        return a.y < b.y;
+
+    return a.z < b.z;
+}
+
+// Triangles by the positions of their corners, rotated so that the smallest comes first. Rotating keeps the winding.
+static Triangle triangle_by_content(const Mesh& m, size_t first_index)
+{
+    unsigned start = 0;
+
+    for (unsigned c = 1; c < 3; ++c)
+    {
+        if (position_less(m.vertices[m.indices[first_index + c]].position, m.vertices[m.indices[first_index + start]].position))
+            start = c;
+    }
+
+    Triangle t;
+
+    for (unsigned c = 0; c < 3; ++c)
+        t.corners[c] = m.vertices[m.indices[first_index + (start + c) % 3]].position;
+
+    return t;
+}
+
+static int triangle_compare(const void* pa, const void* pb)
+{
+    const Triangle* a = (const Triangle*)pa;
+    const Triangle* b = (const Triangle*)pb;
+
+    for (unsigned c = 0; c < 3; ++c)
+    {
+        if (position_less(a->corners[c], b->corners[c]))
+            return -1;
+
+        if (position_less(b->corners[c], a->corners[c]))
+            return 1;
+    }
+
+    return 0;
+}
+
+static Triangle* sorted_triangles(Allocator* alloc, const Mesh& m)
+{
+    size_t num_triangles = m.indices.num / 3;
+    Triangle* triangles = (Triangle*)alloc->alloc(num_triangles * sizeof(Triangle));
+
+    for (size_t t = 0; t < num_triangles; ++t)
+        triangles[t] = triangle_by_content(m, t * 3);
+
+    qsort(triangles, num_triangles, sizeof(Triangle), triangle_compare);
+    return triangles;
+}
+
+static void check_same_triangles(Allocator* alloc, const Mesh& a, const Mesh& b)
+{
+    assert(a.indices.num == b.indices.num);
+    Triangle* ta = sorted_triangles(alloc, a);
+    Triangle* tb = sorted_triangles(alloc, b);
+    assert(memcmp(ta, tb, a.indices.num / 3 * sizeof(Triangle)) == 0);
+    alloc->dealloc(tb);
+    alloc->dealloc(ta);
+}
+
+int main()
+{
+    const size_t temp_memory_size = 4 * 1024 * 1024;
+    void* temp_memory_block = malloc(temp_memory_size);
+    temp_memory_blob_init(temp_memory_block, temp_memory_size);
+
+    {
+        // Triangle order: fewer cache misses, same triangles, vertices untouched.
+        Allocator ta = create_temp_allocator();
+        Mesh original = create_shuffled_grid(&ta);
+        Mesh m = mesh_copy(&ta, original);
+
+        VertexCacheStats before = mesh_analyze_vertex_cache(&ta, m.indices.data, m.indices.num, m.vertices.num, AnalyzeCacheSize);
+        mesh_optimize_vertex_cache(&ta, m.indices.data, m.indices.num, m.vertices.num);
+        VertexCacheStats after = mesh_analyze_vertex_cache(&ta, m.indices.data, m.indices.num, m.vertices.num, AnalyzeCacheSize);
+
+        assert(before.acmr > 1.5f);
+        assert(after.acmr < before.acmr * 0.5f);
+        assert(after.acmr < 0.8f);
+        assert(after.atvr < before.atvr);
+        assert(memcmp(m.vertices.data, original.vertices.data, m.vertices.num * sizeof(Vertex)) == 0);
+        check_same_triangles(&ta, original, m);
+
+        mesh_destroy(&m);
+        mesh_destroy(&original);
+    }
+
+    {
+        // Vertex order: first use order, unused vertices removed, indices pointing at the same vertices as before.
+        Allocator ta = create_temp_allocator();
+        Mesh original = create_shuffled_grid(&ta);
+        Vertex unused = {};
+        unused.position = {-1, -1, -1};
+        original.vertices.add(unused);
+
+        Mesh m = mesh_copy(&ta, original);
+        mesh_optimize_vertex_fetch(&ta, &m);
+
+        assert(m.vertices.num == original.vertices.num - 1);
+        assert(m.indices.num == original.indices.num);
+        unsigned next_new_vertex = 0;
+
+        for (size_t i = 0; i < m.indices.num; ++i)
+        {
+            unsigned v = m.indices[i];
+            assert(v < m.vertices.num);
+            assert(v <= next_new_vertex);
+
+            if (v == next_new_vertex)
+                ++next_new_vertex;
+
+            assert(memcmp(&m.vertices[v], &original.vertices[original.indices[i]], sizeof(Vertex)) == 0);
+        }
+
+        assert(next_new_vertex == m.vertices.num);
+        mesh_destroy(&m);
+        mesh_destroy(&original);
+    }
+
+    {
+        // Both together keep the triangles and the cache improvement.
+        Allocator ta = create_temp_allocator();
+        Mesh original = create_shuffled_grid(&ta);
+        Mesh m = mesh_copy(&ta, original);
+        mesh_optimize(&ta, &m);
+
+        VertexCacheStats before = mesh_analyze_vertex_cache(&ta, original.indices.data, original.indices.num, original.vertices.num, AnalyzeCacheSize);
+        VertexCacheStats after = mesh_analyze_vertex_cache(&ta, m.indices.data, m.indices.num, m.vertices.num, AnalyzeCacheSize);
+        assert(after.acmr < before.acmr * 0.5f);
+        check_same_triangles(&ta, original, m);
+
+        mesh_destroy(&m);
+        mesh_destroy(&original);
+    }
+
+    free(temp_memory_block);
+    return 0;
+}
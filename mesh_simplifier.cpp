@@ -0,0 +1,493 @@
+#include "mesh_simplifier.h"
+#include "memory.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+
+// Error of moving border vertices off the border is scaled up compared to moving vertices off the surface.
+static const double BorderWeight = 10.0;
+
+// Symmetric 4x4 matrix, the weighted sum of squared distances to a set of planes is v^T Q v for v = (x, y, z, 1).
+struct Quadric
+{
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+};
+
+static void quadric_add(Quadric* q, const Quadric& o)
+{
+    q->a2 += o.a2; q->ab += o.ab; q->ac += o.ac; q->ad += o.ad;
+    q->b2 += o.b2; q->bc += o.bc; q->bd += o.bd;
+    q->c2 += o.c2; q->cd += o.cd;
+    q->d2 += o.d2;
+}
+
+static Quadric quadric_from_plane(const Vector3& n, const Vector3& point_on_plane, double weight)
+{
+    double a = n.x, b = n.y, c = n.z, d = -vector3_dot(n, point_on_plane);
+    Quadric q;
+    q.a2 = a * a * weight; q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+    q.b2 = b * b * weight; q.bc = b * c * weight; q.bd = b * d * weight;
+    q.c2 = c * c * weight; q.cd = c * d * weight;
+    q.d2 = d * d * weight;
+    return q;
+}
+
+static double quadric_error(const Quadric& q, const Vector3& p)
+{
+    double x = p.x, y = p.y, z = p.z;
+    double e = q.a2 * x * x + 2 * q.ab * x * y + 2 * q.ac * x * z + 2 * q.ad * x
+        + q.b2 * y * y + 2 * q.bc * y * z + 2 * q.bd * y
+        + q.c2 * z * z + 2 * q.cd * z
+        + q.d2;
+
+    return e > 0 ? e : 0;
+}
+
+enum struct SimplifyVertexKind : unsigned char
+{
+    Interior, // Can collapse onto any neighbour.
+    Border, // On a straight part of a border, can only collapse onto its neighbours along the border.
+    Locked // Corners of borders, seams and non-manifold vertices.
+};
+
+static unsigned hash_u64(unsigned long long k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    return (unsigned)k;
+}
+
+static size_t hash_capacity(size_t num)
+{
+    size_t capacity = 16;
+
+    while (capacity < num * 2)
+        capacity *= 2;
+
+    return capacity;
+}
+
+static unsigned long long edge_key(unsigned from, unsigned to)
+{
+    return ((unsigned long long)from << 32) | to;
+}
+
+static bool border_turns(const Mesh& m, unsigned prev, unsigned v, unsigned next)
+{
+    Vector3 in = m.vertices[v].position - m.vertices[prev].position;
+    Vector3 out = m.vertices[next].position - m.vertices[v].position;
+    return vector3_dot(in, out) < 0.999f * vector3_length(in) * vector3_length(out);
+}
+
+struct Collapse
+{
+    unsigned from;
+    unsigned to;
+    double error;
+};
+
+static void sort_collapses(Collapse* c, size_t num, Collapse* scratch)
+{
+    // Merge sort, collapses with equal error keep their order so the result is deterministic.
+    for (size_t width = 1; width < num; width *= 2)
+    {
+        for (size_t start = 0; start < num; start += width * 2)
+        {
+            size_t mid = start + width < num ? start + width : num;
+            size_t end = start + width * 2 < num ? start + width * 2 : num;
+            size_t i = start, j = mid, k = start;
+
+            while (i < mid && j < end)
+                scratch[k++] = c[j].error < c[i].error ? c[j++] : c[i++];
+
+            while (i < mid)
+                scratch[k++] = c[i++];
+
+            while (j < end)
+                scratch[k++] = c[j++];
+        }
+
+        memcpy(c, scratch, num * sizeof(Collapse));
+    }
+}
+
+// Returns true if moving vertex from onto vertex to turns any of the triangles around from that survive the
+// collapse by more than about 75 degrees, which catches flips and triangles folding over their neighbours.
+static bool collapse_flips_triangle(const Mesh& m, const unsigned* indices, const unsigned* adjacency_offsets,
+    const unsigned* adjacency, unsigned from, unsigned to)
+{
+    for (unsigned i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; ++i)
+    {
+        const unsigned* tri = indices + adjacency[i] * 3;
+
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+
+        Vector3 p[3] = {m.vertices[tri[0]].position, m.vertices[tri[1]].position, m.vertices[tri[2]].position};
+        Vector3 old_normal = vector3_cross(p[1] - p[0], p[2] - p[0]);
+        p[tri[0] == from ? 0 : (tri[1] == from ? 1 : 2)] = m.vertices[to].position;
+        Vector3 new_normal = vector3_cross(p[1] - p[0], p[2] - p[0]);
+
+        if (vector3_dot(old_normal, new_normal) <= 0.25f * vector3_length(old_normal) * vector3_length(new_normal))
+            return true;
+    }
+
+    return false;
+}
+
+static bool triangle_has(const unsigned* tri, unsigned v)
+{
+    return tri[0] == v || tri[1] == v || tri[2] == v;
+}
+
+// Returns true if moving vertex from onto vertex to would change the topology of the mesh. The vertices next to
+// both of them have to be exactly the ones across the triangles on the edge, otherwise the collapse pinches the
+// surface into edges with more than two triangles. A triangle around from that ends up with the same corners as
+// one around to would fold the surface onto itself, which is how a closed mesh would collapse into a flat sheet.
+// marks has an entry per vertex, mark and mark + 1 must not be in it yet.
+static bool collapse_changes_topology(const unsigned* indices, const unsigned* adjacency_offsets, const unsigned* adjacency,
+    unsigned from, unsigned to, unsigned* marks, unsigned mark)
+{
+    for (unsigned i = adjacency_offsets[to]; i < adjacency_offsets[to + 1]; ++i)
+    {
+        const unsigned* tri = indices + adjacency[i] * 3;
+
+        for (unsigned c = 0; c < 3; ++c)
+            marks[tri[c]] = mark;
+    }
+
+    unsigned num_shared_triangles = 0;
+    unsigned num_shared_neighbours = 0;
+
+    for (unsigned i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; ++i)
+    {
+        const unsigned* tri = indices + adjacency[i] * 3;
+
+        if (triangle_has(tri, to))
+            ++num_shared_triangles;
+
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            unsigned v = tri[c];
+
+            if (v != from && v != to && marks[v] == mark)
+            {
+                marks[v] = mark + 1;
+                ++num_shared_neighbours;
+            }
+        }
+    }
+
+    if (num_shared_neighbours != num_shared_triangles)
+        return true;
+
+    for (unsigned i = adjacency_offsets[from]; i < adjacency_offsets[from + 1]; ++i)
+    {
+        const unsigned* tri = indices + adjacency[i] * 3;
+
+        if (triangle_has(tri, to))
+            continue;
+
+        unsigned c = tri[0] == from ? 0 : (tri[1] == from ? 1 : 2);
+        unsigned x = tri[(c + 1) % 3];
+        unsigned y = tri[(c + 2) % 3];
+
+        if (marks[x] != mark + 1 || marks[y] != mark + 1)
+            continue;
+
+        for (unsigned j = adjacency_offsets[to]; j < adjacency_offsets[to + 1]; ++j)
+        {
+            const unsigned* other = indices + adjacency[j] * 3;
+
+            if (triangle_has(other, x) && triangle_has(other, y))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+Mesh mesh_simplify(Allocator* alloc, const Mesh& m, size_t target_num_indices)
+{
+    Allocator ta = create_temp_allocator();
+    size_t num_vertices = m.vertices.num;
+    size_t num_indices = m.indices.num;
+    unsigned* indices = (unsigned*)ta.alloc(num_indices * sizeof(unsigned));
+    memcpy(indices, m.indices.data, num_indices * sizeof(unsigned));
+
+    // An edge is on a border if no triangle uses it in the opposite direction.
+    size_t edges_capacity = hash_capacity(num_indices);
+    unsigned long long* edges = (unsigned long long*)ta.alloc(edges_capacity * sizeof(unsigned long long));
+    memset(edges, 0xff, edges_capacity * sizeof(unsigned long long));
+    const unsigned long long EmptyEdge = 0xffffffffffffffffull;
+
+    for (size_t i = 0; i < num_indices; ++i)
+    {
+        unsigned long long key = edge_key(indices[i], indices[i - i % 3 + (i + 1) % 3]);
+        size_t slot = hash_u64(key) & (edges_capacity - 1);
+
+        while (edges[slot] != EmptyEdge && edges[slot] != key)
+            slot = (slot + 1) & (edges_capacity - 1);
+
+        edges[slot] = key;
+    }
+
+    Quadric* quadrics = (Quadric*)ta.alloc(num_vertices * sizeof(Quadric));
+    memset(quadrics, 0, num_vertices * sizeof(Quadric));
+    unsigned* border_next = (unsigned*)ta.alloc(num_vertices * sizeof(unsigned));
+    unsigned* border_prev = (unsigned*)ta.alloc(num_vertices * sizeof(unsigned));
+    unsigned char* num_border_out = (unsigned char*)ta.alloc(num_vertices);
+    unsigned char* num_border_in = (unsigned char*)ta.alloc(num_vertices);
+    memset(num_border_out, 0, num_vertices);
+    memset(num_border_in, 0, num_vertices);
+
+    for (size_t t = 0; t < num_indices / 3; ++t)
+    {
+        const unsigned* tri = indices + t * 3;
+        const Vector3& p0 = m.vertices[tri[0]].position;
+        Vector3 n = vector3_cross(m.vertices[tri[1]].position - p0, m.vertices[tri[2]].position - p0);
+        float double_area = vector3_length(n);
+
+        if (double_area == 0.0f)
+            continue;
+
+        n = n * (1.0f / double_area);
+
+        // Weighting by area keeps many small triangles from outweighing a large one.
+        Quadric q = quadric_from_plane(n, p0, double_area * 0.5);
+
+        for (unsigned c = 0; c < 3; ++c)
+            quadric_add(quadrics + tri[c], q);
+
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            unsigned a = tri[c];
+            unsigned b = tri[(c + 1) % 3];
+            unsigned long long twin = edge_key(b, a);
+            size_t slot = hash_u64(twin) & (edges_capacity - 1);
+
+            while (edges[slot] != EmptyEdge && edges[slot] != twin)
+                slot = (slot + 1) & (edges_capacity - 1);
+
+            if (edges[slot] == twin)
+                continue;
+
+            border_next[a] = b;
+            border_prev[b] = a;
+            num_border_out[a] = (unsigned char)(num_border_out[a] < 255 ? num_border_out[a] + 1 : 255);
+            num_border_in[b] = (unsigned char)(num_border_in[b] < 255 ? num_border_in[b] + 1 : 255);
+
+            // Plane through the border edge, perpendicular to the triangle, keeps the outline in place.
+            Vector3 edge = m.vertices[b].position - m.vertices[a].position;
+            float edge_length = vector3_length(edge);
+
+            if (edge_length == 0.0f)
+                continue;
+
+            Quadric bq = quadric_from_plane(vector3_cross(edge * (1.0f / edge_length), n), m.vertices[a].position,
+                edge_length * edge_length * BorderWeight);
+
+            quadric_add(quadrics + a, bq);
+            quadric_add(quadrics + b, bq);
+        }
+    }
+
+    // Vertices on seams share their position with another vertex, moving one of them would open a crack.
+    size_t positions_capacity = hash_capacity(num_vertices);
+    unsigned* positions = (unsigned*)ta.alloc(positions_capacity * sizeof(unsigned));
+    memset(positions, 0, positions_capacity * sizeof(unsigned));
+    bool* on_seam = (bool*)ta.alloc(num_vertices * sizeof(bool));
+    memset(on_seam, 0, num_vertices * sizeof(bool));
+
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        const Vector3& p = m.vertices[v].position;
+        unsigned bits[3];
+        memcpy(bits, &p, sizeof(bits));
+        size_t slot = hash_u64(edge_key(bits[0] ^ hash_u64(bits[2]), bits[1])) & (positions_capacity - 1);
+
+        for (; positions[slot] != 0; slot = (slot + 1) & (positions_capacity - 1))
+        {
+            const Vector3& other = m.vertices[positions[slot] - 1].position;
+
+            if (other.x == p.x && other.y == p.y && other.z == p.z)
+            {
+                on_seam[v] = true;
+                on_seam[positions[slot] - 1] = true;
+                break;
+            }
+        }
+
+        if (positions[slot] == 0)
+            positions[slot] = (unsigned)v + 1;
+    }
+
+    SimplifyVertexKind* kinds = (SimplifyVertexKind*)ta.alloc(num_vertices * sizeof(SimplifyVertexKind));
+
+    for (size_t v = 0; v < num_vertices; ++v)
+    {
+        if (num_border_out[v] == 0 && num_border_in[v] == 0)
+            kinds[v] = SimplifyVertexKind::Interior;
+        else if (num_border_out[v] == 1 && num_border_in[v] == 1 && !on_seam[v] && !border_turns(m, border_prev[v], (unsigned)v, border_next[v]))
+            kinds[v] = SimplifyVertexKind::Border;
+        else
+            kinds[v] = SimplifyVertexKind::Locked;
+    }
+
+    unsigned* adjacency_offsets = (unsigned*)ta.alloc((num_vertices + 1) * sizeof(unsigned));
+    unsigned* adjacency = (unsigned*)ta.alloc(num_indices * sizeof(unsigned));
+    unsigned* remap = (unsigned*)ta.alloc(num_vertices * sizeof(unsigned));
+    bool* touched = (bool*)ta.alloc(num_vertices * sizeof(bool));
+    unsigned* marks = (unsigned*)ta.alloc(num_vertices * sizeof(unsigned));
+    memset(marks, 0, num_vertices * sizeof(unsigned));
+    unsigned next_mark = 1;
+    Collapse* collapses = (Collapse*)ta.alloc(num_indices * sizeof(Collapse));
+    Collapse* collapses_scratch = (Collapse*)ta.alloc(num_indices * sizeof(Collapse));
+
+    // Each pass collapses the cheapest edges first. A vertex takes part in at most one collapse per pass, so the
+    // adjacency and errors the pass was planned with stay valid while it runs.
+    while (num_indices > target_num_indices)
+    {
+        memset(adjacency_offsets, 0, (num_vertices + 1) * sizeof(unsigned));
+
+        for (size_t i = 0; i < num_indices; ++i)
+            ++adjacency_offsets[indices[i] + 1];
+
+        for (size_t v = 0; v < num_vertices; ++v)
+            adjacency_offsets[v + 1] += adjacency_offsets[v];
+
+        for (size_t i = 0; i < num_indices; ++i)
+            adjacency[adjacency_offsets[indices[i]]++] = (unsigned)(i / 3);
+
+        for (size_t v = num_vertices; v > 0; --v)
+            adjacency_offsets[v] = adjacency_offsets[v - 1];
+
+        adjacency_offsets[0] = 0;
+        size_t num_collapses = 0;
+
+        for (size_t i = 0; i < num_indices; ++i)
+        {
+            unsigned a = indices[i];
+            unsigned b = indices[i - i % 3 + (i + 1) % 3];
+            bool is_border_edge = kinds[a] != SimplifyVertexKind::Interior && kinds[b] != SimplifyVertexKind::Interior
+                && num_border_out[a] != 0 && border_next[a] == b;
+
+            // Interior edges are seen once from each of their triangles.
+            if (a > b && !is_border_edge)
+                continue;
+
+            bool can_move_a = kinds[a] == SimplifyVertexKind::Interior
+                || (kinds[a] == SimplifyVertexKind::Border && is_border_edge);
+
+            bool can_move_b = kinds[b] == SimplifyVertexKind::Interior
+                || (kinds[b] == SimplifyVertexKind::Border && is_border_edge);
+
+            if (!can_move_a && !can_move_b)
+                continue;
+
+            Quadric q = quadrics[a];
+            quadric_add(&q, quadrics[b]);
+            double a_to_b = can_move_a ? quadric_error(q, m.vertices[b].position) : 0;
+            double b_to_a = can_move_b ? quadric_error(q, m.vertices[a].position) : 0;
+            bool use_a_to_b = can_move_a && (!can_move_b || a_to_b <= b_to_a);
+
+            Collapse& c = collapses[num_collapses++];
+            c.from = use_a_to_b ? a : b;
+            c.to = use_a_to_b ? b : a;
+            c.error = use_a_to_b ? a_to_b : b_to_a;
+        }
+
+        if (num_collapses == 0)
+            break;
+
+        sort_collapses(collapses, num_collapses, collapses_scratch);
+
+        for (size_t v = 0; v < num_vertices; ++v)
+            remap[v] = (unsigned)v;
+
+        memset(touched, 0, num_vertices * sizeof(bool));
+        size_t indices_to_remove = num_indices - target_num_indices;
+        size_t num_removed = 0;
+
+        for (size_t i = 0; i < num_collapses && num_removed < indices_to_remove; ++i)
+        {
+            const Collapse& c = collapses[i];
+
+            if (touched[c.from] || touched[c.to])
+                continue;
+
+            if (collapse_flips_triangle(m, indices, adjacency_offsets, adjacency, c.from, c.to))
+                continue;
+
+            bool changes_topology = collapse_changes_topology(indices, adjacency_offsets, adjacency, c.from, c.to, marks, next_mark);
+            next_mark += 2;
+
+            if (changes_topology)
+                continue;
+
+            remap[c.from] = c.to;
+            quadric_add(quadrics + c.to, quadrics[c.from]);
+
+            if (kinds[c.from] == SimplifyVertexKind::Border)
+            {
+                if (border_next[c.from] == c.to)
+                {
+                    border_next[border_prev[c.from]] = c.to;
+                    border_prev[c.to] = border_prev[c.from];
+                }
+                else
+                {
+                    border_prev[border_next[c.from]] = c.to;
+                    border_next[c.to] = border_next[c.from];
+                }
+
+                // Removes the triangle on the border edge.
+                num_removed += 3;
+            }
+            else
+            {
+                // Removes the two triangles on either side of the edge.
+                num_removed += 6;
+            }
+
+            // The triangles around from change, so their vertices sit out the rest of the pass.
+            for (unsigned j = adjacency_offsets[c.from]; j < adjacency_offsets[c.from + 1]; ++j)
+            {
+                const unsigned* tri = indices + adjacency[j] * 3;
+                touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+            }
+        }
+
+        size_t num_kept = 0;
+
+        for (size_t t = 0; t < num_indices / 3; ++t)
+        {
+            unsigned v0 = remap[indices[t * 3]];
+            unsigned v1 = remap[indices[t * 3 + 1]];
+            unsigned v2 = remap[indices[t * 3 + 2]];
+
+            if (v0 == v1 || v1 == v2 || v0 == v2)
+                continue;
+
+            indices[num_kept++] = v0;
+            indices[num_kept++] = v1;
+            indices[num_kept++] = v2;
+        }
+
+        if (num_kept == num_indices)
+            break;
+
+        num_indices = num_kept;
+    }
+
+    Mesh result = mesh_create(alloc);
+    result.vertices.resize(num_vertices);
+    memcpy(result.vertices.data, m.vertices.data, num_vertices * sizeof(Vertex));
+    result.indices.resize(num_indices);
+    memcpy(result.indices.data, indices, num_indices * sizeof(unsigned));
+    mesh_optimize_vertex_fetch(alloc, &result);
+    return result;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <stddef.h>
+
+struct Allocator;
+struct Mesh;
+
+// Simplifies the mesh by collapsing edges in order of quadric error until it has at most target_num_indices
+// indices, or until no more edges can be collapsed. Collapses only move vertices onto existing vertices, so every
+// remaining vertex keeps its attributes. Border vertices only slide along the border and vertices on uv or normal
+// seams are never moved, so the outline of the mesh stays intact and no cracks open along seams. Collapses that
+// would change the topology are skipped, a closed mesh stays closed and ends at a tetrahedron at the least.
+// The result is allocated with alloc and only contains the vertices that are still used.
+Mesh mesh_simplify(Allocator* alloc, const Mesh& m, size_t target_num_indices);
@@ -0,0 +1,228 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "helpers.h"
+#include "memory.cpp"
+#include "math.cpp"
+#include "mesh.cpp"
+#include "mesh_optimizer.cpp"
+#include "mesh_simplifier.cpp"
+
+static const unsigned GridSize = 32;
+
+// A flat grid of quads in the xz plane from x_begin to x_end and 0 to GridSize in z, facing up. uv.x is u_offset
+// plus x, so two grids next to each other with different offsets meet at a uv seam.
+static void add_grid(Mesh* m, unsigned x_begin, unsigned x_end, float u_offset)
+{
+    unsigned first_vertex = (unsigned)m->vertices.num;
+    unsigned width = x_end - x_begin;
+
+    for (unsigned z = 0; z <= GridSize; ++z)
+    {
+        for (unsigned x = x_begin; x <= x_end; ++x)
+        {
+            Vertex v = {};
+            v.position = {(float)x, 0, (float)z};
+            v.normal = {0, 1, 0};
+            v.uv = {u_offset + (float)x, (float)z};
+            m->vertices.add(v);
+        }
+    }
+
+    for (unsigned z = 0; z < GridSize; ++z)
+    {
+        for (unsigned x = 0; x < width; ++x)
+        {
+            unsigned i = first_vertex + z * (width + 1) + x;
+            unsigned quad[] = {i, i + width + 1, i + 1, i + 1, i + width + 1, i + width + 2};
+
+            for (unsigned q = 0; q < 6; ++q)
+                m->indices.add(quad[q]);
+        }
+    }
+}
+
+// A unit sphere with rings rings from pole to pole and twice as many segments around, sharing the vertices on its
+// rings so that it is closed and has no seams.
+static Mesh create_sphere(Allocator* alloc, unsigned rings)
+{
+    const float pi = 3.1415926535897932f;
+    unsigned segments = rings * 2;
+    Mesh m = mesh_create(alloc);
+
+    for (unsigned r = 0; r <= rings; ++r)
+    {
+        float theta = pi * (float)r / (float)rings;
+        unsigned num_around = r == 0 || r == rings ? 1 : segments;
+
+        for (unsigned s = 0; s < num_around; ++s)
+        {
+            float phi = 2 * pi * (float)s / (float)segments;
+            Vertex v = {};
+            v.position = {sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)};
+            v.normal = v.position;
+            m.vertices.add(v);
+        }
+    }
+
+    unsigned bottom = (unsigned)m.vertices.num - 1;
+    unsigned last_ring = 1 + (rings - 2) * segments;
+
+    for (unsigned s = 0; s < segments; ++s)
+    {
+        unsigned next = (s + 1) % segments;
+        unsigned caps[] = {0, 1 + next, 1 + s, bottom, last_ring + s, last_ring + next};
+
+        for (unsigned c = 0; c < 6; ++c)
+            m.indices.add(caps[c]);
+
+        for (unsigned r = 1; r + 1 < rings; ++r)
+        {
+            unsigned upper = 1 + (r - 1) * segments;
+            unsigned lower = upper + segments;
+            unsigned quad[] = {upper + s, upper + next, lower + next, upper + s, lower + next, lower + s};
+
+            for (unsigned c = 0; c < 6; ++c)
+                m.indices.add(quad[c]);
+        }
+    }
+
+    return m;
+}
+
+// Every edge has exactly one triangle on each side, going the other way around it.
+static void check_closed(const Mesh& m)
+{
+    for (size_t i = 0; i < m.indices.num; ++i)
+    {
+        unsigned a = m.indices[i];
+        unsigned b = m.indices[i - i % 3 + (i + 1) % 3];
+        unsigned num_twins = 0;
+        unsigned num_same = 0;
+
+        for (size_t j = 0; j < m.indices.num; ++j)
+        {
+            unsigned c = m.indices[j];
+            unsigned d = m.indices[j - j % 3 + (j + 1) % 3];
+            if (c == b && d == a)
+                ++num_twins;
+
+            if (c == a && d == b)
+                ++num_same;
+        }
+
+        assert(num_twins == 1 && num_same == 1);
+    }
+}
+
+static Vector3 triangle_normal(const Mesh& m, size_t first_index)
+{
+    const Vector3& p0 = m.vertices[m.indices[first_index]].position;
+    const Vector3& p1 = m.vertices[m.indices[first_index + 1]].position;
+    const Vector3& p2 = m.vertices[m.indices[first_index + 2]].position;
+    return vector3_cross(p1 - p0, p2 - p0);
+}
+
+// The grid stays flat and facing up, so it still covers its whole outline exactly once if no triangle is flipped
+// and the areas add up.
+static void check_covers_grid(const Mesh& m, float width)
+{
+    float area = 0;
+
+    for (size_t i = 0; i < m.indices.num; i += 3)
+    {
+        Vector3 n = triangle_normal(m, i);
+        assert(n.y > 0);
+        area += n.y / 2;
+    }
+
+    assert(fabsf(area - width * (float)GridSize) < 1e-3f);
+    Aabb bounds = vertices_bounds(m.vertices.data, m.vertices.num);
+    assert(bounds.min.x == 0 && bounds.min.y == 0 && bounds.min.z == 0);
+    assert(bounds.max.x == width && bounds.max.y == 0 && bounds.max.z == (float)GridSize);
+
+    for (size_t i = 0; i < m.indices.num; ++i)
+        assert(m.indices[i] < m.vertices.num);
+}
+
+int main()
+{
+    const size_t temp_memory_size = 4 * 1024 * 1024;
+    void* temp_memory_block = malloc(temp_memory_size);
+    temp_memory_blob_init(temp_memory_block, temp_memory_size);
+
+    {
+        // A flat grid collapses to the target without moving its outline.
+        Allocator ta = create_temp_allocator();
+        Mesh m = mesh_create(&ta);
+        add_grid(&m, 0, GridSize, 0);
+        size_t target = m.indices.num / 20;
+        Mesh s = mesh_simplify(&ta, m, target);
+        assert(s.indices.num > 0 && s.indices.num <= target);
+        assert(s.vertices.num < m.vertices.num / 10);
+        check_covers_grid(s, (float)GridSize);
+        mesh_destroy(&s);
+        mesh_destroy(&m);
+    }
+
+    {
+        // A target above the size of the mesh keeps all of it.
+        Allocator ta = create_temp_allocator();
+        Mesh m = mesh_create(&ta);
+        add_grid(&m, 0, 4, 0);
+        Mesh s = mesh_simplify(&ta, m, m.indices.num);
+        assert(s.indices.num == m.indices.num && s.vertices.num == m.vertices.num);
+        mesh_destroy(&s);
+        mesh_destroy(&m);
+    }
+
+    {
+        // Two halves with different uvs meet at x = GridSize / 2. Every vertex on the seam stays on both sides of
+        // it, so no crack opens there.
+        Allocator ta = create_temp_allocator();
+        Mesh m = mesh_create(&ta);
+        const unsigned half = GridSize / 2;
+        add_grid(&m, 0, half, 0);
+        add_grid(&m, half, GridSize, 100);
+        Mesh s = mesh_simplify(&ta, m, m.indices.num / 10);
+        assert(s.indices.num < m.indices.num / 4);
+        check_covers_grid(s, (float)GridSize);
+        unsigned num_left_seam_vertices = 0;
+        unsigned num_right_seam_vertices = 0;
+
+        for (size_t i = 0; i < s.vertices.num; ++i)
+        {
+            const Vertex& v = s.vertices[i];
+
+            if (v.position.x != (float)half)
+                continue;
+
+            if (v.uv.x == (float)half)
+                ++num_left_seam_vertices;
+            else
+                ++num_right_seam_vertices;
+        }
+
+        assert(num_left_seam_vertices == GridSize + 1 && num_right_seam_vertices == GridSize + 1);
+        mesh_destroy(&s);
+        mesh_destroy(&m);
+    }
+
+    {
+        // A closed mesh stays closed, down to the tetrahedron it ends at if the target is too small to reach.
+        Allocator ta = create_temp_allocator();
+        Mesh m = create_sphere(&ta, 16);
+        check_closed(m);
+        Mesh s = mesh_simplify(&ta, m, m.indices.num / 16);
+        assert(s.indices.num > 0 && s.indices.num <= m.indices.num / 16);
+        check_closed(s);
+        Mesh tetrahedron = mesh_simplify(&ta, m, 0);
+        assert(tetrahedron.indices.num == 12 && tetrahedron.vertices.num == 4);
+        check_closed(tetrahedron);
+        mesh_destroy(&tetrahedron);
+        mesh_destroy(&s);
+        mesh_destroy(&m);
+    }
+
+    free(temp_memory_block);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "helpers.h"
+#include "memory.cpp"
+#include "math.cpp"
+#include "mesh.cpp"
+
+static float random_float(unsigned* state, float min_value, float max_value)
+{
+    *state = *state * 1664525u + 1013904223u;
+    float t = (float)(*state >> 8) / (float)(1 << 24);
+    return min_value + t * (max_value - min_value);
+}
+
+static Vertex random_vertex(unsigned* rng)
+{
+    Vertex v = {};
+    v.position = {random_float(rng, -3, 5), random_float(rng, -0.1f, 0.1f), random_float(rng, 10, 200)};
+    v.normal = vector3_normalize({random_float(rng, -1, 1), random_float(rng, -1, 1), random_float(rng, -1, 1)});
+    v.uv = {random_float(rng, -1, 2), random_float(rng, 0, 1)};
+    v.color = {random_float(rng, 0, 1), random_float(rng, 0, 1), random_float(rng, 0, 1), random_float(rng, 0, 1)};
+    return v;
+}
+
+// Half floats keep 11 significant bits and round to nearest.
+static bool uv_close(float a, float b)
+{
+    float magnitude = fabsf(b) > 1.0f / 16384 ? fabsf(b) : 1.0f / 16384;
+    return fabsf(a - b) <= magnitude / 2048;
+}
+
+int main()
+{
+    const size_t temp_memory_size = 4 * 1024 * 1024;
+    void* temp_memory_block = malloc(temp_memory_size);
+    temp_memory_blob_init(temp_memory_block, temp_memory_size);
+
+    {
+        Allocator ta = create_temp_allocator();
+        Mesh m = mesh_create(&ta);
+        unsigned rng = 1;
+
+        for (unsigned i = 0; i < 4096; ++i)
+            m.vertices.add(random_vertex(&rng));
+
+        for (unsigned i = 0; i < 3 * 4096; ++i)
+            m.indices.add((i * 7u) % 4096u);
+
+        // The axis aligned normals are the corners and edges of the octahedron.
+        Vector3 axes[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+
+        for (unsigned i = 0; i < 6; ++i)
+            m.vertices[i].normal = axes[i];
+
+        PackedMesh pm = mesh_pack(&ta, m);
+        assert(pm.vertices.num == m.vertices.num && pm.indices.num == m.indices.num);
+        Aabb bounds = vertices_bounds(m.vertices.data, m.vertices.num);
+        assert(vector3_length(pm.position_offset - bounds.min) == 0);
+
+        Mesh u = mesh_unpack(&ta, pm);
+        assert(u.vertices.num == m.vertices.num && u.indices.num == m.indices.num);
+        assert(memcmp(u.indices.data, m.indices.data, m.indices.num * sizeof(unsigned)) == 0);
+
+        for (size_t i = 0; i < m.vertices.num; ++i)
+        {
+            const Vertex& a = m.vertices[i];
+            const Vertex& b = u.vertices[i];
+
+            // Rounding is half a unorm16 step of the bounds, the rest is room for float rounding.
+            assert(fabsf(a.position.x - b.position.x) <= pm.position_scale.x / 65535);
+            assert(fabsf(a.position.y - b.position.y) <= pm.position_scale.y / 65535);
+            assert(fabsf(a.position.z - b.position.z) <= pm.position_scale.z / 65535);
+
+            assert(vector3_length(a.normal - b.normal) <= 2e-4f);
+            assert(fabsf(vector3_length(b.normal) - 1) <= 1e-5f);
+
+            assert(uv_close(b.uv.x, a.uv.x) && uv_close(b.uv.y, a.uv.y));
+
+            assert(fabsf(a.color.r - b.color.r) <= 0.5f / 255 + 1e-6f);
+            assert(fabsf(a.color.g - b.color.g) <= 0.5f / 255 + 1e-6f);
+            assert(fabsf(a.color.b - b.color.b) <= 0.5f / 255 + 1e-6f);
+            assert(fabsf(a.color.a - b.color.a) <= 0.5f / 255 + 1e-6f);
+        }
+
+        for (unsigned i = 0; i < 6; ++i)
+            assert(vector3_length(u.vertices[i].normal - axes[i]) <= 1e-5f);
+
+        mesh_destroy(&u);
+        packed_mesh_destroy(&pm);
+        mesh_destroy(&m);
+    }
+
+    {
+        // A flat mesh keeps its flat coordinate, zero normals unpack as +z.
+        Allocator ta = create_temp_allocator();
+        Mesh m = mesh_create(&ta);
+        Vertex v = {};
+        v.position = {0, 2, 0};
+        m.vertices.add(v);
+        v.position = {1, 2, 1};
+        m.vertices.add(v);
+
+        PackedMesh pm = mesh_pack(&ta, m);
+        Mesh u = mesh_unpack(&ta, pm);
+        assert(u.vertices[0].position.y == 2 && u.vertices[1].position.y == 2);
+        assert(u.vertices[1].position.x == 1 && u.vertices[1].position.z == 1);
+        assert(u.vertices[0].normal.x == 0 && u.vertices[0].normal.y == 0 && u.vertices[0].normal.z == 1);
+
+        mesh_destroy(&u);
+        packed_mesh_destroy(&pm);
+        mesh_destroy(&m);
+    }
+
+    free(temp_memory_block);
+    return 0;
+}
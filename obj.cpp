@@ -1,8 +1,19 @@
 #include "obj.h"
 #include <stdlib.h>
+#include <stdio.h>
+#include <thread>
+#if defined(_M_X64) || defined(__SSE2__)
+    #include <emmintrin.h>
+    #define OBJ_USE_SSE2
+#endif
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
 #include "mesh.h"
 #include "memory.h"
 #include "file.h"
+#include "small_array.h"
+#include "trace.h"
 
 struct ParserState
 {
@@ -11,17 +22,18 @@ struct ParserState
     unsigned char* end;
 };
 
+static const unsigned MissingIndex = (unsigned)-1;
+
+struct ParsedFaceCorner
+{
+    unsigned v;
+    unsigned u;
+    unsigned n;
+};
+
 struct ParsedFace
 {
-    unsigned v1;
-    unsigned v2;
-    unsigned v3;
-    unsigned n1;
-    unsigned n2;
-    unsigned n3;
-    unsigned u1;
-    unsigned u2;
-    unsigned u3;
+    ParsedFaceCorner corners[3];
 };
 
 struct ParsedData
@@ -32,90 +44,325 @@ struct ParsedData
     DynamicArray<ParsedFace> faces;
 };
 
+static unsigned bit_scan_forward(unsigned v)
+{
+    #if defined(_MSC_VER)
+        unsigned long i;
+        _BitScanForward(&i, v);
+        return i;
+    #else
+        return __builtin_ctz(v);
+    #endif
+}
+
+static bool is_digit(unsigned char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+static bool is_numeric_start(unsigned char c)
+{
+    return is_digit(c) || c == '-' || c == '+' || c == '.';
+}
+
+// Returns the first occurrence of b in [p, end), or end.
+static unsigned char* find_byte(unsigned char* p, unsigned char* end, unsigned char b)
+{
+    #if defined(OBJ_USE_SSE2)
+        const __m128i bv = _mm_set1_epi8((char)b);
+
+        while (end - p >= 16)
+        {
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), bv));
+
+            if (mask != 0)
+                return p + bit_scan_forward((unsigned)mask);
+
+            p += 16;
+        }
+    #endif
+
+    while (p < end && *p != b)
+        ++p;
+
+    return p;
+}
+
 static void skip_to_numeric(ParserState* ps)
 {
-    while (ps->head < ps->end && (*ps->head < '0' || *ps->head > '9') && *ps->head != '-')
+    // Numbers are usually just one space away, so check a few bytes before going wide.
+    for (unsigned i = 0; i < 4; ++i)
     {
+        if (ps->head >= ps->end || is_numeric_start(*ps->head))
+            return;
+
         ++ps->head;
     }
+
+    #if defined(OBJ_USE_SSE2)
+        const __m128i zero_char = _mm_set1_epi8('0');
+        const __m128i nine = _mm_set1_epi8(9);
+        const __m128i minus = _mm_set1_epi8('-');
+        const __m128i plus = _mm_set1_epi8('+');
+        const __m128i dot = _mm_set1_epi8('.');
+
+        while (ps->end - ps->head >= 16)
+        {
+            __m128i c = _mm_loadu_si128((const __m128i*)ps->head);
+            __m128i offset = _mm_sub_epi8(c, zero_char);
+            __m128i digit = _mm_cmpeq_epi8(_mm_min_epu8(offset, nine), offset);
+            __m128i sign = _mm_or_si128(_mm_cmpeq_epi8(c, minus), _mm_cmpeq_epi8(c, plus));
+            int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(digit, sign), _mm_cmpeq_epi8(c, dot)));
+
+            if (mask != 0)
+            {
+                ps->head += bit_scan_forward((unsigned)mask);
+                return;
+            }
+
+            ps->head += 16;
+        }
+    #endif
+
+    while (ps->head < ps->end && !is_numeric_start(*ps->head))
+        ++ps->head;
+}
+
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Locale independent replacement for strtof. Up to 18 significant digits are accumulated in an integer, which is
+// far more than a float can hold, the rest only adjust the exponent. Mantissas below 2^53 with exponents up to
+// 22 are converted exactly through double, other values are within a couple of double ulps, which still rounds to
+// the right float. Like strtof, nothing is consumed and zero is returned if there is no number at the head.
+static float parse_float(ParserState* ps)
+{
+    const unsigned char* p = ps->head;
+    const unsigned char* end = ps->end;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    const unsigned long long max_mantissa = 100000000000000000ull;
+    unsigned long long mantissa = 0;
+    int exponent = 0;
+    bool has_digits = false;
+
+    for (; p < end && is_digit(*p); ++p)
+    {
+        has_digits = true;
+
+        if (mantissa < max_mantissa)
+            mantissa = mantissa * 10 + (*p - '0');
+        else
+            ++exponent;
+    }
+
+    if (p < end && *p == '.')
+    {
+        ++p;
+
+        for (; p < end && is_digit(*p); ++p)
+        {
+            has_digits = true;
+
+            if (mantissa < max_mantissa)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                --exponent;
+            }
+        }
+    }
+
+    if (!has_digits)
+        return 0.0f;
+
+    if (p < end && (*p == 'e' || *p == 'E'))
+    {
+        const unsigned char* e = p + 1;
+        bool negative_exponent = false;
+
+        if (e < end && (*e == '-' || *e == '+'))
+        {
+            negative_exponent = *e == '-';
+            ++e;
+        }
+
+        if (e < end && is_digit(*e))
+        {
+            int e_value = 0;
+
+            for (; e < end && is_digit(*e); ++e)
+            {
+                if (e_value < 10000)
+                    e_value = e_value * 10 + (*e - '0');
+            }
+
+            exponent += negative_exponent ? -e_value : e_value;
+            p = e;
+        }
+    }
+
+    ps->head = (unsigned char*)p;
+    double value = (double)mantissa;
+
+    if (exponent < 0)
+        value = exponent >= -22 ? value / exact_powers_of_ten[-exponent] : value / pow(10.0, -exponent);
+    else if (exponent > 0)
+        value = exponent <= 22 ? value * exact_powers_of_ten[exponent] : value * pow(10.0, exponent);
+
+    return (float)(negative ? -value : value);
+}
+
+// Same contract as parse_float, but for decimal integers.
+static int parse_int(ParserState* ps)
+{
+    const unsigned char* p = ps->head;
+    const unsigned char* end = ps->end;
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        ++p;
+    }
+
+    if (p >= end || !is_digit(*p))
+        return 0;
+
+    int value = 0;
+
+    for (; p < end && is_digit(*p); ++p)
+        value = value * 10 + (*p - '0');
+
+    ps->head = (unsigned char*)p;
+    return negative ? -value : value;
 }
 
 static void parse_uv(ParserState* ps, ParsedData* pd)
 {
     Vector2* uv = pd->uvs.push();
     skip_to_numeric(ps);
-    uv->x = strtof((const char*)ps->head, (char**)&ps->head);
+    uv->x = parse_float(ps);
     skip_to_numeric(ps);
-    uv->y = strtof((const char*)ps->head, (char**)&ps->head);
+    uv->y = parse_float(ps);
 }
 
 static void parse_normal(ParserState* ps, ParsedData* pd)
 {
     Vector3* normal = pd->normals.push();
     skip_to_numeric(ps);
-    normal->x = strtof((const char*)ps->head, (char**)&ps->head);
+    normal->x = parse_float(ps);
     skip_to_numeric(ps);
-    normal->y = strtof((const char*)ps->head, (char**)&ps->head);
+    normal->y = parse_float(ps);
     skip_to_numeric(ps);
-    normal->z = strtof((const char*)ps->head, (char**)&ps->head);
+    normal->z = parse_float(ps);
 }
 
 static void parse_vertex(ParserState* ps, ParsedData* pd)
 {
     Vector3* vertex = pd->vertices.push();
     skip_to_numeric(ps);
-    vertex->x = strtof((const char*)ps->head, (char**)&ps->head);
+    vertex->x = parse_float(ps);
     skip_to_numeric(ps);
-    vertex->y = strtof((const char*)ps->head, (char**)&ps->head);
+    vertex->y = parse_float(ps);
     skip_to_numeric(ps);
-    vertex->z = strtof((const char*)ps->head, (char**)&ps->head);
+    vertex->z = parse_float(ps);
 }
 
-static void parse_face(ParserState* ps, ParsedData* pd)
+static bool is_line_end(ParserState* ps)
 {
-    ParsedFace* face = pd->faces.push();
-    skip_to_numeric(ps);
-    face->v1 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
-    skip_to_numeric(ps);
-    face->u1 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
-    skip_to_numeric(ps);
-    face->n1 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
-    skip_to_numeric(ps);
-    face->v2 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
-    skip_to_numeric(ps);
-    face->u2 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
-    skip_to_numeric(ps);
-    face->n2 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
-    skip_to_numeric(ps);
-    face->v3 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
-    skip_to_numeric(ps);
-    face->u3 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
-    skip_to_numeric(ps);
-    face->n3 = strtol((const char*)ps->head, (char**)&ps->head, 10) - 1;
+    return ps->head >= ps->end || *ps->head == '\n' || *ps->head == '\r';
 }
 
-static void skip_line(ParserState* ps)
+static bool is_space(ParserState* ps)
+{
+    return ps->head < ps->end && (*ps->head == ' ' || *ps->head == '\t');
+}
+
+// Negative indices count back from the last element parsed so far. Chunks are parsed in parallel without knowing
+// how many elements come before them, so these are stored relative to the start of the chunk, where they can end
+// up negative. They are biased into the lower 31 bits and flagged, the rebase pass then makes them absolute.
+static const unsigned RelativeIndexBit = 0x80000000u;
+static const int RelativeIndexBias = 0x40000000;
+
+static unsigned parse_index(ParserState* ps, size_t num_parsed)
+{
+    if (ps->head >= ps->end || (!is_digit(*ps->head) && *ps->head != '-'))
+        return MissingIndex;
+
+    int i = parse_int(ps);
+
+    if (i < 0)
+        return (unsigned)((int)num_parsed + i + RelativeIndexBias) | RelativeIndexBit;
+
+    return (unsigned)(i - 1);
+}
+
+// Parses corners on the form v, v/vt, v//vn or v/vt/vn. Polygons are triangulated as a fan around the first
+// corner. Nearly all faces are triangles or quads, so the corners fit in the inline storage.
+static void parse_face(ParserState* ps, ParsedData* pd)
 {
-    while (ps->head < ps->end && *ps->head != '\n')
+    SmallArray<ParsedFaceCorner, 4> corners = small_array_create<ParsedFaceCorner, 4>(pd->faces.allocator);
+    ++ps->head;
+
+    for (;;)
     {
-        ++ps->head;
+        while (is_space(ps))
+            ++ps->head;
+
+        if (is_line_end(ps))
+            break;
+
+        ParsedFaceCorner* c = corners.push();
+        c->v = parse_index(ps, pd->vertices.num);
+        c->u = MissingIndex;
+        c->n = MissingIndex;
+
+        if (ps->head < ps->end && *ps->head == '/')
+        {
+            ++ps->head;
+            c->u = parse_index(ps, pd->uvs.num);
+
+            if (ps->head < ps->end && *ps->head == '/')
+            {
+                ++ps->head;
+                c->n = parse_index(ps, pd->normals.num);
+            }
+        }
+
+        while (!is_line_end(ps) && !is_space(ps))
+            ++ps->head;
     }
 
-    ++ps->head;
+    for (size_t i = 2; i < corners.num; ++i)
+    {
+        ParsedFace* face = pd->faces.push();
+        face->corners[0] = corners[0];
+        face->corners[1] = corners[i - 1];
+        face->corners[2] = corners[i];
+    }
+
+    small_array_destroy(&corners);
+}
+
+static void skip_line(ParserState* ps)
+{
+    ps->head = find_byte(ps->head, ps->end, '\n') + 1;
 }
 
-static ParsedData parse(Allocator* alloc, unsigned char* data, unsigned data_size)
+static void parse_chunk(ParsedData* pd, unsigned char* start, unsigned char* end)
 {
     ParserState ps = {};
-    ps.data = data;
-    ps.head = data;
-    ps.end = (unsigned char*)mem_ptr_add(data, data_size);
-    ParsedData pd = {};
-    pd.vertices = dynamic_array_create<Vector3>(alloc);
-    pd.normals = dynamic_array_create<Vector3>(alloc);
-    pd.uvs = dynamic_array_create<Vector2>(alloc);
-    pd.faces = dynamic_array_create<ParsedFace>(alloc);
-    ps.head = ps.data;
+    ps.data = start;
+    ps.head = start;
+    ps.end = end;
 
     while (ps.head < ps.end)
     {
@@ -125,60 +372,326 @@ static ParsedData parse(Allocator* alloc, unsigned char* data, unsigned data_siz
         if (!first_on_line)
             skip_line(&ps);
         else if (c == 'v' && ps.head + 1 < ps.end && (*(ps.head+1)) == 't')
-            parse_uv(&ps, &pd);
+            parse_uv(&ps, pd);
         else if (c == 'v' && ps.head + 1 < ps.end && (*(ps.head+1)) == 'n')
-            parse_normal(&ps, &pd);
+            parse_normal(&ps, pd);
         else if (c == 'v')
-            parse_vertex(&ps, &pd);
+            parse_vertex(&ps, pd);
         else if (c == 'f')
-            parse_face(&ps, &pd);
+            parse_face(&ps, pd);
         else
             skip_line(&ps);
     }
+}
 
-    return pd;
+static unsigned rebase_index(unsigned i, size_t offset)
+{
+    if (i == MissingIndex || (i & RelativeIndexBit) == 0)
+        return i;
+
+    return (unsigned)((long long)offset + (int)(i & ~RelativeIndexBit) - RelativeIndexBias);
+}
+
+static void rebase_faces(ParsedFace* dest, const ParsedFace* src, size_t num, size_t vertex_offset, size_t uv_offset, size_t normal_offset)
+{
+    for (size_t i = 0; i < num; ++i)
+    {
+        for (unsigned ci = 0; ci < 3; ++ci)
+        {
+            const ParsedFaceCorner& s = src[i].corners[ci];
+            ParsedFaceCorner& d = dest[i].corners[ci];
+            d.v = rebase_index(s.v, vertex_offset);
+            d.u = rebase_index(s.u, uv_offset);
+            d.n = rebase_index(s.n, normal_offset);
+        }
+    }
 }
 
-static int get_existing_vertex(const DynamicArray<Vertex>& vertices, const Vertex& v1)
+static const unsigned MaxParseThreads = 64;
+static const size_t MinParseChunkSize = 4 * 1024 * 1024;
+
+// The temp allocator isn't thread safe, so chunks are parsed into arrays on the per-thread heaps and copied into
+// the arrays of the caller's allocator once all chunk sizes are known.
+struct ParseChunk
+{
+    Allocator allocator;
+    unsigned char* start;
+    unsigned char* end;
+    ParsedData pd;
+    size_t vertex_offset;
+    size_t normal_offset;
+    size_t uv_offset;
+    size_t face_offset;
+};
+
+static void parse_chunk_thread(ParseChunk* chunk)
 {
-    for (unsigned i = 0; i < vertices.num; ++i)
+    TRACE_SCOPE("obj_parse_chunk");
+    chunk->pd.vertices = dynamic_array_create<Vector3>(&chunk->allocator);
+    chunk->pd.normals = dynamic_array_create<Vector3>(&chunk->allocator);
+    chunk->pd.uvs = dynamic_array_create<Vector2>(&chunk->allocator);
+    chunk->pd.faces = dynamic_array_create<ParsedFace>(&chunk->allocator);
+    parse_chunk(&chunk->pd, chunk->start, chunk->end);
+}
+
+static void copy_chunk_thread(ParseChunk* chunk, ParsedData* pd)
+{
+    TRACE_SCOPE("obj_copy_chunk");
+    ParsedData* cpd = &chunk->pd;
+    memcpy(pd->vertices.data + chunk->vertex_offset, cpd->vertices.data, cpd->vertices.num * sizeof(Vector3));
+    memcpy(pd->normals.data + chunk->normal_offset, cpd->normals.data, cpd->normals.num * sizeof(Vector3));
+    memcpy(pd->uvs.data + chunk->uv_offset, cpd->uvs.data, cpd->uvs.num * sizeof(Vector2));
+    rebase_faces(pd->faces.data + chunk->face_offset, cpd->faces.data, cpd->faces.num, chunk->vertex_offset, chunk->uv_offset, chunk->normal_offset);
+    dynamic_array_destroy(&cpd->vertices);
+    dynamic_array_destroy(&cpd->normals);
+    dynamic_array_destroy(&cpd->uvs);
+    dynamic_array_destroy(&cpd->faces);
+}
+
+// Splits the file at line boundaries into one chunk per thread. Element counts of the chunks are prefix summed
+// into offsets, then each chunk is copied into place and has its relative face indices rebased, also in parallel.
+static ParsedData parse(Allocator* alloc, unsigned char* data, size_t data_size)
+{
+    TRACE_SCOPE("obj_parse");
+    unsigned char* end = (unsigned char*)mem_ptr_add(data, data_size);
+    ParsedData pd = {};
+    pd.vertices = dynamic_array_create<Vector3>(alloc);
+    pd.normals = dynamic_array_create<Vector3>(alloc);
+    pd.uvs = dynamic_array_create<Vector2>(alloc);
+    pd.faces = dynamic_array_create<ParsedFace>(alloc);
+
+    size_t num_chunks = std::thread::hardware_concurrency();
+    num_chunks = num_chunks < MaxParseThreads ? num_chunks : MaxParseThreads;
+    num_chunks = num_chunks < data_size / MinParseChunkSize ? num_chunks : data_size / MinParseChunkSize;
+
+    if (num_chunks <= 1)
+    {
+        parse_chunk(&pd, data, end);
+        rebase_faces(pd.faces.data, pd.faces.data, pd.faces.num, 0, 0, 0);
+        return pd;
+    }
+
+    ParseChunk chunks[MaxParseThreads] = {};
+    std::thread threads[MaxParseThreads];
+    unsigned char* chunk_start = data;
+
+    for (size_t i = 0; i < num_chunks; ++i)
     {
-        const Vertex& v2 = vertices[i];
+        unsigned char* chunk_end = end;
 
-        if (almost_equal(v1.position, v2.position)
-            && almost_equal(v1.normal, v2.normal)
-            && almost_equal(v1.uv, v2.uv)
-            && almost_equal(v1.color, v2.color))
+        if (i + 1 < num_chunks)
         {
-            return i;
+            chunk_end = find_byte(data + data_size / num_chunks * (i + 1), end, '\n');
+            chunk_end = chunk_end < end ? chunk_end + 1 : end;
+            chunk_end = chunk_end > chunk_start ? chunk_end : chunk_start;
         }
+
+        ParseChunk* c = chunks + i;
+        c->allocator = create_heap_allocator();
+        c->start = chunk_start;
+        c->end = chunk_end;
+        threads[i] = std::thread(parse_chunk_thread, c);
+        chunk_start = chunk_end;
+    }
+
+    for (size_t i = 0; i < num_chunks; ++i)
+        threads[i].join();
+
+    size_t num_vertices = 0, num_normals = 0, num_uvs = 0, num_faces = 0;
+
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        ParseChunk* c = chunks + i;
+        c->vertex_offset = num_vertices;
+        c->normal_offset = num_normals;
+        c->uv_offset = num_uvs;
+        c->face_offset = num_faces;
+        num_vertices += c->pd.vertices.num;
+        num_normals += c->pd.normals.num;
+        num_uvs += c->pd.uvs.num;
+        num_faces += c->pd.faces.num;
+    }
+
+    pd.vertices.reserve(num_vertices);
+    pd.vertices.num = num_vertices;
+    pd.normals.reserve(num_normals);
+    pd.normals.num = num_normals;
+    pd.uvs.reserve(num_uvs);
+    pd.uvs.num = num_uvs;
+    pd.faces.reserve(num_faces);
+    pd.faces.num = num_faces;
+
+    for (size_t i = 0; i < num_chunks; ++i)
+        threads[i] = std::thread(copy_chunk_thread, chunks + i, &pd);
+
+    for (size_t i = 0; i < num_chunks; ++i)
+    {
+        threads[i].join();
+        heap_allocator_check_clean(&chunks[i].allocator);
+    }
+
+    return pd;
+}
+
+// Welding looks vertices up in an open-addressed hash map keyed on the vertex quantized to the weld tolerance,
+// candidates in the same cell are then compared with the tolerance like before. Two values that are within the
+// tolerance but straddle a cell border are not welded, which only costs a duplicated vertex.
+
+struct WeldSlot
+{
+    unsigned hash;
+    unsigned index_plus_one;
+};
+
+struct VertexWelder
+{
+    Allocator* allocator;
+    WeldSlot* slots;
+    size_t capacity;
+    size_t num;
+    float tolerance;
+    double inv_tolerance;
+};
+
+static unsigned long long hash_quantized(unsigned long long h, float f, double inv_tolerance)
+{
+    // Adding 0.0 turns -0 into +0, so they hash the same.
+    double q = floor(f * inv_tolerance) + 0.0;
+    unsigned long long bits;
+    memcpy(&bits, &q, sizeof(bits));
+    h ^= bits;
+    h *= 0x100000001b3ull;
+    return h ^ (h >> 29);
+}
+
+static unsigned hash_vertex(const VertexWelder& w, const Vertex& v)
+{
+    const float* f = &v.position.x;
+    unsigned long long h = 0xcbf29ce484222325ull;
+
+    for (unsigned i = 0; i < sizeof(Vertex) / sizeof(float); ++i)
+        h = hash_quantized(h, f[i], w.inv_tolerance);
+
+    return (unsigned)(h ^ (h >> 32));
+}
+
+static bool vertex_almost_equal(const Vertex& v1, const Vertex& v2, float tolerance)
+{
+    const float* f1 = &v1.position.x;
+    const float* f2 = &v2.position.x;
+
+    for (unsigned i = 0; i < sizeof(Vertex) / sizeof(float); ++i)
+    {
+        if (fabs(f2[i] - f1[i]) >= tolerance)
+            return false;
     }
 
-    return -1;
+    return true;
+}
+
+static void welder_insert_slot(VertexWelder* w, unsigned hash, unsigned index)
+{
+    size_t mask = w->capacity - 1;
+    size_t i = hash & mask;
+
+    while (w->slots[i].index_plus_one != 0)
+        i = (i + 1) & mask;
+
+    w->slots[i].hash = hash;
+    w->slots[i].index_plus_one = index + 1;
+    ++w->num;
 }
 
-static void add_vertex_to_mesh(Mesh* m, const Vector3& pos, const Vector3& normal, const Vector2& uv, const Color& c)
+static void welder_set_capacity(VertexWelder* w, size_t min_capacity)
+{
+    WeldSlot* old_slots = w->slots;
+    size_t old_capacity = w->capacity;
+    size_t capacity = 64;
+
+    while (capacity < min_capacity)
+        capacity *= 2;
+
+    w->slots = (WeldSlot*)w->allocator->alloc(capacity * sizeof(WeldSlot));
+    memset(w->slots, 0, capacity * sizeof(WeldSlot));
+    w->capacity = capacity;
+    w->num = 0;
+
+    for (size_t i = 0; i < old_capacity; ++i)
+    {
+        if (old_slots[i].index_plus_one != 0)
+            welder_insert_slot(w, old_slots[i].hash, old_slots[i].index_plus_one - 1);
+    }
+
+    w->allocator->dealloc(old_slots);
+}
+
+static VertexWelder welder_create(Allocator* alloc, size_t expected_num_vertices, float tolerance)
+{
+    VertexWelder w = {};
+    w.allocator = alloc;
+    w.tolerance = tolerance;
+    w.inv_tolerance = 1.0 / tolerance;
+    welder_set_capacity(&w, expected_num_vertices * 2);
+    return w;
+}
+
+static void welder_destroy(VertexWelder* w)
+{
+    w->allocator->dealloc(w->slots);
+}
+
+static void add_vertex_to_mesh(Mesh* m, VertexWelder* w, const Vector3& pos, const Vector3& normal, const Vector2& uv, const Color& c)
 {
     Vertex v = {};
     v.position = pos;
     v.normal = normal;
     v.uv = uv;
     v.color = c;
-    
-    int i = get_existing_vertex(m->vertices, v);
 
-    if (i != -1)
+    unsigned hash = hash_vertex(*w, v);
+    size_t mask = w->capacity - 1;
+
+    for (size_t i = hash & mask; w->slots[i].index_plus_one != 0; i = (i + 1) & mask)
     {
-        m->indices.add(i);
-        return;
+        const WeldSlot& slot = w->slots[i];
+
+        if (slot.hash == hash && vertex_almost_equal(m->vertices[slot.index_plus_one - 1], v, w->tolerance))
+        {
+            m->indices.add(slot.index_plus_one - 1);
+            return;
+        }
     }
 
-    m->indices.add(m->vertices.num);
+    unsigned index = (unsigned)m->vertices.num;
+    m->indices.add(index);
     m->vertices.add(v);
+
+    if ((w->num + 1) * 2 > w->capacity)
+        welder_set_capacity(w, w->capacity * 2);
+
+    welder_insert_slot(w, hash, index);
+}
+
+static void add_faces_to_mesh(Mesh* m, VertexWelder* w, const ParsedData& pd)
+{
+    TRACE_SCOPE("obj_weld");
+    for (size_t i = 0; i < pd.faces.num; ++i)
+    {
+        const ParsedFace& f = pd.faces[i];
+
+        for (unsigned ci = 0; ci < 3; ++ci)
+        {
+            const ParsedFaceCorner& c = f.corners[ci];
+            Vector3 normal = c.n == MissingIndex ? vector3_zero : pd.normals[c.n];
+            Vector2 uv = c.u == MissingIndex ? Vector2{0, 0} : pd.uvs[c.u];
+            add_vertex_to_mesh(m, w, pd.vertices[c.v], normal, uv, {1.0f, 0.0f, 1.0f, 1.0f});
+        }
+    }
 }
 
-LoadedMesh obj_load(Allocator* alloc, const char* filename)
+LoadedMesh obj_load(Allocator* alloc, const char* filename, float weld_tolerance)
 {
+    TRACE_SCOPE("obj_load");
     LoadedFile lf = file_load(alloc, filename);
 
     if (!lf.valid)
@@ -188,14 +701,79 @@ LoadedMesh obj_load(Allocator* alloc, const char* filename)
     Mesh m = {};
     m.vertices = dynamic_array_create<Vertex>(alloc);
     m.indices = dynamic_array_create<unsigned>(alloc);
+    m.indices.reserve(pd.faces.num * 3);
+    m.vertices.reserve(pd.vertices.num);
+    VertexWelder welder = welder_create(alloc, pd.vertices.num, weld_tolerance);
+    add_faces_to_mesh(&m, &welder, pd);
+    welder_destroy(&welder);
+    return {true, m};
+}
+
+static const size_t StreamWindowSize = 4 * 1024 * 1024;
+
+LoadedMesh obj_load_streaming(Allocator* alloc, const char* filename, float weld_tolerance)
+{
+    TRACE_SCOPE("obj_load_streaming");
+    FILE* file_handle = fopen(filename, "rb");
 
-    for (unsigned i = 0; i < pd.faces.num; ++i)
+    if (file_handle == nullptr)
+        return {false};
+
+    size_t window_size = StreamWindowSize;
+    unsigned char* window = (unsigned char*)alloc->alloc(window_size);
+    size_t num_buffered = 0;
+    ParsedData pd = {};
+    pd.vertices = dynamic_array_create<Vector3>(alloc);
+    pd.normals = dynamic_array_create<Vector3>(alloc);
+    pd.uvs = dynamic_array_create<Vector2>(alloc);
+    pd.faces = dynamic_array_create<ParsedFace>(alloc);
+    Mesh m = {};
+    m.vertices = dynamic_array_create<Vertex>(alloc);
+    m.indices = dynamic_array_create<unsigned>(alloc);
+    VertexWelder welder = welder_create(alloc, 0, weld_tolerance);
+
+    for (;;)
     {
-        const ParsedFace& f = pd.faces[i];
-        add_vertex_to_mesh(&m, pd.vertices[f.v1], pd.normals[f.n1], pd.uvs[f.u1], {1.0f, 0.0f, 1.0f, 1.0f});
-        add_vertex_to_mesh(&m, pd.vertices[f.v2], pd.normals[f.n2], pd.uvs[f.u2], {1.0f, 0.0f, 1.0f, 1.0f});
-        add_vertex_to_mesh(&m, pd.vertices[f.v3], pd.normals[f.n3], pd.uvs[f.u3], {1.0f, 0.0f, 1.0f, 1.0f});
+        num_buffered += fread(window + num_buffered, 1, window_size - num_buffered, file_handle);
+        bool at_end = num_buffered < window_size;
+        unsigned char* parse_end = window + num_buffered;
+
+        // Only whole lines are parsed, the partial line at the end is moved to the start of the window and
+        // completed by the next read. A line that doesn't fit in the window makes the window grow.
+        if (!at_end)
+        {
+            while (parse_end > window && *(parse_end - 1) != '\n')
+                --parse_end;
+
+            if (parse_end == window)
+            {
+                unsigned char* larger_window = (unsigned char*)alloc->alloc(window_size * 2);
+                memcpy(larger_window, window, num_buffered);
+                alloc->dealloc(window);
+                window = larger_window;
+                window_size *= 2;
+                continue;
+            }
+        }
+
+        parse_chunk(&pd, window, parse_end);
+        rebase_faces(pd.faces.data, pd.faces.data, pd.faces.num, 0, 0, 0);
+        add_faces_to_mesh(&m, &welder, pd);
+        pd.faces.num = 0;
+
+        num_buffered = (size_t)(window + num_buffered - parse_end);
+        memmove(window, parse_end, num_buffered);
+
+        if (at_end)
+            break;
     }
 
+    fclose(file_handle);
+    welder_destroy(&welder);
+    dynamic_array_destroy(&pd.faces);
+    dynamic_array_destroy(&pd.uvs);
+    dynamic_array_destroy(&pd.normals);
+    dynamic_array_destroy(&pd.vertices);
+    alloc->dealloc(window);
     return {true, m};
 }
@@ -9,4 +9,11 @@ struct LoadedMesh
     Mesh mesh;
 };
 
-LoadedMesh obj_load(Allocator* alloc, const char* filename);
+// Vertices whose attributes all differ by less than weld_tolerance are merged into one.
+LoadedMesh obj_load(Allocator* alloc, const char* filename, float weld_tolerance = SmallNumber);
+
+// Reads the file through a fixed size window instead of loading all of it, and welds faces into the mesh as they
+// are read. Only the v, vt and vn pools are kept for the whole load since faces may refer back to any of them,
+// they are compact compared to both the text and the welded vertices. Slower than obj_load, which parses on all
+// threads, but peak memory is about the size of the output mesh rather than several times the file size.
+LoadedMesh obj_load_streaming(Allocator* alloc, const char* filename, float weld_tolerance = SmallNumber);
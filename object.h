@@ -5,9 +5,18 @@
 struct Object
 {
     RRHandle geometry_handle;
+
+    // Simplified version of geometry_handle, see mesh_simplify, or invalid. Objects that have one only occlude in
+    // the radiosity mapper: they get no patches or lightmap, and hemicubes draw the proxy into the depth buffer
+    // only, so it hides what is behind it without adding any light of its own.
+    RRHandle occluder_geometry_handle;
     RRHandle lightmap_handle;
     RRHandle lightmap_patch_offset;
     unsigned id;
     Matrix4x4 world_transform;
+
+    // Box around the geometry in world space, used for culling. Set where the object is created, it has to be
+    // updated if world_transform changes.
+    Aabb world_bounds;
     bool is_light;
 };
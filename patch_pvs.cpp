@@ -0,0 +1,171 @@
+#include "patch_pvs.h"
+#include <stdlib.h>
+#include "memory.h"
+#include "trace.h"
+
+// Bits of each cell coordinate in a cluster key, scenes wider than this many cells share cells at the edges.
+static const unsigned CellBits = 10;
+static const unsigned MaxCell = (1u << CellBits) - 1;
+
+// How far behind a patch an object may be and still count as visible, covers the precision of the positions
+// read back from the GPU. Objects touching the plane of a patch, like the object the patch is on, are kept.
+static const float FacingTolerance = 0.001f;
+
+struct ClusterEntry
+{
+    uint64_t key;
+    unsigned patch;
+};
+
+static int compare_entries(const void* a, const void* b)
+{
+    const ClusterEntry* ea = (const ClusterEntry*)a;
+    const ClusterEntry* eb = (const ClusterEntry*)b;
+
+    if (ea->key != eb->key)
+        return ea->key < eb->key ? -1 : 1;
+
+    return ea->patch < eb->patch ? -1 : (ea->patch > eb->patch ? 1 : 0);
+}
+
+static float largest(float a, float b)
+{
+    return a > b ? a : b;
+}
+
+static float smallest(float a, float b)
+{
+    return a < b ? a : b;
+}
+
+static void aabb_add(Aabb* b, const Vector3& p)
+{
+    b->min = {smallest(b->min.x, p.x), smallest(b->min.y, p.y), smallest(b->min.z, p.z)};
+    b->max = {largest(b->max.x, p.x), largest(b->max.y, p.y), largest(b->max.z, p.z)};
+}
+
+// Which of +x, -x, +y, -y, +z and -z n is closest to.
+static unsigned major_direction(const Vector3& n)
+{
+    float ax = fabsf(n.x), ay = fabsf(n.y), az = fabsf(n.z);
+
+    if (ax >= ay && ax >= az)
+        return n.x >= 0 ? 0 : 1;
+
+    if (ay >= az)
+        return n.y >= 0 ? 2 : 3;
+
+    return n.z >= 0 ? 4 : 5;
+}
+
+static unsigned cell(float v, float origin, float cluster_size)
+{
+    float c = (v - origin) / cluster_size;
+    return c <= 0 ? 0 : (c >= (float)MaxCell ? MaxCell : (unsigned)c);
+}
+
+// Upper bound of n.(x - p) for n, p and x anywhere in the normals, positions and box. A patch at p with normal n
+// can only see x if that is positive. Each component of the dot product is a product of two ranges, which is
+// largest at a pair of their ends.
+static float max_facing(const Aabb& normals, const Aabb& positions, const Aabb& box)
+{
+    const float* n_min = &normals.min.x;
+    const float* n_max = &normals.max.x;
+    const float* p_min = &positions.min.x;
+    const float* p_max = &positions.max.x;
+    const float* x_min = &box.min.x;
+    const float* x_max = &box.max.x;
+    float sum = 0;
+
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        float d_min = x_min[i] - p_max[i];
+        float d_max = x_max[i] - p_min[i];
+        sum += largest(largest(n_min[i] * d_min, n_min[i] * d_max), largest(n_max[i] * d_min, n_max[i] * d_max));
+    }
+
+    return sum;
+}
+
+PatchPvs patch_pvs_create(Allocator* alloc, const Vector3* positions, const Vector3* normals, const unsigned* patch_objects,
+    size_t num_patches, const Aabb* object_bounds, size_t num_objects, float cluster_size)
+{
+    TRACE_SCOPE("patch_pvs_create");
+    Assert(cluster_size > 0, "PVS cluster size must be positive.");
+    Assert(num_objects < (1ull << 31), "Too many objects for the PVS cluster keys.");
+
+    PatchPvs pvs = {};
+    pvs.clusters = dynamic_array_create<PvsCluster>(alloc);
+    pvs.patch_clusters = dynamic_array_create<unsigned>(alloc);
+    pvs.visible_objects = dynamic_array_create<unsigned>(alloc);
+
+    if (num_patches == 0)
+        return pvs;
+
+    Aabb all = {positions[0], positions[0]};
+
+    for (size_t i = 1; i < num_patches; ++i)
+        aabb_add(&all, positions[i]);
+
+    // Object, direction and cell, so that sorting puts each cluster in a run.
+    ClusterEntry* entries = (ClusterEntry*)alloc->alloc(num_patches * sizeof(ClusterEntry));
+
+    for (size_t i = 0; i < num_patches; ++i)
+    {
+        const Vector3& p = positions[i];
+        uint64_t cells = (uint64_t)cell(p.x, all.min.x, cluster_size)
+            | ((uint64_t)cell(p.y, all.min.y, cluster_size) << CellBits)
+            | ((uint64_t)cell(p.z, all.min.z, cluster_size) << (2 * CellBits));
+        entries[i].key = ((uint64_t)patch_objects[i] << (3 * CellBits + 3)) | ((uint64_t)major_direction(normals[i]) << (3 * CellBits)) | cells;
+        entries[i].patch = (unsigned)i;
+    }
+
+    qsort(entries, num_patches, sizeof(ClusterEntry), compare_entries);
+    pvs.patch_clusters.resize(num_patches);
+
+    for (size_t i = 0; i < num_patches; ++i)
+    {
+        unsigned patch = entries[i].patch;
+
+        if (i == 0 || entries[i].key != entries[i - 1].key)
+        {
+            PvsCluster c = {};
+            c.positions = {positions[patch], positions[patch]};
+            c.normals = {normals[patch], normals[patch]};
+            pvs.clusters.add(c);
+        }
+        else
+        {
+            PvsCluster& c = pvs.clusters[pvs.clusters.num - 1];
+            aabb_add(&c.positions, positions[patch]);
+            aabb_add(&c.normals, normals[patch]);
+        }
+
+        pvs.patch_clusters[patch] = (unsigned)(pvs.clusters.num - 1);
+    }
+
+    alloc->dealloc(entries);
+
+    for (size_t ci = 0; ci < pvs.clusters.num; ++ci)
+    {
+        PvsCluster& c = pvs.clusters[ci];
+        c.first_visible = (unsigned)pvs.visible_objects.num;
+
+        for (size_t oi = 0; oi < num_objects; ++oi)
+        {
+            if (max_facing(c.normals, c.positions, object_bounds[oi]) >= -FacingTolerance)
+                pvs.visible_objects.add((unsigned)oi);
+        }
+
+        c.num_visible = (unsigned)(pvs.visible_objects.num - c.first_visible);
+    }
+
+    return pvs;
+}
+
+void patch_pvs_destroy(PatchPvs* pvs)
+{
+    dynamic_array_destroy(&pvs->clusters);
+    dynamic_array_destroy(&pvs->patch_clusters);
+    dynamic_array_destroy(&pvs->visible_objects);
+}
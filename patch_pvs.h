@@ -0,0 +1,44 @@
+#pragma once
+#include "math.h"
+#include "dynamic_array.h"
+
+struct Allocator;
+
+// Potentially visible sets for the radiosity mapper. Patches of an object that are close to each other and face
+// the same way are grouped into clusters, and each cluster gets the objects that any patch in it could possibly
+// see, so that its hemicubes only draw those. The test only uses bounding boxes and the facing of the patches, it
+// doesn't know about occlusion, so it never leaves out an object a patch can see.
+struct PvsCluster
+{
+    Aabb positions;
+
+    // Box around the normals of the patches, not around the directions they cover.
+    Aabb normals;
+
+    // Range in PatchPvs::visible_objects, sorted by object index.
+    unsigned first_visible;
+    unsigned num_visible;
+};
+
+struct PatchPvs
+{
+    DynamicArray<PvsCluster> clusters;
+
+    // Index in clusters of each patch.
+    DynamicArray<unsigned> patch_clusters;
+
+    // The visible object indices of all clusters, back to back.
+    DynamicArray<unsigned> visible_objects;
+};
+
+// Patches are clustered per object, by cells of cluster_size world units and by which of the six axis directions
+// their normal is closest to. patch_objects is the index of the object each patch is on, object_bounds the world
+// space bounds of every object.
+PatchPvs patch_pvs_create(Allocator* alloc, const Vector3* positions, const Vector3* normals, const unsigned* patch_objects,
+    size_t num_patches, const Aabb* object_bounds, size_t num_objects, float cluster_size);
+void patch_pvs_destroy(PatchPvs* pvs);
+
+inline const PvsCluster& patch_pvs_cluster(const PatchPvs& pvs, size_t patch_index)
+{
+    return pvs.clusters[pvs.patch_clusters[patch_index]];
+}
@@ -0,0 +1,154 @@
+#include <assert.h>
+#include <stdlib.h>
+#include "helpers.h"
+#include "memory.cpp"
+#include "math.cpp"
+#include "camera.cpp"
+#include "patch_pvs.cpp"
+
+static bool cluster_sees(const PatchPvs& pvs, size_t patch_index, unsigned object_index)
+{
+    const PvsCluster& c = patch_pvs_cluster(pvs, patch_index);
+
+    for (unsigned i = 0; i < c.num_visible; ++i)
+    {
+        if (pvs.visible_objects[c.first_visible + i] == object_index)
+            return true;
+    }
+
+    return false;
+}
+
+// Whether p is in the part of the view of camera c between left and right, bottom and top in normalized device
+// coordinates, like a hemicube side drawn with a scissor rect.
+static bool camera_sees(const Camera& c, float left, float right, float bottom, float top, const Vector3& p)
+{
+    Vector4 clip = Vector4{p.x, p.y, p.z, 1} * (camera_calc_view_matrix(c) * c.projection_matrix);
+
+    if (clip.w <= 0 || clip.z < 0 || clip.z > clip.w)
+        return false;
+
+    float x = clip.x / clip.w;
+    float y = clip.y / clip.w;
+    return x >= left && x <= right && y >= bottom && y <= top;
+}
+
+static bool hemicube_sees(const Vector3& position, const Vector3& normal, const Vector3& p)
+{
+    Hemicube h = camera_create_hemicube(position, normal);
+    return camera_sees(h.front, -1, 1, -1, 1, p)
+        || camera_sees(h.right, -1, 0, -1, 1, p)
+        || camera_sees(h.left, 0, 1, -1, 1, p)
+        || camera_sees(h.up, -1, 1, -1, 0, p)
+        || camera_sees(h.down, -1, 1, 0, 1, p);
+}
+
+int main()
+{
+    const size_t temp_memory_size = 1024 * 1024;
+    void* temp_memory_block = malloc(temp_memory_size);
+    temp_memory_blob_init(temp_memory_block, temp_memory_size);
+
+    // A floor with a box above it, a box below it and a wall standing on it. The floor has patches on its top,
+    // the wall on its +x side.
+    Aabb object_bounds[] = {
+        {{-5, -1, -5}, {5, 0, 5}},
+        {{-1, 1, -1}, {1, 2, 1}},
+        {{-1, -3, -1}, {1, -2, 1}},
+        {{0, 0, -5}, {0.2f, 3, 5}},
+    };
+
+    Vector3 positions[] = {
+        {0.1f, 0, 0.1f}, {0.2f, 0, 0.1f}, {3, 0, 3},
+        {0.2f, 1, 0}, {0.2f, 1.1f, 0},
+    };
+
+    Vector3 normals[] = {
+        {0, 1, 0}, {0, 1, 0}, {0, 1, 0},
+        {1, 0, 0}, {1, 0, 0},
+    };
+
+    unsigned patch_objects[] = {0, 0, 0, 3, 3};
+    const size_t num_patches = sizeof(positions) / sizeof(positions[0]);
+    const size_t num_objects = sizeof(object_bounds) / sizeof(object_bounds[0]);
+
+    {
+        Allocator ta = create_temp_allocator();
+        PatchPvs pvs = patch_pvs_create(&ta, positions, normals, patch_objects, num_patches, object_bounds, num_objects, 1.0f);
+
+        // Patches close together on the same side share a cluster, the far floor patch and the wall don't.
+        assert(pvs.clusters.num == 3);
+        assert(pvs.patch_clusters[0] == pvs.patch_clusters[1]);
+        assert(pvs.patch_clusters[0] != pvs.patch_clusters[2]);
+        assert(pvs.patch_clusters[3] == pvs.patch_clusters[4]);
+        assert(pvs.patch_clusters[0] != pvs.patch_clusters[3]);
+
+        // The floor sees what is above it, and the wall standing on it, but not the box below it.
+        assert(cluster_sees(pvs, 0, 1));
+        assert(cluster_sees(pvs, 0, 3));
+        assert(!cluster_sees(pvs, 0, 2));
+        assert(cluster_sees(pvs, 2, 1));
+        assert(!cluster_sees(pvs, 2, 2));
+
+        // The wall sees everything that reaches past its plane, the box below the floor too since occlusion isn't
+        // considered.
+        assert(cluster_sees(pvs, 3, 0));
+        assert(cluster_sees(pvs, 3, 1));
+        assert(cluster_sees(pvs, 3, 2));
+
+        // No hemicube side of a patch sees any part of an object that is left out of its cluster.
+        for (size_t pi = 0; pi < num_patches; ++pi)
+        {
+            for (unsigned oi = 0; oi < num_objects; ++oi)
+            {
+                if (cluster_sees(pvs, pi, oi))
+                    continue;
+
+                const Aabb& b = object_bounds[oi];
+
+                for (unsigned i = 0; i < 5 * 5 * 5; ++i)
+                {
+                    Vector3 t = {(float)(i % 5) / 4, (float)((i / 5) % 5) / 4, (float)(i / 25) / 4};
+                    Vector3 p = b.min + (b.max - b.min) * t;
+                    assert(!hemicube_sees(positions[pi], normals[pi], p));
+                }
+            }
+        }
+
+        // Visible objects are in object order.
+        for (size_t ci = 0; ci < pvs.clusters.num; ++ci)
+        {
+            const PvsCluster& c = pvs.clusters[ci];
+
+            for (unsigned i = 1; i < c.num_visible; ++i)
+                assert(pvs.visible_objects[c.first_visible + i - 1] < pvs.visible_objects[c.first_visible + i]);
+        }
+
+        patch_pvs_destroy(&pvs);
+    }
+
+    {
+        // Tilted normals make the cluster see more, never less.
+        Vector3 tilted_normals[] = {
+            {0, 1, 0}, {-0.5f, 0.866f, 0}, {0, 1, 0},
+            {1, 0, 0}, {1, 0, 0},
+        };
+
+        Allocator ta = create_temp_allocator();
+        PatchPvs pvs = patch_pvs_create(&ta, positions, tilted_normals, patch_objects, num_patches, object_bounds, num_objects, 1.0f);
+        assert(pvs.patch_clusters[0] == pvs.patch_clusters[1]);
+        assert(cluster_sees(pvs, 0, 1));
+        assert(cluster_sees(pvs, 0, 3));
+        patch_pvs_destroy(&pvs);
+    }
+
+    {
+        Allocator ta = create_temp_allocator();
+        PatchPvs pvs = patch_pvs_create(&ta, nullptr, nullptr, nullptr, 0, object_bounds, num_objects, 1.0f);
+        assert(pvs.clusters.num == 0);
+        patch_pvs_destroy(&pvs);
+    }
+
+    free(temp_memory_block);
+    return 0;
+}
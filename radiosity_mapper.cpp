@@ -1,4 +1,6 @@
 #include "radiosity_mapper.h"
+#include <chrono>
+#include "config.h"
 #include "renderer_direct3d.h"
 #include "file.h"
 #include "windows_window.h"
@@ -6,18 +8,18 @@
 #include "keyboard.h"
 #include <stdio.h>
 #include "dynamic_array.h"
+#include "small_array.h"
 #include "world.h"
 #include "camera.h"
 #include "memory.h"
 #include "distortion_texture.h"
+#include "lightmap_uv.h"
+#include "patch_pvs.h"
+#include "trace.h"
 
 struct Patch
 {
-    Camera front;
-    Camera right;
-    Camera left;
-    Camera up;
-    Camera down;
+    Hemicube hemicube;
     unsigned uv_index;
     ColorRGB emission;
     ColorRGB excident;
@@ -25,19 +27,50 @@ struct Patch
     float reflectance;
 };
 
-static const unsigned LightmapSize = 64;
+// Small objects only cover a handful of lightmap texels, those lists stay inline.
+typedef SmallArray<unsigned, 16> PatchList;
 
-static const Rect scissor_full = {0, 0, LightmapSize, LightmapSize};
-static const Rect scissor_top = {0, 0, LightmapSize, LightmapSize/2};
-static const Rect scissor_bottom = {0, LightmapSize/2, LightmapSize, LightmapSize};
-static const Rect scissor_left = {0, 0, LightmapSize/2, LightmapSize};
-static const Rect scissor_right = {LightmapSize/2, 0, LightmapSize, LightmapSize};
+typedef std::chrono::steady_clock Clock;
 
-static ColorRGB draw_hemicube_side(Renderer* renderer, const World& world, const Rect& scissor_rect,
-    const Camera& camera, const RenderTarget& light_contrib_texture, Patch* patches)
+// World space size of the cells that patches are clustered by for their potentially visible sets.
+static const float PvsClusterSize = 0.5f;
+
+static double elapsed_ms(Clock::time_point start)
 {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// FNV-1a.
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+// The patch arrays grow side by side on the temp allocator, so none of them stays the latest allocation and can be
+// extended in place. Every reallocation keeps its old block until the mapper returns, reserving exactly what each
+// object adds made that quadratic in the number of objects. Growing at least geometrically keeps the old blocks
+// smaller than the final array.
+template<typename T>
+static void reserve_geometric(DynamicArray<T>* a, size_t n)
+{
+    if (n > a->capacity)
+        a->reserve(n > a->capacity * 2 ? n : a->capacity * 2);
+}
+
+static ColorRGB draw_hemicube_side(Renderer* renderer, const World& world, const unsigned* object_indices, size_t num_objects,
+    const Rect& scissor_rect, const Camera& camera, const RenderTarget& light_contrib_texture, Patch* patches)
+{
+    TRACE_SCOPE("draw_hemicube_side");
     renderer->set_scissor_rect(scissor_rect);
-    renderer->draw_frame(world, camera, DrawLights::DrawLights);
+    renderer->draw_frame(world, object_indices, num_objects, camera, DrawLights::DrawLights, DrawOccluders::DepthOnlyProxies);
     MappedTexture m = renderer->map_texture(light_contrib_texture);
 
     unsigned* patch_offsets = (unsigned*)m.data;
@@ -45,38 +78,106 @@ static ColorRGB draw_hemicube_side(Renderer* renderer, const World& world, const
     unsigned num_pixels = light_contrib_texture.width * light_contrib_texture.height;
     for (unsigned pixel_index = 0; pixel_index < num_pixels; ++pixel_index)
     {
-        unsigned patch_index = patch_offsets[pixel_index];
-        Patch& p = patches[patch_index];
+        // 0 is the background, occluders and texels outside the charts.
+        unsigned patch_offset = patch_offsets[pixel_index];
+
+        if (patch_offset == 0)
+            continue;
+
+        Patch& p = patches[patch_offset - 1];
         total_light += p.excident;
     }
     renderer->unmap_texture(m);
     return total_light;
 }
 
-void run_radiosity_mapper(World& world, Renderer* renderer)
+// Fills and optionally writes the lightmap of each object, returns a checksum of all of them.
+static uint64_t output_lightmaps(Allocator* ta, const World& world, const DynamicArray<Patch>& patches,
+    const PatchList* patches_by_objects, unsigned lightmap_size, WriteLightmaps write_lightmaps)
 {
+    TRACE_SCOPE("output_lightmaps");
+    uint64_t checksum = 14695981039346656037ull;
+    Image lightmap = {};
+    lightmap.width = lightmap_size;
+    lightmap.height = lightmap_size;
+    lightmap.pixel_format = PixelFormat::R8G8B8A8_UINT_NORM;
+    image_init_data(&lightmap, ta);
+    size_t lightmap_bytes = image_size(lightmap);
+    for (size_t obj_index = 0; obj_index < world.objects.num; ++obj_index)
+    {
+        // Occluders have no lightmap, see Object::occluder_geometry_handle.
+        if (IsValidRRHandle(world.objects[obj_index].occluder_geometry_handle))
+            continue;
+
+        memset(lightmap.data, 0, lightmap_bytes);
+        const PatchList& pbo = patches_by_objects[obj_index];
+
+        for (size_t pi = 0; pi < pbo.num; ++pi)
+        {
+            const Patch& p = patches[pbo[pi]];
+            ColorUNorm& out_color = ((ColorUNorm*)lightmap.data)[p.uv_index];
+            out_color.r = (unsigned char)(min(p.incident.r, 1.0f) * 255);
+            out_color.g = (unsigned char)(min(p.incident.g, 1.0f) * 255);
+            out_color.b = (unsigned char)(min(p.incident.b, 1.0f) * 255);
+            out_color.a = 255;
+        }
+
+        checksum = hash_bytes(checksum, lightmap.data, lightmap_bytes);
+
+        if (write_lightmaps == WriteLightmaps::Write)
+        {
+            char filename[16];
+            sprintf(filename, "%u.data", world.objects[obj_index].id);
+            file_write(lightmap.data, lightmap_bytes, filename);
+        }
+    }
+
+    return checksum;
+}
+
+void run_radiosity_mapper(World& world, Renderer* renderer, unsigned lightmap_size, WriteLightmaps write_lightmaps, RadiosityMapperStats* stats,
+    PvsCulling pvs_culling)
+{
+    TRACE_SCOPE("run_radiosity_mapper");
+    Assert(lightmap_size <= WindowWidth && lightmap_size <= WindowHeight, "Lightmaps can't be larger than the window.");
+    RadiosityMapperStats s = {};
+    const Rect scissor_full = {0, 0, lightmap_size, lightmap_size};
+    const Rect scissor_top = {0, 0, lightmap_size, lightmap_size/2};
+    const Rect scissor_bottom = {0, lightmap_size/2, lightmap_size, lightmap_size};
+    const Rect scissor_left = {0, 0, lightmap_size/2, lightmap_size};
+    const Rect scissor_right = {lightmap_size/2, 0, lightmap_size, lightmap_size};
+
     RRHandle vertex_data_shader = renderer->load_shader("uv_data.shader");
     RRHandle light_contribution_shader = renderer->load_shader("light_contribution_calc.shader");
-    RenderTarget vertex_texture = renderer->create_render_texture(PixelFormat::R32G32B32A32_FLOAT, LightmapSize, LightmapSize);
-    RenderTarget normals_texture = renderer->create_render_texture(PixelFormat::R32G32B32A32_FLOAT, LightmapSize, LightmapSize);
+    RenderTarget vertex_texture = renderer->create_render_texture(PixelFormat::R32G32B32A32_FLOAT, lightmap_size, lightmap_size);
+    RenderTarget normals_texture = renderer->create_render_texture(PixelFormat::R32G32B32A32_FLOAT, lightmap_size, lightmap_size);
     RenderTarget* vertex_data_rts[] = {&vertex_texture, &normals_texture};
-    RenderTarget light_contrib_texture = renderer->create_render_texture(PixelFormat::R32_UINT, LightmapSize, LightmapSize);
+    RenderTarget light_contrib_texture = renderer->create_render_texture(PixelFormat::R32_UINT, lightmap_size, lightmap_size);
     
     Allocator ta = create_temp_allocator();
     Image light_contrib_image = image_from_render_target(light_contrib_texture);
     image_init_data(&light_contrib_image, &ta);
 
-    unsigned num_pixels = LightmapSize * LightmapSize;
+    unsigned num_pixels = lightmap_size * lightmap_size;
     DynamicArray<Patch> patches = dynamic_array_create<Patch>(&ta);
-    unsigned pbo_size = sizeof(DynamicArray<unsigned>) * world.objects.num;
-    DynamicArray<unsigned>* patches_by_objects = (DynamicArray<unsigned>*)ta.alloc(pbo_size);
+    size_t pbo_size = sizeof(PatchList) * world.objects.num;
+    PatchList* patches_by_objects = (PatchList*)ta.alloc(pbo_size);
     memset(patches_by_objects, 0, pbo_size);
-    unsigned patch_offsets_size = num_pixels * sizeof(unsigned);
+    size_t patch_offsets_size = num_pixels * sizeof(unsigned);
     unsigned* patch_offsets = (unsigned*)ta.alloc(patch_offsets_size);
+    DynamicArray<Vector3> patch_positions = dynamic_array_create<Vector3>(&ta);
+    DynamicArray<Vector3> patch_normals = dynamic_array_create<Vector3>(&ta);
+    DynamicArray<unsigned> patch_objects = dynamic_array_create<unsigned>(&ta);
     
-    for (unsigned i = 0; i < world.objects.num; ++i)
+    for (size_t i = 0; i < world.objects.num; ++i)
     {
+        TRACE_SCOPE("object_patch_setup");
         Object& obj = world.objects[i];
+
+        if (IsValidRRHandle(obj.occluder_geometry_handle))
+            continue;
+
+        Clock::time_point uv_raster_start = Clock::now();
         renderer->disable_scissor();
         renderer->set_render_targets(vertex_data_rts, 2);
         renderer->set_shader(vertex_data_shader);
@@ -89,6 +190,8 @@ void run_radiosity_mapper(World& world, Renderer* renderer)
         Vector4* positions = (Vector4*)vertex_image.data;
         MappedTexture normals_image = renderer->map_texture(normals_texture);
         Vector4* normals = (Vector4*)normals_image.data;
+        s.uv_raster_ms += elapsed_ms(uv_raster_start);
+        Clock::time_point patch_setup_start = Clock::now();
 
         Patch base_patch = {};
         if (obj.is_light)
@@ -98,58 +201,79 @@ void run_radiosity_mapper(World& world, Renderer* renderer)
         }
 
         memset(patch_offsets, 0, patch_offsets_size);
+        unsigned num_covered_pixels = 0;
 
         for (unsigned pixel_index = 0; pixel_index < num_pixels; ++pixel_index)
         {
             const Vector3& n = *(Vector3*)&normals[pixel_index];
 
             if (n.x != 0.0f || n.y != 0.0f || n.z != 0.0f)
-            {
-                const Vector3& pos = *(Vector3*)&positions[pixel_index];
-
-                Camera base_cam = camera_create_projection();
-                base_cam.position = {pos.x, pos.y, pos.z};
-
-                Patch p = base_patch;
-                p.front = base_cam;
-                p.front.rotation = quaternion_look_at(vector3_zero, n);
-                Vector3 bitangent = vector3_bitangent(n);
-                Vector3 tangent = vector3_tangent(n);
-
-                p.right = base_cam;
-                p.right.rotation = quaternion_normalize(quaternion_from_axis_angle(bitangent, PI/2) * p.front.rotation);
+                ++num_covered_pixels;
+        }
 
-                p.left = base_cam;
-                p.left.rotation = quaternion_normalize(quaternion_from_axis_angle(bitangent, -PI/2) * p.front.rotation);
+        reserve_geometric(&patches, patches.num + num_covered_pixels);
+        reserve_geometric(&patch_positions, patches.num + num_covered_pixels);
+        reserve_geometric(&patch_normals, patches.num + num_covered_pixels);
+        reserve_geometric(&patch_objects, patches.num + num_covered_pixels);
+        PatchList& pbo = patches_by_objects[i];
+        pbo.allocator = &ta;
+        pbo.reserve(num_covered_pixels);
 
-                p.up = base_cam;
-                p.up.rotation = quaternion_normalize(quaternion_from_axis_angle(tangent, PI/2) * p.front.rotation);
+        for (unsigned pixel_index = 0; pixel_index < num_pixels; ++pixel_index)
+        {
+            const Vector3& n = *(Vector3*)&normals[pixel_index];
 
-                p.down = base_cam;
-                p.down.rotation = quaternion_normalize(quaternion_from_axis_angle(tangent, -PI/2) * p.front.rotation);
+            if (n.x != 0.0f || n.y != 0.0f || n.z != 0.0f)
+            {
+                const Vector3& pos = *(Vector3*)&positions[pixel_index];
 
+                Patch p = base_patch;
+                p.hemicube = camera_create_hemicube(pos, n);
                 p.reflectance = 0.5f;
                 p.uv_index = pixel_index;
-                patch_offsets[pixel_index] = patches.num;
-                patches.add(p);
-
-                DynamicArray<unsigned>& pbo = patches_by_objects[i];
 
-                if (pbo.allocator == nullptr)
-                    pbo.allocator = &ta;
-
-                pbo.add(patches.num - 1);
+                // Offsets are stored plus one, so that texels no patch covers and the cleared hemicube read as no
+                // patch instead of as the first one.
+                patch_offsets[pixel_index] = (unsigned)patches.num + 1;
+                patches.add(p);
+                pbo.add((unsigned)(patches.num - 1));
+                patch_positions.add(pos);
+                patch_normals.add(n);
+                patch_objects.add((unsigned)i);
             }
         }
 
         renderer->unmap_texture(vertex_image);
         renderer->unmap_texture(normals_image);
 
-        RRHandle tex_handle = renderer->load_texture(patch_offsets, PixelFormat::R32_UINT, LightmapSize, LightmapSize);
+        RRHandle tex_handle = renderer->load_texture(patch_offsets, PixelFormat::R32_UINT, lightmap_size, lightmap_size);
         Assert(IsValidRRHandle(tex_handle), "Failed uploading offsets texture to GPU in lightmapper.");
         obj.lightmap_patch_offset = tex_handle;
+        s.patch_setup_ms += elapsed_ms(patch_setup_start);
     }
 
+    s.num_patches = patches.num;
+
+    Clock::time_point pvs_start = Clock::now();
+    Aabb* object_bounds = (Aabb*)ta.alloc(world.objects.num * sizeof(Aabb));
+
+    for (size_t i = 0; i < world.objects.num; ++i)
+        object_bounds[i] = world.objects[i].world_bounds;
+
+    PatchPvs pvs = patch_pvs_create(&ta, patch_positions.data, patch_normals.data, patch_objects.data, patches.num,
+        object_bounds, world.objects.num, PvsClusterSize);
+    s.num_pvs_clusters = pvs.clusters.num;
+
+    for (size_t i = 0; i < patches.num; ++i)
+        s.mean_pvs_objects += patch_pvs_cluster(pvs, i).num_visible;
+
+    s.mean_pvs_objects = patches.num > 0 ? s.mean_pvs_objects / (double)patches.num : 0.0;
+    s.pvs_ms = elapsed_ms(pvs_start);
+    unsigned* all_objects = (unsigned*)ta.alloc(world.objects.num * sizeof(unsigned));
+
+    for (size_t i = 0; i < world.objects.num; ++i)
+        all_objects[i] = (unsigned)i;
+
     /*unsigned lms = LightmapSize;
     float* distortion_texture = create_distortion_texture(&ta, lms*2);
     float* dist_front = (float*)ta.alloc(sizeof(float)*lms);
@@ -162,62 +286,62 @@ void run_radiosity_mapper(World& world, Renderer* renderer)
     float* dist_left = (float*)ta.alloc(sizeof(float)*lms);
     float* dist_right = (float*)ta.alloc(sizeof(float)*lms);*/
 
+    Clock::time_point gather_start = Clock::now();
     renderer->set_shader(light_contribution_shader);
     renderer->set_render_target(&light_contrib_texture);
 
-    for (unsigned pass = 0; pass < 1; ++pass)
+    for (unsigned pass = 0; pass < 1 && !s.aborted; ++pass)
     {
-        for (unsigned patch_index = 0; patch_index < patches.num; ++patch_index)
+        TRACE_SCOPE("gather_pass");
+
+        for (size_t patch_index = 0; patch_index < patches.num; ++patch_index)
         {
             Patch& p = patches[patch_index];
             process_all_window_messsages();
 
             if (key_is_presssed(Key::Escape))
             {
-                return;
+                s.aborted = true;
+                break;
             }
 
+            const PvsCluster& c = patch_pvs_cluster(pvs, patch_index);
+            bool cull = pvs_culling == PvsCulling::Cull;
+            const unsigned* objects = cull ? pvs.visible_objects.data + c.first_visible : all_objects;
+            size_t num_objects = cull ? c.num_visible : world.objects.num;
             ColorRGB incident = {};
-            incident += draw_hemicube_side(renderer, world, scissor_full, p.front, light_contrib_texture, patches.data);
-            incident += draw_hemicube_side(renderer, world, scissor_left, p.right, light_contrib_texture, patches.data);
-            incident += draw_hemicube_side(renderer, world, scissor_right, p.left, light_contrib_texture, patches.data);
-            incident += draw_hemicube_side(renderer, world, scissor_bottom, p.up, light_contrib_texture, patches.data);
-            incident += draw_hemicube_side(renderer, world, scissor_top, p.down, light_contrib_texture, patches.data);
+            incident += draw_hemicube_side(renderer, world, objects, num_objects, scissor_full, p.hemicube.front, light_contrib_texture, patches.data);
+            incident += draw_hemicube_side(renderer, world, objects, num_objects, scissor_left, p.hemicube.right, light_contrib_texture, patches.data);
+            incident += draw_hemicube_side(renderer, world, objects, num_objects, scissor_right, p.hemicube.left, light_contrib_texture, patches.data);
+            incident += draw_hemicube_side(renderer, world, objects, num_objects, scissor_bottom, p.hemicube.up, light_contrib_texture, patches.data);
+            incident += draw_hemicube_side(renderer, world, objects, num_objects, scissor_top, p.hemicube.down, light_contrib_texture, patches.data);
             p.incident.r = min(incident.r, 1);
             p.incident.g = min(incident.g, 1);
             p.incident.b = min(incident.b, 1);
         }
 
-        for (unsigned patch_index = 0; patch_index < patches.num; ++patch_index)
+        for (size_t patch_index = 0; patch_index < patches.num; ++patch_index)
         {
             Patch& p = patches[patch_index];
             p.excident = p.incident * p.reflectance + p.emission;
         }
     }
 
-    Image lightmap = {};
-    lightmap.width = LightmapSize;
-    lightmap.height = LightmapSize;
-    lightmap.pixel_format = PixelFormat::R8G8B8A8_UINT_NORM;
-    image_init_data(&lightmap, &ta);
-    unsigned lightmap_size = image_size(lightmap);
-    for (unsigned obj_index = 0; obj_index < world.objects.num; ++obj_index)
+    s.gather_ms = elapsed_ms(gather_start);
+
+    if (!s.aborted)
     {
-        memset(lightmap.data, 0, lightmap_size);
-        DynamicArray<unsigned>& pbo = patches_by_objects[obj_index];
+        Clock::time_point output_start = Clock::now();
+        s.lightmap_checksum = output_lightmaps(&ta, world, patches, patches_by_objects, lightmap_size, write_lightmaps);
+        s.output_ms = elapsed_ms(output_start);
+    }
 
-        for (unsigned pi = 0; pi < pbo.num; ++pi)
-        {
-            const Patch& p = patches[pbo[pi]];
-            ColorUNorm& out_color = ((ColorUNorm*)lightmap.data)[p.uv_index];
-            out_color.r = ((unsigned char)min(p.incident.r, 1.0f)) * 255;
-            out_color.g = ((unsigned char)min(p.incident.g, 1.0f)) * 255;
-            out_color.b = ((unsigned char)min(p.incident.b, 1.0f)) * 255;
-            out_color.a = 255;
-        }
+    renderer->unload_resource(light_contrib_texture.render_resource);
+    renderer->unload_resource(normals_texture.render_resource);
+    renderer->unload_resource(vertex_texture.render_resource);
+    renderer->unload_resource(light_contribution_shader);
+    renderer->unload_resource(vertex_data_shader);
 
-        char filename[10];
-        sprintf(filename, "%d.data", world.objects[obj_index].id);
-        file_write(lightmap.data, lightmap_size, filename);
-    }
+    if (stats != nullptr)
+        *stats = s;
 }
@@ -1,7 +1,50 @@
 #pragma once
+#include <stdint.h>
+#include "lightmap_uv.h"
 
 struct World;
 struct Renderer;
 struct Allocator;
 
-void run_radiosity_mapper(World& world, Renderer* renderer);
+enum struct WriteLightmaps { Write, DoNotWrite };
+
+// DrawAll draws every object into every hemicube side, for checking that culling with the potentially visible sets
+// doesn't change the lightmaps.
+enum struct PvsCulling { Cull, DrawAll };
+
+// Wall clock time spent in each phase of run_radiosity_mapper. The lightmaps are checksummed whether or not they
+// are written, so that a change to the mapper can be checked for changing its output.
+struct RadiosityMapperStats
+{
+    // Rendering the positions and normals of each object into its lightmap.
+    double uv_raster_ms;
+
+    // Making a patch with hemicube cameras for every covered lightmap texel.
+    double patch_setup_ms;
+
+    // Clustering the patches and finding the objects each cluster could see, see patch_pvs.h.
+    double pvs_ms;
+
+    // Rendering the hemicube of every patch and summing the light it sees.
+    double gather_ms;
+
+    // Filling the lightmaps from the patches and writing them.
+    double output_ms;
+
+    size_t num_patches;
+    size_t num_pvs_clusters;
+
+    // Objects in the potentially visible set of the average patch, each of its hemicube sides draws at most these.
+    double mean_pvs_objects;
+
+    uint64_t lightmap_checksum;
+
+    // Set if escape was pressed during the gather, the other fields are then incomplete.
+    bool aborted;
+};
+
+// Lightmaps are written to <object id>.data, which is what create_test_world loads. lightmap_size can be at most
+// the window size, the hemicubes are rendered with the window's depth buffer.
+void run_radiosity_mapper(World& world, Renderer* renderer, unsigned lightmap_size = LightmapSize,
+    WriteLightmaps write_lightmaps = WriteLightmaps::Write, RadiosityMapperStats* stats = nullptr,
+    PvsCulling pvs_culling = PvsCulling::Cull);
@@ -0,0 +1,203 @@
+#include "render_commands.h"
+#include "handle_table.h"
+#include "memory.h"
+
+static const uint64_t SortKeyHandleMask = (1ull << RenderSortKeyHandleBits) - 1;
+static const uint64_t SortKeyCommandMask = (1ull << RenderSortKeyCommandBits) - 1;
+
+static uint64_t sort_key_handle(RRHandle h)
+{
+    return (h.h & HandleIndexMask) & SortKeyHandleMask;
+}
+
+static uint64_t sort_key(const DrawCommand& c, size_t command_index)
+{
+    return (sort_key_handle(c.shader) << (RenderSortKeyCommandBits + 2 * RenderSortKeyHandleBits))
+        | (sort_key_handle(c.texture) << (RenderSortKeyCommandBits + RenderSortKeyHandleBits))
+        | (sort_key_handle(c.geometry) << RenderSortKeyCommandBits)
+        | (uint64_t)command_index;
+}
+
+RenderCommandBuffer render_commands_create(Allocator* alloc, const Matrix4x4& view_matrix, const Matrix4x4& projection_matrix)
+{
+    RenderCommandBuffer cb = {};
+    cb.keys = dynamic_array_create<uint64_t>(alloc);
+    cb.commands = dynamic_array_create<DrawCommand>(alloc);
+    cb.view_matrix = view_matrix;
+    cb.projection_matrix = projection_matrix;
+    return cb;
+}
+
+void render_commands_destroy(RenderCommandBuffer* cb)
+{
+    dynamic_array_destroy(&cb->keys);
+    dynamic_array_destroy(&cb->commands);
+}
+
+void render_commands_clear(RenderCommandBuffer* cb)
+{
+    cb->keys.num = 0;
+    cb->commands.num = 0;
+}
+
+void render_commands_add(RenderCommandBuffer* cb, const DrawCommand& command)
+{
+    Assert(cb->commands.num < SortKeyCommandMask, "Too many commands for the sort key.");
+    cb->keys.add(sort_key(command, cb->commands.num));
+    cb->commands.add(command);
+}
+
+void render_commands_merge(RenderCommandBuffer* out, const RenderCommandBuffer* buffers, unsigned num_buffers)
+{
+    size_t total = out->commands.num;
+
+    for (unsigned i = 0; i < num_buffers; ++i)
+        total += buffers[i].commands.num;
+
+    Assert(total <= SortKeyCommandMask, "Too many commands for the sort key.");
+    out->keys.reserve(total);
+    out->commands.reserve(total);
+
+    for (unsigned i = 0; i < num_buffers; ++i)
+    {
+        const RenderCommandBuffer& b = buffers[i];
+        uint64_t base = out->commands.num;
+
+        // Keys of a buffer that was already sorted are out of order, but still point at their own commands.
+        for (size_t k = 0; k < b.keys.num; ++k)
+            out->keys.add((b.keys[k] & ~SortKeyCommandMask) | (base + (b.keys[k] & SortKeyCommandMask)));
+
+        memcpy(out->commands.data + out->commands.num, b.commands.data, b.commands.num * sizeof(DrawCommand));
+        out->commands.num += b.commands.num;
+    }
+}
+
+// Least significant digit first radix sort, a byte at a time. Passes where every key has the same byte are
+// skipped, which with few distinct handles is most of them.
+static void sort_keys(uint64_t* keys, size_t num)
+{
+    Allocator ta = create_temp_allocator();
+    uint64_t* scratch = (uint64_t*)ta.alloc(num * sizeof(uint64_t));
+    uint64_t* src = keys;
+    uint64_t* dst = scratch;
+
+    for (unsigned shift = 0; shift < 64; shift += 8)
+    {
+        size_t counts[256] = {};
+
+        for (size_t i = 0; i < num; ++i)
+            ++counts[(src[i] >> shift) & 0xff];
+
+        if (counts[(src[0] >> shift) & 0xff] == num)
+            continue;
+
+        size_t offset = 0;
+
+        for (unsigned d = 0; d < 256; ++d)
+        {
+            size_t c = counts[d];
+            counts[d] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < num; ++i)
+            dst[counts[(src[i] >> shift) & 0xff]++] = src[i];
+
+        uint64_t* t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if (src != keys)
+        memcpy(keys, src, num * sizeof(uint64_t));
+}
+
+RenderSubmitStats render_commands_submit(RenderCommandBuffer* cb, const RenderBackend& backend)
+{
+    RenderSubmitStats stats = {};
+    backend.begin(backend.context, cb->view_matrix, cb->projection_matrix);
+
+    if (cb->keys.num == 0)
+        return stats;
+
+    sort_keys(cb->keys.data, cb->keys.num);
+    const DrawCommand* prev = nullptr;
+
+    for (size_t i = 0; i < cb->keys.num; ++i)
+    {
+        const DrawCommand& c = cb->commands[(size_t)(cb->keys[i] & SortKeyCommandMask)];
+        bool shader_changed = prev == nullptr || c.shader.h != prev->shader.h;
+
+        if (shader_changed)
+        {
+            backend.set_shader(backend.context, c.shader);
+            ++stats.num_shader_changes;
+        }
+
+        if (prev == nullptr || c.texture.h != prev->texture.h)
+        {
+            backend.set_texture(backend.context, c.texture);
+            ++stats.num_texture_changes;
+        }
+
+        if (shader_changed || c.geometry.h != prev->geometry.h)
+        {
+            backend.set_geometry(backend.context, c.geometry);
+            ++stats.num_geometry_changes;
+        }
+
+        backend.draw(backend.context, c);
+        ++stats.num_draws;
+        prev = &c;
+    }
+
+    return stats;
+}
+
+static void null_begin(void*, const Matrix4x4&, const Matrix4x4&)
+{
+}
+
+static void null_set_shader(void* context, RRHandle)
+{
+    ++((NullRenderBackend*)context)->calls.num_shader_changes;
+}
+
+static void null_set_texture(void* context, RRHandle)
+{
+    ++((NullRenderBackend*)context)->calls.num_texture_changes;
+}
+
+static void null_set_geometry(void* context, RRHandle)
+{
+    ++((NullRenderBackend*)context)->calls.num_geometry_changes;
+}
+
+static void null_draw(void* context, const DrawCommand& command)
+{
+    NullRenderBackend* nb = (NullRenderBackend*)context;
+    ++nb->calls.num_draws;
+
+    // FNV-1a.
+    const unsigned char* bytes = (const unsigned char*)&command;
+
+    for (size_t i = 0; i < sizeof(DrawCommand); ++i)
+    {
+        nb->draw_hash ^= bytes[i];
+        nb->draw_hash *= 1099511628211ull;
+    }
+}
+
+RenderBackend render_null_backend(NullRenderBackend* nb)
+{
+    memset(nb, 0, sizeof(NullRenderBackend));
+    nb->draw_hash = 14695981039346656037ull;
+    RenderBackend b = {};
+    b.context = nb;
+    b.begin = null_begin;
+    b.set_shader = null_set_shader;
+    b.set_texture = null_set_texture;
+    b.set_geometry = null_set_geometry;
+    b.draw = null_draw;
+    return b;
+}
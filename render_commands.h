@@ -0,0 +1,77 @@
+#pragma once
+#include <stdint.h>
+#include "math.h"
+#include "render_resource.h"
+#include "dynamic_array.h"
+
+struct Allocator;
+
+// A recorded draw, the payload that a sort key refers to.
+struct DrawCommand
+{
+    RRHandle shader;
+    RRHandle texture;
+    RRHandle geometry;
+    Matrix4x4 world_transform;
+};
+
+// Draws are recorded as a sort key and a payload instead of being drawn right away. The key orders draws by
+// shader, then texture, then geometry, and last by the order they were recorded in, so submitting the sorted
+// buffer only has to change each kind of state when it actually differs from the previous draw. Every draw in a
+// buffer uses the same view and projection.
+//
+// Several threads can record at the same time into buffers of their own, which are then merged into one buffer
+// before it is submitted.
+struct RenderCommandBuffer
+{
+    DynamicArray<uint64_t> keys;
+    DynamicArray<DrawCommand> commands;
+    Matrix4x4 view_matrix;
+    Matrix4x4 projection_matrix;
+};
+
+// Sort keys hold this many bits of the slot index of each handle, handles past that still sort into groups,
+// just not perfectly. The rest of the key is the index of the command.
+const unsigned RenderSortKeyHandleBits = 12;
+const unsigned RenderSortKeyCommandBits = 64 - 3 * RenderSortKeyHandleBits;
+
+// What submitting a buffer draws with. context is passed to every function. set_geometry is called again after
+// every shader change, since a backend may pick the vertex layout from both.
+struct RenderBackend
+{
+    void* context;
+    void(*begin)(void* context, const Matrix4x4& view_matrix, const Matrix4x4& projection_matrix);
+    void(*set_shader)(void* context, RRHandle shader);
+    void(*set_texture)(void* context, RRHandle texture);
+    void(*set_geometry)(void* context, RRHandle geometry);
+    void(*draw)(void* context, const DrawCommand& command);
+};
+
+struct RenderSubmitStats
+{
+    unsigned num_draws;
+    unsigned num_shader_changes;
+    unsigned num_texture_changes;
+    unsigned num_geometry_changes;
+};
+
+RenderCommandBuffer render_commands_create(Allocator* alloc, const Matrix4x4& view_matrix, const Matrix4x4& projection_matrix);
+void render_commands_destroy(RenderCommandBuffer* cb);
+void render_commands_clear(RenderCommandBuffer* cb);
+void render_commands_add(RenderCommandBuffer* cb, const DrawCommand& command);
+
+// Appends the commands of buffers, in order, to out. The order of each buffer's own draws is kept.
+void render_commands_merge(RenderCommandBuffer* out, const RenderCommandBuffer* buffers, unsigned num_buffers);
+
+// Sorts the buffer and draws it through backend. The buffer is left sorted.
+RenderSubmitStats render_commands_submit(RenderCommandBuffer* cb, const RenderBackend& backend);
+
+// Backend that draws nothing and only counts what it is asked to do, and hashes the draws in the order they
+// arrive. For testing and for measuring recording without a GPU.
+struct NullRenderBackend
+{
+    RenderSubmitStats calls;
+    uint64_t draw_hash;
+};
+
+RenderBackend render_null_backend(NullRenderBackend* nb);
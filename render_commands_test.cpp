@@ -0,0 +1,175 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <thread>
+#include "helpers.h"
+#include "memory.cpp"
+#include "render_commands.cpp"
+
+static DrawCommand make_command(unsigned shader, unsigned texture, unsigned geometry, float x)
+{
+    DrawCommand c = {};
+    c.shader = {shader};
+    c.texture = {texture};
+    c.geometry = {geometry};
+    c.world_transform = matrix4x4_identity();
+    c.world_transform.w.x = x;
+    return c;
+}
+
+// Records the draws that reach the backend, to check their order.
+struct RecordingBackend
+{
+    DrawCommand draws[64];
+    unsigned num_draws;
+};
+
+static void recording_begin(void*, const Matrix4x4&, const Matrix4x4&)
+{
+}
+
+static void recording_set_state(void*, RRHandle)
+{
+}
+
+static void recording_draw(void* context, const DrawCommand& command)
+{
+    RecordingBackend* rb = (RecordingBackend*)context;
+    assert(rb->num_draws < 64);
+    rb->draws[rb->num_draws++] = command;
+}
+
+int main()
+{
+    unsigned temp_memory_size = 1024 * 1024 * 100;
+    void* temp_memory_block = malloc(temp_memory_size);
+    temp_memory_blob_init(temp_memory_block, temp_memory_size);
+    Matrix4x4 identity = matrix4x4_identity();
+
+    {
+        // Draws come out grouped by shader, then texture, then geometry, otherwise in recorded order.
+        Allocator ta = create_temp_allocator();
+        RenderCommandBuffer cb = render_commands_create(&ta, identity, identity);
+        render_commands_add(&cb, make_command(2, 5, 7, 0));
+        render_commands_add(&cb, make_command(1, 5, 7, 1));
+        render_commands_add(&cb, make_command(2, 4, 7, 2));
+        render_commands_add(&cb, make_command(1, 5, 6, 3));
+        render_commands_add(&cb, make_command(2, 5, 7, 4));
+        render_commands_add(&cb, make_command(1, 5, 7, 5));
+
+        RecordingBackend rb = {};
+        RenderBackend b = {&rb, recording_begin, recording_set_state, recording_set_state, recording_set_state, recording_draw};
+        RenderSubmitStats s = render_commands_submit(&cb, b);
+        assert(s.num_draws == 6 && rb.num_draws == 6);
+        const float expected_order[] = {3, 1, 5, 2, 0, 4};
+
+        for (unsigned i = 0; i < 6; ++i)
+            assert(rb.draws[i].world_transform.w.x == expected_order[i]);
+
+        assert(s.num_shader_changes == 2);
+        assert(s.num_texture_changes == 3);
+        assert(s.num_geometry_changes == 3);
+    }
+
+    {
+        // Redundant state is only set once.
+        Allocator ta = create_temp_allocator();
+        RenderCommandBuffer cb = render_commands_create(&ta, identity, identity);
+
+        for (unsigned i = 0; i < 1000; ++i)
+            render_commands_add(&cb, make_command(1 + i % 2, 10 + i % 3, 20 + i % 5, (float)i));
+
+        NullRenderBackend nb;
+        RenderBackend b = render_null_backend(&nb);
+        RenderSubmitStats s = render_commands_submit(&cb, b);
+        assert(s.num_draws == 1000 && nb.calls.num_draws == 1000);
+        assert(s.num_shader_changes == 2 && nb.calls.num_shader_changes == 2);
+        assert(s.num_texture_changes == 6 && nb.calls.num_texture_changes == 6);
+        assert(s.num_geometry_changes == 30 && nb.calls.num_geometry_changes == 30);
+
+        // Keys are left sorted.
+        for (size_t i = 1; i < cb.keys.num; ++i)
+            assert(cb.keys[i - 1] < cb.keys[i]);
+    }
+
+    {
+        // Buffers recorded on several threads and merged draw the same as one buffer recorded in the same order.
+        const unsigned num_threads = 4;
+        const unsigned draws_per_thread = 5000;
+        Allocator ha = create_heap_allocator();
+        RenderCommandBuffer single = render_commands_create(&ha, identity, identity);
+
+        for (unsigned t = 0; t < num_threads; ++t)
+        {
+            for (unsigned i = 0; i < draws_per_thread; ++i)
+                render_commands_add(&single, make_command(1 + (i * 7 + t) % 3, 1 + (i * 13) % 17, 1 + (i * 31 + t) % 101, (float)(t * draws_per_thread + i)));
+        }
+
+        // The heap behind the allocators can be used from any thread, but an Allocator's allocation count and
+        // tracer aren't atomic, so each thread records through an Allocator of its own.
+        Allocator thread_allocators[num_threads];
+        RenderCommandBuffer per_thread[num_threads];
+        std::thread threads[num_threads];
+
+        for (unsigned t = 0; t < num_threads; ++t)
+        {
+            thread_allocators[t] = create_heap_allocator();
+            per_thread[t] = render_commands_create(&thread_allocators[t], identity, identity);
+        }
+
+        for (unsigned t = 0; t < num_threads; ++t)
+        {
+            threads[t] = std::thread([&per_thread, t]() {
+                for (unsigned i = 0; i < draws_per_thread; ++i)
+                    render_commands_add(&per_thread[t], make_command(1 + (i * 7 + t) % 3, 1 + (i * 13) % 17, 1 + (i * 31 + t) % 101, (float)(t * draws_per_thread + i)));
+            });
+        }
+
+        for (unsigned t = 0; t < num_threads; ++t)
+            threads[t].join();
+
+        RenderCommandBuffer merged = render_commands_create(&ha, identity, identity);
+        render_commands_merge(&merged, per_thread, num_threads);
+        assert(merged.commands.num == single.commands.num);
+
+        NullRenderBackend single_nb;
+        RenderSubmitStats single_stats = render_commands_submit(&single, render_null_backend(&single_nb));
+        NullRenderBackend merged_nb;
+        RenderSubmitStats merged_stats = render_commands_submit(&merged, render_null_backend(&merged_nb));
+        assert(single_nb.draw_hash == merged_nb.draw_hash);
+        assert(memcmp(&single_stats, &merged_stats, sizeof(RenderSubmitStats)) == 0);
+        assert(merged_stats.num_draws == num_threads * draws_per_thread);
+        assert(merged_stats.num_shader_changes == 3);
+        assert(merged_stats.num_texture_changes == 3 * 17);
+
+        for (unsigned t = 0; t < num_threads; ++t)
+        {
+            render_commands_destroy(&per_thread[t]);
+            heap_allocator_check_clean(&thread_allocators[t]);
+        }
+
+        render_commands_destroy(&merged);
+        render_commands_destroy(&single);
+        heap_allocator_check_clean(&ha);
+    }
+
+    {
+        // Merging buffers that were already submitted, and so sorted, still keeps each key with its command.
+        Allocator ta = create_temp_allocator();
+        RenderCommandBuffer a = render_commands_create(&ta, identity, identity);
+        render_commands_add(&a, make_command(2, 1, 1, 0));
+        render_commands_add(&a, make_command(1, 1, 1, 1));
+        NullRenderBackend nb;
+        render_commands_submit(&a, render_null_backend(&nb));
+        RenderCommandBuffer merged = render_commands_create(&ta, identity, identity);
+        render_commands_add(&merged, make_command(3, 1, 1, 2));
+        render_commands_merge(&merged, &a, 1);
+
+        RecordingBackend rb = {};
+        RenderBackend b = {&rb, recording_begin, recording_set_state, recording_set_state, recording_set_state, recording_draw};
+        render_commands_submit(&merged, b);
+        assert(rb.num_draws == 3);
+        assert(rb.draws[0].shader.h == 1 && rb.draws[0].world_transform.w.x == 1);
+        assert(rb.draws[1].shader.h == 2 && rb.draws[1].world_transform.w.x == 0);
+        assert(rb.draws[2].shader.h == 3 && rb.draws[2].world_transform.w.x == 2);
+    }
+}
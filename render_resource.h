@@ -2,6 +2,13 @@
 #include "image.h"
 #include "color.h"
 
+enum struct IndexFormat
+{
+    UInt16,
+    UInt32
+};
+
+// A handle from the renderer's HandleTable, see handle_table.h.
 struct RRHandle
 {
     unsigned h;
@@ -8,6 +8,10 @@
 #include "file.h"
 #include "camera.h"
 #include "memory.h"
+#include "mesh.h"
+#include "render_commands.h"
+#include "frustum.h"
+#include "trace.h"
 
 struct RenderTargetResource
 {
@@ -20,12 +24,20 @@ struct ConstantBuffer
     Matrix4x4 model_view_projection;
     Matrix4x4 model;
     Matrix4x4 projection;
+    Vector4 position_offset;
+    Vector4 position_scale;
+    Matrix4x4 normal_model;
 };
 
 struct Geometry {
     ID3D11Buffer* vertices;
     ID3D11Buffer* indices;
+    IndexFormat index_format;
     unsigned num_indices;
+    unsigned vertex_stride;
+    bool packed;
+    Vector3 position_offset;
+    Vector3 position_scale;
 };
 
 struct Texture
@@ -40,6 +52,8 @@ struct Shader
     ID3D11PixelShader* pixel_shader;
     ID3D11InputLayout* input_layout;
     ID3D11SamplerState* sampler_state;
+    ID3D11VertexShader* packed_vertex_shader;
+    ID3D11InputLayout* packed_input_layout;
 };
 
 enum struct RenderResourceType
@@ -113,6 +127,7 @@ Image image_from_render_target(const RenderTarget& rt)
 void Renderer::init(void* window_handle)
 {
     resources = (RenderResource*)permanent_alloc(max_resources * sizeof(RenderResource));
+    resource_handles = handle_table_create(permanent_alloc(handle_table_memory_size(max_resources)), max_resources);
     DXGI_SWAP_CHAIN_DESC scd = {};
     scd.BufferCount = 1;
     scd.BufferDesc.Width = WindowWidth;
@@ -187,10 +202,12 @@ void Renderer::init(void* window_handle)
 
 void Renderer::shutdown()
 {
-    for (unsigned i = 0; i < max_resources; ++ i)
+    for (unsigned i = 0; i < max_resources; ++i)
     {
-        if (resources[i].type != RenderResourceType::Unused)
-            unload_resource({i});
+        RRHandle handle = {handle_table_handle_at(resource_handles, i)};
+
+        if (IsValidRRHandle(handle))
+            unload_resource(handle);
     }
 
     depth_stencil_texture->Release();
@@ -201,9 +218,8 @@ void Renderer::shutdown()
 
 RRHandle Renderer::load_shader(const char* filename)
 {
-    unsigned handle = find_free_resource_handle();
-
-    if (handle == InvalidHandle)
+    TRACE_SCOPE("load_shader");
+    if (handle_table_full(resource_handles))
         return {InvalidHandle};
 
     ID3DBlob* vs_blob = nullptr;
@@ -258,6 +274,28 @@ RRHandle Renderer::load_shader(const char* filename)
     vs_blob->Release();
     ps_blob->Release();
 
+    // Shaders that can draw packed geometry have a second vertex shader, which decodes PackedVertex.
+    ID3DBlob* packed_vs_blob = nullptr;
+    ID3DBlob* packed_error_blob = nullptr;
+
+    if (D3DCompile(shader_file.file.data, shader_file.file.size, nullptr, nullptr, nullptr, "VShaderPacked", "vs_4_0", 0, 0, &packed_vs_blob, &packed_error_blob) == S_OK)
+    {
+        device->CreateVertexShader(packed_vs_blob->GetBufferPointer(), packed_vs_blob->GetBufferSize(), nullptr, &s.packed_vertex_shader);
+        D3D11_INPUT_ELEMENT_DESC packed_ied[] = {
+            {"POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+            {"NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0},
+            {"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+            {"COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0}
+        };
+
+        device->CreateInputLayout(packed_ied, 4, packed_vs_blob->GetBufferPointer(), packed_vs_blob->GetBufferSize(), &s.packed_input_layout);
+        packed_vs_blob->Release();
+    }
+    else if (packed_error_blob != nullptr)
+    {
+        packed_error_blob->Release();
+    }
+
     D3D11_SAMPLER_DESC sd = CD3D11_SAMPLER_DESC(CD3D11_DEFAULT());
     sd.MaxAnisotropy = 0;
     sd.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
@@ -275,12 +313,12 @@ RRHandle Renderer::load_shader(const char* filename)
     RenderResource r;
     r.type = RenderResourceType::Shader;
     r.shader = s;
-    resources[handle] = r;
-    return {handle};
+    return add_resource(r);
 }
 
 void Renderer::set_shader(RRHandle shader)
 {
+    current_shader = shader;
     Shader& s = get_resource(shader).shader;
     device_context->VSSetShader(s.vertex_shader, 0, 0);
     device_context->PSSetShader(s.pixel_shader, 0, 0);
@@ -294,8 +332,7 @@ void Renderer::set_shader(RRHandle shader)
 
 RenderTarget Renderer::create_back_buffer()
 {
-    unsigned handle = find_free_resource_handle();
-    Assert(handle != InvalidHandle, "Couldn't create back-buffer.");
+    Assert(!handle_table_full(resource_handles), "Couldn't create back-buffer.");
 
     RenderTargetResource rts = {};
     ID3D11Texture2D* back_buffer_texture;
@@ -310,10 +347,9 @@ RenderTarget Renderer::create_back_buffer()
     RenderResource r = {};
     r.type = RenderResourceType::RenderTarget;
     r.render_target = rts;
-    resources[handle] = r;
 
     RenderTarget rt;
-    rt.render_resource = {handle};
+    rt.render_resource = add_resource(r);
     rt.width = td.Width;
     rt.height = td.Height;
     rt.clear = true;
@@ -324,8 +360,7 @@ RenderTarget Renderer::create_back_buffer()
 
 RenderTarget Renderer::create_render_texture(PixelFormat pf, unsigned width, unsigned height)
 {
-    unsigned handle = find_free_resource_handle();
-    Assert(handle != InvalidHandle, "Couldn't create render texture.");
+    Assert(!handle_table_full(resource_handles), "Couldn't create render texture.");
 
     D3D11_TEXTURE2D_DESC rtd = {};
     rtd.Width = width;
@@ -351,10 +386,9 @@ RenderTarget Renderer::create_render_texture(PixelFormat pf, unsigned width, uns
     RenderResource r = {};
     r.type = RenderResourceType::RenderTarget;
     r.render_target = rts;
-    resources[handle] = r;
 
     RenderTarget rt = {};
-    rt.render_resource = {handle};
+    rt.render_resource = add_resource(r);
     rt.pixel_format = pf;
     rt.width = width;
     rt.height = height;
@@ -372,31 +406,21 @@ static void set_constant_buffers(ID3D11DeviceContext* device_context, ID3D11Buff
     device_context->Unmap(constant_buffer, 0);
 }
 
-unsigned Renderer::find_free_resource_handle() const
+RRHandle Renderer::add_resource(const RenderResource& r)
 {
-    for (unsigned i = 1; i < max_resources; ++i)
-    {
-        if (resources[i].type == RenderResourceType::Unused)
-        {
-            return i;
-        }
-    }
-
-    return InvalidHandle;
+    unsigned handle = handle_table_alloc(&resource_handles);
+    Assert(handle != InvalidHandle, "Out of render resource handles.");
+    resources[handle_table_index(resource_handles, handle)] = r;
+    return {handle};
 }
 
-RRHandle Renderer::load_geometry(Vertex* vertices, unsigned num_vertices, unsigned* indices, unsigned num_indices)
+static Geometry create_geometry(ID3D11Device* device, const void* vertices, unsigned vertex_stride, unsigned num_vertices, const void* indices, IndexFormat index_format, unsigned num_indices)
 {
-    unsigned handle = find_free_resource_handle();
-
-    if (handle == InvalidHandle)
-        return {InvalidHandle};
-
     ID3D11Buffer* vertex_buffer;
     {
         D3D11_BUFFER_DESC bd = {};
         bd.Usage = D3D11_USAGE_DYNAMIC;
-        bd.ByteWidth = sizeof(Vertex) * num_vertices;
+        bd.ByteWidth = vertex_stride * num_vertices;
         bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
         bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
         D3D11_SUBRESOURCE_DATA srd = {};
@@ -408,7 +432,7 @@ RRHandle Renderer::load_geometry(Vertex* vertices, unsigned num_vertices, unsign
     {
         D3D11_BUFFER_DESC bd = {};
         bd.Usage = D3D11_USAGE_DYNAMIC;
-        bd.ByteWidth = sizeof(unsigned) * num_indices;
+        bd.ByteWidth = (UINT)((index_format == IndexFormat::UInt16 ? sizeof(unsigned short) : sizeof(unsigned)) * num_indices);
         bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
         bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
         D3D11_SUBRESOURCE_DATA srd = {0};
@@ -419,13 +443,66 @@ RRHandle Renderer::load_geometry(Vertex* vertices, unsigned num_vertices, unsign
     Geometry g = {};
     g.vertices = vertex_buffer;
     g.indices = index_buffer;
+    g.index_format = index_format;
     g.num_indices = num_indices;
+    g.vertex_stride = vertex_stride;
+    g.position_scale = {1, 1, 1};
+    return g;
+}
+
+static unsigned short* to_16_bit_indices(Allocator* alloc, const unsigned* indices, unsigned num_indices)
+{
+    unsigned short* short_indices = (unsigned short*)alloc->alloc(num_indices * sizeof(unsigned short));
+
+    for (unsigned i = 0; i < num_indices; ++i)
+        short_indices[i] = (unsigned short)indices[i];
+
+    return short_indices;
+}
+
+RRHandle Renderer::load_geometry(const Vertex* vertices, unsigned num_vertices, const void* indices, IndexFormat index_format, unsigned num_indices)
+{
+    TRACE_SCOPE("load_geometry");
+    if (handle_table_full(resource_handles))
+        return {InvalidHandle};
+
+    RenderResource r;
+    r.type = RenderResourceType::Geometry;
+    r.geometry = create_geometry(device, vertices, sizeof(Vertex), num_vertices, indices, index_format, num_indices);
+    return add_resource(r);
+}
+
+// Indices are uploaded as 16 bit when all vertices can be addressed with them, which halves the index data.
+RRHandle Renderer::load_geometry(const Vertex* vertices, unsigned num_vertices, const unsigned* indices, unsigned num_indices)
+{
+    if (num_vertices >= 65536)
+        return load_geometry(vertices, num_vertices, indices, IndexFormat::UInt32, num_indices);
+
+    Allocator ta = create_temp_allocator();
+    return load_geometry(vertices, num_vertices, to_16_bit_indices(&ta, indices, num_indices), IndexFormat::UInt16, num_indices);
+}
+
+// Packed geometry is drawn with the VShaderPacked entry point of the current shader.
+RRHandle Renderer::load_geometry(const PackedMesh& m)
+{
+    if (handle_table_full(resource_handles))
+        return {InvalidHandle};
+
+    Allocator ta = create_temp_allocator();
+    IndexFormat index_format = m.vertices.num < 65536 ? IndexFormat::UInt16 : IndexFormat::UInt32;
+    const void* indices = index_format == IndexFormat::UInt16
+        ? (const void*)to_16_bit_indices(&ta, m.indices.data, (unsigned)m.indices.num)
+        : (const void*)m.indices.data;
+
+    Geometry g = create_geometry(device, m.vertices.data, sizeof(PackedVertex), (unsigned)m.vertices.num, indices, index_format, (unsigned)m.indices.num);
+    g.packed = true;
+    g.position_offset = m.position_offset;
+    g.position_scale = m.position_scale;
 
     RenderResource r;
     r.type = RenderResourceType::Geometry;
     r.geometry = g;
-    resources[handle] = r;
-    return {handle};
+    return add_resource(r);
 }
 
 void Renderer::unload_resource(RRHandle handle)
@@ -452,6 +529,12 @@ void Renderer::unload_resource(RRHandle handle)
             res.shader.input_layout->Release();
             res.shader.vertex_shader->Release();
             res.shader.pixel_shader->Release();
+
+            if (res.shader.packed_vertex_shader != nullptr)
+            {
+                res.shader.packed_input_layout->Release();
+                res.shader.packed_vertex_shader->Release();
+            }
             break;
 
         case RenderResourceType::RenderTarget:
@@ -471,6 +554,7 @@ void Renderer::unload_resource(RRHandle handle)
     }
 
     memset(&res, 0, sizeof(RenderResource));
+    handle_table_free(&resource_handles, handle.h);
 }
 
 void Renderer::set_render_target(RenderTarget* rt)
@@ -500,32 +584,132 @@ void Renderer::set_render_targets(RenderTarget** rts, unsigned num)
     device_context->RSSetViewports(1, &viewport);
 }
 
-void Renderer::draw(const Object& object, const Matrix4x4& view_matrix, const Matrix4x4& projection_matrix)
+// Objects that have been given patch offsets by the radiosity mapper draw with those instead of their lightmap.
+static RRHandle object_texture(const Object& object)
 {
-    auto geometry = get_resource(object.geometry_handle).geometry;
-    ConstantBuffer constant_buffer_data = {};
-    constant_buffer_data.model_view_projection = object.world_transform * view_matrix * projection_matrix;
-    constant_buffer_data.model = object.world_transform;
-    constant_buffer_data.projection = projection_matrix;
-    set_constant_buffers(device_context, constant_buffer, constant_buffer_data);
-    device_context->VSSetConstantBuffers(0, 1, &constant_buffer);
-    device_context->PSSetConstantBuffers(0, 1, &constant_buffer);
+    return IsValidRRHandle(object.lightmap_patch_offset) ? object.lightmap_patch_offset : object.lightmap_handle;
+}
 
-    if (IsValidRRHandle(object.lightmap_patch_offset))
+static void bind_texture(Renderer* r, RRHandle texture)
+{
+    ID3D11ShaderResourceView* view = IsValidRRHandle(texture) ? r->get_resource(texture).texture.view : nullptr;
+    r->device_context->PSSetShaderResources(0, 1, &view);
+}
+
+// Packed geometry is drawn with the VShaderPacked entry point, so the vertex shader depends on both.
+static void bind_geometry(ID3D11DeviceContext* device_context, const Shader& shader, const Geometry& geometry)
+{
+    if (geometry.packed)
     {
-        device_context->PSSetShaderResources(0, 1, &get_resource(object.lightmap_patch_offset).texture.view);
+        Assert(shader.packed_vertex_shader != nullptr, "Drawing packed geometry with a shader that has no VShaderPacked.");
+        device_context->VSSetShader(shader.packed_vertex_shader, 0, 0);
+        device_context->IASetInputLayout(shader.packed_input_layout);
     }
-    else if (IsValidRRHandle(object.lightmap_handle))
+    else
     {
-        device_context->PSSetShaderResources(0, 1, &get_resource(object.lightmap_handle).texture.view);
+        device_context->VSSetShader(shader.vertex_shader, 0, 0);
+        device_context->IASetInputLayout(shader.input_layout);
     }
 
-    unsigned stride = sizeof(Vertex);
+    unsigned stride = geometry.vertex_stride;
     unsigned offset = 0;
     device_context->IASetVertexBuffers(0, 1, &geometry.vertices, &stride, &offset);
-    device_context->IASetIndexBuffer(geometry.indices, DXGI_FORMAT_R32_UINT, 0);
+    device_context->IASetIndexBuffer(geometry.indices, geometry.index_format == IndexFormat::UInt16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
+}
+
+static void draw_indexed(Renderer* r, const Geometry& geometry, const Matrix4x4& world_transform, const Matrix4x4& view_projection, const Matrix4x4& projection_matrix)
+{
+    ConstantBuffer constant_buffer_data = {};
+    constant_buffer_data.model_view_projection = world_transform * view_projection;
+    constant_buffer_data.model = world_transform;
+
+    // World transforms may scale non-uniformly, normals are transformed with the inverse transpose to stay
+    // perpendicular to the surface.
+    constant_buffer_data.normal_model = matrix4x4_transpose(matrix4x4_inverse(world_transform));
+    constant_buffer_data.projection = projection_matrix;
+    constant_buffer_data.position_offset = {geometry.position_offset.x, geometry.position_offset.y, geometry.position_offset.z, 0};
+    constant_buffer_data.position_scale = {geometry.position_scale.x, geometry.position_scale.y, geometry.position_scale.z, 1};
+    set_constant_buffers(r->device_context, r->constant_buffer, constant_buffer_data);
+    r->device_context->DrawIndexed(geometry.num_indices, 0, 0);
+}
+
+void Renderer::draw(const Object& object, const Matrix4x4& view_matrix, const Matrix4x4& projection_matrix)
+{
+    const Geometry& geometry = get_resource(object.geometry_handle).geometry;
+    device_context->VSSetConstantBuffers(0, 1, &constant_buffer);
+    device_context->PSSetConstantBuffers(0, 1, &constant_buffer);
+    bind_texture(this, object_texture(object));
+    bind_geometry(device_context, get_resource(current_shader).shader, geometry);
     device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    device_context->DrawIndexed(geometry.num_indices, 0, 0);
+    draw_indexed(this, geometry, object.world_transform, view_matrix * projection_matrix, projection_matrix);
+}
+
+// Depth only draws run without a pixel shader, so nothing but the depth buffer is written.
+enum struct PixelOutput { Shaded, DepthOnly };
+
+// Backend for render_commands_submit, its context is a D3DSubmitState.
+struct D3DSubmitState
+{
+    Renderer* renderer;
+    PixelOutput pixel_output;
+    Matrix4x4 view_projection;
+    Matrix4x4 projection;
+    const Shader* shader;
+    const Geometry* geometry;
+};
+
+static void d3d_begin(void* context, const Matrix4x4& view_matrix, const Matrix4x4& projection_matrix)
+{
+    D3DSubmitState* s = (D3DSubmitState*)context;
+    s->view_projection = view_matrix * projection_matrix;
+    s->projection = projection_matrix;
+    ID3D11DeviceContext* device_context = s->renderer->device_context;
+    device_context->VSSetConstantBuffers(0, 1, &s->renderer->constant_buffer);
+    device_context->PSSetConstantBuffers(0, 1, &s->renderer->constant_buffer);
+    device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+static void d3d_set_shader(void* context, RRHandle shader)
+{
+    D3DSubmitState* s = (D3DSubmitState*)context;
+    s->shader = &s->renderer->get_resource(shader).shader;
+    s->renderer->device_context->PSSetShader(s->pixel_output == PixelOutput::DepthOnly ? nullptr : s->shader->pixel_shader, 0, 0);
+
+    if (s->shader->sampler_state != nullptr)
+        s->renderer->device_context->PSSetSamplers(0, 1, &s->shader->sampler_state);
+}
+
+static void d3d_set_texture(void* context, RRHandle texture)
+{
+    bind_texture(((D3DSubmitState*)context)->renderer, texture);
+}
+
+static void d3d_set_geometry(void* context, RRHandle geometry)
+{
+    D3DSubmitState* s = (D3DSubmitState*)context;
+    s->geometry = &s->renderer->get_resource(geometry).geometry;
+    bind_geometry(s->renderer->device_context, *s->shader, *s->geometry);
+}
+
+static void d3d_draw(void* context, const DrawCommand& command)
+{
+    D3DSubmitState* s = (D3DSubmitState*)context;
+    draw_indexed(s->renderer, *s->geometry, command.world_transform, s->view_projection, s->projection);
+}
+
+static RenderSubmitStats submit_commands(Renderer* r, RenderCommandBuffer* cb, PixelOutput pixel_output)
+{
+    D3DSubmitState state = {};
+    state.renderer = r;
+    state.pixel_output = pixel_output;
+    RenderBackend backend = {&state, d3d_begin, d3d_set_shader, d3d_set_texture, d3d_set_geometry, d3d_draw};
+    return render_commands_submit(cb, backend);
+}
+
+RenderSubmitStats Renderer::submit(RenderCommandBuffer* cb)
+{
+    TRACE_SCOPE("submit");
+    return submit_commands(this, cb, PixelOutput::Shaded);
 }
 
 void Renderer::clear_depth_stencil()
@@ -540,13 +724,14 @@ void Renderer::clear_render_target(RenderTarget* sc, const Color& color)
 
 void Renderer::present()
 {
+    TRACE_SCOPE("present");
     swap_chain->Present(0, 0);
 }
 
 MappedTexture Renderer::map_texture(const RenderTarget& rt)
 {
-    unsigned handle = find_free_resource_handle();
-    Assert(handle != InvalidHandle, "Out of handles.");
+    TRACE_SCOPE("map_texture");
+    Assert(!handle_table_full(resource_handles), "Out of handles.");
 
     D3D11_TEXTURE2D_DESC rtd = {};
     ID3D11Texture2D* texture = get_resource(rt.render_resource).render_target.texture;
@@ -566,11 +751,10 @@ MappedTexture Renderer::map_texture(const RenderTarget& rt)
     RenderResource r = {};
     r.type = RenderResourceType::MappedTexture;
     r.texture = t;
-    resources[handle] = r;
 
     MappedTexture m = {};
     m.data = mapped_resource.pData;
-    m.texture = {handle};
+    m.texture = add_resource(r);
     return m;
 }
 
@@ -610,17 +794,80 @@ void Renderer::pre_draw_frame()
     }
 }
 
-void Renderer::draw_frame(const World& world, const Camera& camera, DrawLights draw_lights)
+// The frustum of the part of the viewport inside the scissor rect. Pixel rows go down while NDC y goes up.
+static Frustum scissored_frustum(const Renderer& r, const Matrix4x4& view_projection)
+{
+    const RenderTarget* rt = r.render_targets[0];
+    float width = rt != nullptr ? (float)rt->width : (float)WindowWidth;
+    float height = rt != nullptr ? (float)rt->height : (float)WindowHeight;
+    float left = (float)r.scissor_rect.left / width * 2 - 1;
+    float right = (float)r.scissor_rect.right / width * 2 - 1;
+    float top = 1 - (float)r.scissor_rect.top / height * 2;
+    float bottom = 1 - (float)r.scissor_rect.bottom / height * 2;
+    return frustum_from_view_projection(view_projection, left > -1 ? left : -1, right < 1 ? right : 1,
+        bottom > -1 ? bottom : -1, top < 1 ? top : 1);
+}
+
+// Draws the objects at object_indices, or all of them if it is null.
+static void draw_objects(Renderer* r, const World& world, const unsigned* object_indices, size_t num_objects, const Camera& camera,
+    DrawOccluders draw_occluders)
 {
-    pre_draw_frame();
+    TRACE_SCOPE("draw_frame");
+    r->pre_draw_frame();
     Matrix4x4 view_matrix = camera_calc_view_matrix(camera);
+    Frustum frustum = scissored_frustum(*r, view_matrix * camera.projection_matrix);
+    Allocator ta = create_temp_allocator();
+    RenderCommandBuffer cb = render_commands_create(&ta, view_matrix, camera.projection_matrix);
+    RenderCommandBuffer occluders_cb = render_commands_create(&ta, view_matrix, camera.projection_matrix);
+    cb.keys.reserve(num_objects);
+    cb.commands.reserve(num_objects);
+
+    for (size_t i = 0; i < num_objects; ++i)
+    {
+        const Object& object = world.objects[object_indices != nullptr ? object_indices[i] : i];
+
+        if (!frustum_intersects_aabb(frustum, object.world_bounds))
+            continue;
+
+        DrawCommand c = {};
+        c.shader = r->current_shader;
+        c.world_transform = object.world_transform;
+
+        if (draw_occluders == DrawOccluders::DepthOnlyProxies && IsValidRRHandle(object.occluder_geometry_handle))
+        {
+            c.geometry = object.occluder_geometry_handle;
+            render_commands_add(&occluders_cb, c);
+            continue;
+        }
+
+        c.texture = object_texture(object);
+        c.geometry = object.geometry_handle;
+        render_commands_add(&cb, c);
+    }
 
-    for (unsigned i = 0; i < world.objects.num; ++i)
+    // Occluders go first, what they hide then fails the depth test instead of being shaded and left visible.
+    if (occluders_cb.commands.num > 0)
     {
-        draw(world.objects[i], view_matrix, camera.projection_matrix);
+        submit_commands(r, &occluders_cb, PixelOutput::DepthOnly);
+        r->set_shader(r->current_shader);
     }
 
-    present();
+    r->submit(&cb);
+    r->present();
+}
+
+void Renderer::draw_frame(const World& world, const Camera& camera, DrawLights draw_lights)
+{
+    draw_objects(this, world, nullptr, world.objects.num, camera, DrawOccluders::Full);
+}
+
+void Renderer::draw_frame(const World& world, const unsigned* object_indices, size_t num_objects, const Camera& camera,
+    DrawLights draw_lights, DrawOccluders draw_occluders)
+{
+    for (size_t i = 0; i < num_objects; ++i)
+        Assert(object_indices[i] < world.objects.num, "Drawing an object that isn't in the world.");
+
+    draw_objects(this, world, object_indices, num_objects, camera, draw_occluders);
 }
 
 void Renderer::set_scissor_rect(const Rect& r)
@@ -631,6 +878,7 @@ void Renderer::set_scissor_rect(const Rect& r)
     rect.left = r.left;
     rect.right = r.right;
     device_context->RSSetScissorRects(1, &rect);
+    scissor_rect = r;
 }
 
 void Renderer::disable_scissor()
@@ -641,13 +889,13 @@ void Renderer::disable_scissor()
     rect.left = 0;
     rect.right = WindowWidth;
     device_context->RSSetScissorRects(1, &rect);
+    scissor_rect = {0, 0, WindowWidth, WindowHeight};
 }
 
 RRHandle Renderer::load_texture(void* data, PixelFormat pf, unsigned width, unsigned height)
 {
-    unsigned handle = find_free_resource_handle();
-
-    if (handle == InvalidHandle)
+    TRACE_SCOPE("load_texture");
+    if (handle_table_full(resource_handles))
         return {InvalidHandle};
 
     D3D11_TEXTURE2D_DESC desc;
@@ -666,7 +914,7 @@ RRHandle Renderer::load_texture(void* data, PixelFormat pf, unsigned width, unsi
     D3D11_SUBRESOURCE_DATA init_data;
     init_data.pSysMem = data;
     init_data.SysMemPitch = width * pixel_size(pf);
-    init_data.SysMemSlicePitch = image_size(pf, width, height);
+    init_data.SysMemSlicePitch = (UINT)image_size(pf, width, height);
 
     ID3D11Texture2D* tex;
     if (device->CreateTexture2D(&desc, &init_data, &tex) != S_OK)
@@ -684,12 +932,10 @@ RRHandle Renderer::load_texture(void* data, PixelFormat pf, unsigned width, unsi
     r.type = RenderResourceType::Texture;
     r.texture.resource = tex;
     r.texture.view = resource_view;
-    resources[handle] = r;
-    return {handle};
+    return add_resource(r);
 }
 
 RenderResource& Renderer::get_resource(RRHandle r)
 {
-    Assert(r.h > 0 && r.h < max_resources, "Resource handle out of bounds.");
-    return resources[r.h];
+    return resources[handle_table_index(resource_handles, r.h)];
 }
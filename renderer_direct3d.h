@@ -4,6 +4,8 @@
 #include "color.h"
 #include "math.h"
 #include "render_resource.h"
+#include "handle_table.h"
+#include "rect.h"
 
 struct ID3D11Buffer;
 struct ID3D11Device;
@@ -17,13 +19,19 @@ struct World;
 struct Object;
 struct Camera;
 struct Vertex;
-struct Rect;
+struct PackedMesh;
 struct RenderResource;
+struct RenderCommandBuffer;
+struct RenderSubmitStats;
 
 Image image_from_render_target(const RenderTarget& rt);
 
 enum struct DrawLights { DrawLights, DoNotDrawLights };
 
+// How objects with an occluder_geometry_handle are drawn. DepthOnlyProxies draws their proxies before everything
+// else, into the depth buffer only.
+enum struct DrawOccluders { Full, DepthOnlyProxies };
+
 struct Renderer
 {
     void init(void* window_handle);
@@ -32,8 +40,10 @@ struct Renderer
     void set_shader(RRHandle shader);
     RenderTarget create_back_buffer();
     RenderTarget create_render_texture(PixelFormat pf, unsigned width, unsigned height);
-    unsigned find_free_resource_handle() const;
-    RRHandle load_geometry(Vertex* vertices, unsigned num_vertices, unsigned* indices, unsigned num_indices);
+    RRHandle add_resource(const RenderResource& r);
+    RRHandle load_geometry(const Vertex* vertices, unsigned num_vertices, const void* indices, IndexFormat index_format, unsigned num_indices);
+    RRHandle load_geometry(const Vertex* vertices, unsigned num_vertices, const unsigned* indices, unsigned num_indices);
+    RRHandle load_geometry(const PackedMesh& m);
     void unload_resource(RRHandle handle);
     void set_render_target(RenderTarget* rt);
     void set_render_targets(RenderTarget** rt, unsigned num);
@@ -46,7 +56,17 @@ struct Renderer
     void pre_draw_frame();
     void set_scissor_rect(const Rect& r);
     void disable_scissor();
+
+    // Skips objects whose world_bounds are outside the view of the camera, or outside the part of it inside the
+    // scissor rect.
     void draw_frame(const World& world, const Camera& camera, DrawLights draw_lights);
+
+    // Like draw_frame, but only draws the objects at object_indices in world.objects.
+    void draw_frame(const World& world, const unsigned* object_indices, size_t num_objects, const Camera& camera,
+        DrawLights draw_lights, DrawOccluders draw_occluders);
+
+    // Draws a recorded command buffer, see render_commands.h. draw_frame records and submits one for the world.
+    RenderSubmitStats submit(RenderCommandBuffer* cb);
     RRHandle load_texture(void* data, PixelFormat pf, unsigned width, unsigned height);
     RenderResource& get_resource(RRHandle r);
 
@@ -61,5 +81,8 @@ struct Renderer
     IDXGISwapChain* swap_chain;
     RenderTarget back_buffer;
     RenderResource* resources;
+    HandleTable resource_handles;
     RenderTarget* render_targets[max_render_targets];
+    RRHandle current_shader;
+    Rect scissor_rect;
 };
@@ -0,0 +1,285 @@
+#include "sampling_profiler.h"
+
+#if defined(_WIN32)
+
+bool sampling_profiler_start(unsigned, unsigned)
+{
+    return false;
+}
+
+void sampling_profiler_stop()
+{
+}
+
+bool sampling_profiler_write_folded(const char*)
+{
+    return false;
+}
+
+#else
+
+#include <atomic>
+#include <new>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include "callstack_capturer.h"
+
+struct ProfilerSample
+{
+    // Set once the handler has finished writing the sample, a sample taken while stopping may not be.
+    std::atomic<bool> complete;
+    int thread_id;
+    CapturedCallstack callstack;
+};
+
+// Everything the signal handler touches is allocated before the timer starts, the handler itself only claims a
+// sample with an atomic increment and fills it in.
+struct SamplingProfiler
+{
+    ProfilerSample* samples;
+    size_t samples_size;
+    unsigned max_samples;
+    std::atomic<unsigned> num_claimed;
+    std::atomic<unsigned> num_dropped;
+    struct sigaction previous_action;
+    bool running;
+};
+
+static SamplingProfiler profiler;
+
+static void release_samples()
+{
+    if (profiler.samples == nullptr)
+        return;
+
+    munmap(profiler.samples, profiler.samples_size);
+    profiler.samples = nullptr;
+}
+
+static void sigprof_handler(int, siginfo_t*, void*)
+{
+    int saved_errno = errno;
+    unsigned index = profiler.num_claimed.fetch_add(1, std::memory_order_relaxed);
+
+    if (index >= profiler.max_samples)
+    {
+        profiler.num_dropped.fetch_add(1, std::memory_order_relaxed);
+        errno = saved_errno;
+        return;
+    }
+
+    // Skips this handler and the signal trampoline, the first frame is where the thread was interrupted.
+    ProfilerSample& s = profiler.samples[index];
+    s.thread_id = (int)syscall(SYS_gettid);
+    s.callstack = callstack_capture(2);
+    s.complete.store(true, std::memory_order_release);
+    errno = saved_errno;
+}
+
+bool sampling_profiler_start(unsigned samples_per_second, unsigned max_samples)
+{
+    if (profiler.running || samples_per_second == 0 || samples_per_second > 1000000 || max_samples == 0)
+        return false;
+
+    release_samples();
+    size_t samples_size = (size_t)max_samples * sizeof(ProfilerSample);
+    void* memory = mmap(nullptr, samples_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED)
+        return false;
+
+    profiler.samples = (ProfilerSample*)memory;
+    profiler.samples_size = samples_size;
+    profiler.max_samples = max_samples;
+    profiler.num_claimed.store(0);
+    profiler.num_dropped.store(0);
+
+    for (unsigned i = 0; i < max_samples; ++i)
+        new (&profiler.samples[i].complete) std::atomic<bool>(false);
+
+    // backtrace loads the unwinder on its first call, which allocates and can't happen inside the handler.
+    callstack_capture(0);
+
+    struct sigaction action = {};
+    action.sa_sigaction = sigprof_handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    if (sigaction(SIGPROF, &action, &profiler.previous_action) != 0)
+    {
+        release_samples();
+        return false;
+    }
+
+    struct itimerval timer = {};
+    unsigned interval_us = 1000000 / samples_per_second;
+    timer.it_interval.tv_sec = (time_t)(interval_us / 1000000);
+    timer.it_interval.tv_usec = (suseconds_t)(interval_us % 1000000);
+    timer.it_value = timer.it_interval;
+
+    if (setitimer(ITIMER_PROF, &timer, nullptr) != 0)
+    {
+        sigaction(SIGPROF, &profiler.previous_action, nullptr);
+        release_samples();
+        return false;
+    }
+
+    profiler.running = true;
+    return true;
+}
+
+void sampling_profiler_stop()
+{
+    if (!profiler.running)
+        return;
+
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+
+    // A SIGPROF that is still pending would terminate the process under the default action, so it is ignored
+    // instead of restored.
+    if (profiler.previous_action.sa_handler == SIG_DFL && (profiler.previous_action.sa_flags & SA_SIGINFO) == 0)
+    {
+        struct sigaction ignore = {};
+        ignore.sa_handler = SIG_IGN;
+        sigemptyset(&ignore.sa_mask);
+        sigaction(SIGPROF, &ignore, nullptr);
+    }
+    else
+        sigaction(SIGPROF, &profiler.previous_action, nullptr);
+
+    profiler.running = false;
+}
+
+// Return addresses within the same function are folded together by replacing them with the start of their
+// function, where it is known.
+static void canonicalize_frames(CapturedCallstack* c)
+{
+    for (unsigned i = 0; i < c->num_frames; ++i)
+    {
+        Dl_info info = {};
+
+        if (dladdr(c->frames[i], &info) != 0 && info.dli_saddr != nullptr)
+            c->frames[i] = info.dli_saddr;
+    }
+}
+
+static int compare_samples(const void* a, const void* b)
+{
+    const ProfilerSample* sa = &profiler.samples[*(const unsigned*)a];
+    const ProfilerSample* sb = &profiler.samples[*(const unsigned*)b];
+
+    if (sa->thread_id != sb->thread_id)
+        return sa->thread_id < sb->thread_id ? -1 : 1;
+
+    if (sa->callstack.num_frames != sb->callstack.num_frames)
+        return sa->callstack.num_frames < sb->callstack.num_frames ? -1 : 1;
+
+    return memcmp(sa->callstack.frames, sb->callstack.frames, sa->callstack.num_frames * sizeof(void*));
+}
+
+static bool same_stack(const ProfilerSample& a, const ProfilerSample& b)
+{
+    return a.thread_id == b.thread_id && callstack_equal(a.callstack, b.callstack);
+}
+
+// Semicolons separate frames in the folded format, so they can't be part of a name.
+static void write_frame_name(FILE* f, void* frame)
+{
+    Dl_info info = {};
+
+    if (dladdr(frame, &info) == 0 || info.dli_fname == nullptr)
+    {
+        fprintf(f, ";%p", frame);
+        return;
+    }
+
+    if (info.dli_sname == nullptr)
+    {
+        const char* module = strrchr(info.dli_fname, '/');
+        fprintf(f, ";%s+0x%zx", module != nullptr ? module + 1 : info.dli_fname, (size_t)((char*)frame - (char*)info.dli_fbase));
+        return;
+    }
+
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    fputc(';', f);
+
+    for (const char* c = status == 0 ? demangled : info.dli_sname; *c != 0; ++c)
+        fputc(*c == ';' ? ':' : *c, f);
+
+    free(demangled);
+}
+
+bool sampling_profiler_write_folded(const char* filename)
+{
+    sampling_profiler_stop();
+
+    if (profiler.samples == nullptr)
+        return false;
+
+    unsigned num_claimed = profiler.num_claimed.load();
+    unsigned num_taken = num_claimed < profiler.max_samples ? num_claimed : profiler.max_samples;
+    unsigned* order = (unsigned*)malloc((num_taken > 0 ? num_taken : 1) * sizeof(unsigned));
+    unsigned num_samples = 0;
+
+    for (unsigned i = 0; i < num_taken; ++i)
+    {
+        ProfilerSample& s = profiler.samples[i];
+
+        if (!s.complete.load(std::memory_order_acquire) || s.callstack.num_frames == 0)
+            continue;
+
+        canonicalize_frames(&s.callstack);
+        order[num_samples++] = i;
+    }
+
+    FILE* f = num_samples > 0 ? fopen(filename, "wb") : nullptr;
+
+    if (f == nullptr)
+    {
+        free(order);
+        release_samples();
+        return false;
+    }
+
+    qsort(order, num_samples, sizeof(unsigned), compare_samples);
+
+    // Frames are stored leaf first, folded stacks start at the root.
+    for (unsigned run_start = 0; run_start < num_samples;)
+    {
+        const ProfilerSample& s = profiler.samples[order[run_start]];
+        unsigned run_end = run_start + 1;
+
+        while (run_end < num_samples && same_stack(s, profiler.samples[order[run_end]]))
+            ++run_end;
+
+        fprintf(f, "thread %d", s.thread_id);
+
+        for (unsigned i = s.callstack.num_frames; i > 0; --i)
+            write_frame_name(f, s.callstack.frames[i - 1]);
+
+        fprintf(f, " %u\n", run_end - run_start);
+        run_start = run_end;
+    }
+
+    unsigned num_dropped = profiler.num_dropped.load();
+
+    if (num_dropped > 0)
+        fprintf(stderr, "Sampling profiler dropped %u samples, max_samples is %u.\n", num_dropped, profiler.max_samples);
+
+    free(order);
+    release_samples();
+    return fclose(f) == 0;
+}
+
+#endif
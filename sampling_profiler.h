@@ -0,0 +1,19 @@
+#pragma once
+
+// In-process sampling profiler, Linux only, elsewhere sampling_profiler_start returns false. A profiling timer
+// sends SIGPROF at samples_per_second of consumed CPU time, which the kernel delivers to whichever thread is
+// running, and the signal handler captures that thread's callstack with callstack_capture into memory that was
+// allocated up front. Once max_samples are taken further samples are dropped.
+//
+// sampling_profiler_write_folded writes the samples as folded stacks, one line per unique callstack with the
+// thread at its root, as flamegraph.pl and speedscope read them. Names of functions in the executable itself
+// need it to be linked with -rdynamic, others are written as module+offset.
+//
+// SIGPROF is taken over while the profiler runs.
+
+bool sampling_profiler_start(unsigned samples_per_second = 1000, unsigned max_samples = 64 * 1024);
+void sampling_profiler_stop();
+
+// Stops the profiler if it is running and releases the samples after writing them. Returns false if there are
+// no samples or the file can't be written.
+bool sampling_profiler_write_folded(const char* filename);
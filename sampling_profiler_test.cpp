@@ -0,0 +1,91 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <thread>
+#include "helpers.h"
+#if !defined(_WIN32)
+    #include "callstack_capturer.cpp"
+#endif
+#include "sampling_profiler.cpp"
+
+static volatile double sink;
+
+#if !defined(_WIN32)
+// Uses up CPU time of the calling thread. The clock of the whole process would be shared by both threads of the
+// test, which then stop after half the time each.
+static double thread_cpu_seconds()
+{
+    timespec t = {};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+static void burn_cpu(double seconds)
+{
+    double end = thread_cpu_seconds() + seconds;
+    double x = 1;
+
+    while (thread_cpu_seconds() < end)
+    {
+        for (unsigned i = 0; i < 10000; ++i)
+            x = x * 1.0000001 + 0.0000001;
+    }
+
+    sink = x;
+}
+#endif
+
+int main()
+{
+    #if defined(_WIN32)
+        assert(!sampling_profiler_start());
+        return 0;
+    #else
+        const char* filename = "sampling_profiler_test.folded";
+        assert(!sampling_profiler_write_folded(filename));
+        assert(sampling_profiler_start(1000, 4096));
+        assert(!sampling_profiler_start());
+
+        std::thread t(burn_cpu, 0.2);
+        burn_cpu(0.2);
+        t.join();
+
+        assert(sampling_profiler_write_folded(filename));
+
+        FILE* f = fopen(filename, "rb");
+        assert(f != nullptr);
+        char line[8192];
+        unsigned total = 0;
+        unsigned num_lines = 0;
+        int first_thread = 0;
+        bool two_threads = false;
+
+        while (fgets(line, sizeof(line), f) != nullptr)
+        {
+            // thread <id>;<root>;...;<leaf> <count>
+            int thread_id = 0;
+            assert(sscanf(line, "thread %d;", &thread_id) == 1);
+            const char* count = strrchr(line, ' ');
+            assert(count != nullptr && strchr(line, ';') != nullptr && strchr(line, ';') < count);
+            assert(atoi(count + 1) > 0);
+            total += (unsigned)atoi(count + 1);
+            ++num_lines;
+            first_thread = first_thread == 0 ? thread_id : first_thread;
+            two_threads = two_threads || thread_id != first_thread;
+        }
+
+        fclose(f);
+        remove(filename);
+
+        // 0.4 seconds of CPU time at 1000 samples per second. The profiling timer only fires on scheduler ticks,
+        // which can be as slow as 100 per second.
+        assert(total >= 20 && total <= 4096);
+        assert(num_lines <= total);
+        assert(two_threads);
+
+        // Samples were released by the write.
+        assert(!sampling_profiler_write_folded(filename));
+        return 0;
+    #endif
+}
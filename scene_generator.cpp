@@ -0,0 +1,322 @@
+#include "scene_generator.h"
+#include "renderer_direct3d.h"
+#include "memory.h"
+#include "world.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_simplifier.h"
+#include "math_batch.h"
+
+// Rock proxies keep this fraction of the triangles of a rock, enough for its outline in a hemicube.
+static const unsigned RockProxyReduction = 16;
+
+// Boxes whose scales have the same lightmap_scale_key share geometry. The geometries are kept in an open-addressed
+// hash map keyed on the scale key, a slot is empty while its key_plus_one is 0.
+struct BoxGeometrySlot
+{
+    unsigned key_plus_one;
+    RRHandle geometry;
+};
+
+struct SceneBuilder
+{
+    World* world;
+    Renderer* renderer;
+    Allocator* ta;
+    Aabb box_bounds;
+    BoxGeometrySlot* box_geometries;
+    size_t box_geometries_capacity;
+    size_t num_box_geometries;
+    RRHandle rock_geometry;
+    RRHandle rock_proxy_geometry;
+    Aabb rock_bounds;
+    unsigned lightmap_size;
+    unsigned next_id;
+};
+
+static unsigned pack_scale_key(const LightmapScaleKey& key)
+{
+    return (unsigned)(unsigned char)key.steps[0] | (unsigned)(unsigned char)key.steps[1] << 8
+        | (unsigned)(unsigned char)key.steps[2] << 16;
+}
+
+static BoxGeometrySlot* find_box_geometry_slot(BoxGeometrySlot* slots, size_t capacity, unsigned key_plus_one)
+{
+    size_t mask = capacity - 1;
+    size_t i = ((key_plus_one * 2654435761u) >> 8) & mask;
+
+    while (slots[i].key_plus_one != 0 && slots[i].key_plus_one != key_plus_one)
+        i = (i + 1) & mask;
+
+    return slots + i;
+}
+
+static void grow_box_geometries(SceneBuilder* sb)
+{
+    BoxGeometrySlot* old_slots = sb->box_geometries;
+    size_t old_capacity = sb->box_geometries_capacity;
+    sb->box_geometries_capacity = old_capacity == 0 ? 16 : old_capacity * 2;
+    size_t size = sb->box_geometries_capacity * sizeof(BoxGeometrySlot);
+    sb->box_geometries = (BoxGeometrySlot*)sb->ta->alloc(size);
+    memset(sb->box_geometries, 0, size);
+
+    for (size_t i = 0; i < old_capacity; ++i)
+    {
+        if (old_slots[i].key_plus_one != 0)
+            *find_box_geometry_slot(sb->box_geometries, sb->box_geometries_capacity, old_slots[i].key_plus_one) = old_slots[i];
+    }
+
+    sb->ta->dealloc(old_slots);
+}
+
+// The geometry is packed, see PackedVertex, half float uvs are within a quarter texel of the unpacked ones at the
+// largest lightmap size.
+static RRHandle box_geometry(SceneBuilder* sb, const Vector3& scale)
+{
+    LightmapScaleKey key = lightmap_scale_key(scale);
+    unsigned key_plus_one = pack_scale_key(key) + 1;
+
+    if ((sb->num_box_geometries + 1) * 2 > sb->box_geometries_capacity)
+        grow_box_geometries(sb);
+
+    BoxGeometrySlot* slot = find_box_geometry_slot(sb->box_geometries, sb->box_geometries_capacity, key_plus_one);
+
+    if (slot->key_plus_one != 0)
+        return slot->geometry;
+
+    CachedMesh cm = mesh_load_cached(sb->ta, "box.wobj", sb->lightmap_size, key);
+    Assert(cm.valid, "Failed loading the box for a scale.");
+
+    Mesh m = mesh_cache_copy(sb->ta, cm);
+    PackedMesh pm = mesh_pack(sb->ta, m);
+    slot->key_plus_one = key_plus_one;
+    slot->geometry = sb->renderer->load_geometry(pm);
+    ++sb->num_box_geometries;
+    packed_mesh_destroy(&pm);
+    mesh_destroy(&m);
+    mesh_cache_unload(&cm);
+    return slot->geometry;
+}
+
+// Boxes and rocks are about a unit in size around the origin, they are scaled before they are rotated and moved.
+static Object create_object(SceneBuilder* sb, RRHandle geometry, const Aabb& bounds, const Vector3& scale, const Quaternion& rotation,
+    const Vector3& pos)
+{
+    Matrix4x4 scale_matrix = matrix4x4_identity();
+    scale_matrix.x.x = scale.x;
+    scale_matrix.y.y = scale.y;
+    scale_matrix.z.z = scale.z;
+
+    Object obj = {};
+    obj.geometry_handle = geometry;
+    obj.world_transform = scale_matrix * matrix4x4_from_rotation_and_translation(rotation, pos);
+    obj.id = sb->next_id++;
+    transform_aabbs(obj.world_transform, &bounds, &obj.world_bounds, 1);
+    return obj;
+}
+
+static void add_box(SceneBuilder* sb, const Vector3& scale, const Quaternion& rotation, const Vector3& pos, bool is_light)
+{
+    Object obj = create_object(sb, box_geometry(sb, scale), sb->box_bounds, scale, rotation, pos);
+    obj.is_light = is_light;
+    sb->world->objects.add(obj);
+}
+
+// Rocks only occlude, see Object::occluder_geometry_handle.
+static void add_rock(SceneBuilder* sb, const Vector3& scale, const Quaternion& rotation, const Vector3& pos)
+{
+    Object obj = create_object(sb, sb->rock_geometry, sb->rock_bounds, scale, rotation, pos);
+    obj.occluder_geometry_handle = sb->rock_proxy_geometry;
+    sb->world->objects.add(obj);
+}
+
+static void add_box(SceneBuilder* sb, const Vector3& scale, const Vector3& pos, bool is_light = false)
+{
+    add_box(sb, scale, quaternion_identity(), pos, is_light);
+}
+
+// A lumpy ball of about unit size around the origin, with rings rings from pole to pole and twice as many segments
+// around. It is closed and has no seams, so mesh_simplify can collapse all of it. Rocks only occlude, so they have
+// no uvs.
+static Mesh create_rock(Allocator* alloc, unsigned rings)
+{
+    unsigned segments = rings * 2;
+    Mesh m = mesh_create(alloc);
+    m.vertices.reserve((rings - 1) * segments + 2);
+    m.indices.reserve((rings - 1) * segments * 6);
+
+    for (unsigned r = 0; r <= rings; ++r)
+    {
+        float theta = PI * (float)r / (float)rings;
+        unsigned num_around = r == 0 || r == rings ? 1 : segments;
+
+        for (unsigned s = 0; s < num_around; ++s)
+        {
+            float phi = 2 * PI * (float)s / (float)segments;
+            Vector3 dir = {sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)};
+            float radius = 0.5f * (1 + 0.1f * sinf(3 * phi) * sinf(2 * theta) + 0.06f * cosf(5 * phi + 3 * theta));
+            Vertex v = {};
+            v.position = dir * radius;
+            v.normal = dir;
+            v.color = {1, 1, 1, 1};
+            m.vertices.add(v);
+        }
+    }
+
+    // Vertex 0 is the top, the last one the bottom and ring r starts at 1 + (r - 1) * segments.
+    unsigned bottom = (unsigned)m.vertices.num - 1;
+    unsigned last_ring = 1 + (rings - 2) * segments;
+
+    for (unsigned s = 0; s < segments; ++s)
+    {
+        unsigned next = (s + 1) % segments;
+        unsigned top_cap[] = {0, 1 + next, 1 + s};
+        unsigned bottom_cap[] = {bottom, last_ring + s, last_ring + next};
+
+        for (unsigned c = 0; c < 3; ++c)
+            m.indices.add(top_cap[c]);
+
+        for (unsigned c = 0; c < 3; ++c)
+            m.indices.add(bottom_cap[c]);
+
+        for (unsigned r = 1; r + 1 < rings; ++r)
+        {
+            unsigned upper = 1 + (r - 1) * segments;
+            unsigned lower = upper + segments;
+            unsigned quad[] = {upper + s, upper + next, lower + next, upper + s, lower + next, lower + s};
+
+            for (unsigned c = 0; c < 6; ++c)
+                m.indices.add(quad[c]);
+        }
+    }
+
+    return m;
+}
+
+static RRHandle load_mesh(Renderer* renderer, Allocator* ta, const Mesh& m)
+{
+    PackedMesh pm = mesh_pack(ta, m);
+    RRHandle h = renderer->load_geometry(pm);
+    packed_mesh_destroy(&pm);
+    return h;
+}
+
+static void load_rock(SceneBuilder* sb, unsigned rings)
+{
+    Mesh rock = create_rock(sb->ta, rings);
+    Mesh proxy = mesh_simplify(sb->ta, rock, rock.indices.num / RockProxyReduction);
+    sb->rock_geometry = load_mesh(sb->renderer, sb->ta, rock);
+    sb->rock_proxy_geometry = load_mesh(sb->renderer, sb->ta, proxy);
+    sb->rock_bounds = vertices_bounds(rock.vertices.data, rock.vertices.num);
+    mesh_destroy(&proxy);
+    mesh_destroy(&rock);
+}
+
+static unsigned lcg_next(unsigned* state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state;
+}
+
+static float random_range(unsigned* state, float min_value, float max_value)
+{
+    float t = (float)(lcg_next(state) >> 8) / (float)(1 << 24);
+    return min_value + t * (max_value - min_value);
+}
+
+static void generate_cornell_box(SceneBuilder* sb)
+{
+    const float size = 2;
+    const float wall = 0.1f;
+    const float half = size / 2;
+    const float wall_offset = half + wall / 2;
+
+    add_box(sb, {size + 2 * wall, wall, size + wall}, {0, -wall_offset, -wall / 2});
+    add_box(sb, {size + 2 * wall, wall, size + wall}, {0, wall_offset, -wall / 2});
+    add_box(sb, {size + 2 * wall, size, wall}, {0, 0, -wall_offset});
+    add_box(sb, {wall, size, size}, {-wall_offset, 0, 0});
+    add_box(sb, {wall, size, size}, {wall_offset, 0, 0});
+
+    add_box(sb, {0.6f, 1.2f, 0.6f}, quaternion_from_axis_angle(vector3_up, 0.3f), {-0.35f, -half + 0.6f, -0.3f}, false);
+    add_box(sb, {0.6f, 0.6f, 0.6f}, quaternion_from_axis_angle(vector3_up, -0.3f), {0.35f, -half + 0.3f, 0.3f}, false);
+    add_box(sb, {0.5f, 0.02f, 0.5f}, {0, half - 0.02f, 0}, true);
+}
+
+static void generate_pillar_grid(SceneBuilder* sb, unsigned grid_width, unsigned grid_depth)
+{
+    const float spacing = 1.5f;
+    const float pillar_width = 0.4f;
+    const float pillar_height = 2;
+    const float slab_thickness = 0.3f;
+    float width = (float)(grid_width > 0 ? grid_width : 1) * spacing;
+    float depth = (float)(grid_depth > 0 ? grid_depth : 1) * spacing;
+
+    add_box(sb, {width, slab_thickness, depth}, {0, 0, 0});
+    add_box(sb, {width, slab_thickness, depth}, {0, slab_thickness + pillar_height, 0});
+
+    for (unsigned z = 0; z < grid_depth; ++z)
+    {
+        for (unsigned x = 0; x < grid_width; ++x)
+        {
+            Vector3 pos = {((float)x + 0.5f) * spacing - width / 2, (slab_thickness + pillar_height) / 2, ((float)z + 0.5f) * spacing - depth / 2};
+            add_box(sb, {pillar_width, pillar_height, pillar_width}, pos);
+        }
+    }
+
+    add_box(sb, {10, 10, 10}, {-width - 10, 12, -depth - 10}, true);
+}
+
+static void generate_scattered_props(SceneBuilder* sb, unsigned num_props, unsigned seed)
+{
+    const float floor_size = 10;
+    const float floor_thickness = 0.2f;
+    unsigned rng = seed;
+
+    add_box(sb, {floor_size, floor_thickness, floor_size}, {0, 0, 0});
+
+    for (unsigned i = 0; i < num_props; ++i)
+    {
+        Vector3 scale = {random_range(&rng, 0.2f, 1), random_range(&rng, 0.2f, 1.5f), random_range(&rng, 0.2f, 1)};
+        float angle = random_range(&rng, 0, 2 * PI);
+        float limit = floor_size / 2 - 0.5f;
+        Vector3 pos = {random_range(&rng, -limit, limit), (floor_thickness + scale.y) / 2, random_range(&rng, -limit, limit)};
+        Quaternion rotation = quaternion_from_axis_angle(vector3_up, angle);
+
+        if (IsValidRRHandle(sb->rock_geometry))
+            add_rock(sb, scale, rotation, pos);
+        else
+            add_box(sb, scale, rotation, pos, false);
+    }
+
+    add_box(sb, {2, 0.2f, 2}, {0, 6, 0}, true);
+}
+
+bool scene_generate(World* world, Renderer* renderer, const SceneSettings& settings)
+{
+    Allocator ta = create_temp_allocator();
+    CachedMesh cm = mesh_load_cached(&ta, "box.wobj", settings.lightmap_size);
+
+    if (!cm.valid)
+        return false;
+
+    SceneBuilder sb = {};
+    sb.world = world;
+    sb.renderer = renderer;
+    sb.ta = &ta;
+    sb.box_bounds = vertices_bounds(cm.vertices, cm.num_vertices);
+    sb.lightmap_size = settings.lightmap_size;
+    sb.next_id = 1;
+    mesh_cache_unload(&cm);
+
+    if (settings.type == SceneType::ScatteredProps && settings.rock_rings > 0)
+        load_rock(&sb, settings.rock_rings > 2 ? settings.rock_rings : 2);
+
+    switch (settings.type)
+    {
+        case SceneType::CornellBox: generate_cornell_box(&sb); break;
+        case SceneType::PillarGrid: generate_pillar_grid(&sb, settings.grid_width, settings.grid_depth); break;
+        case SceneType::ScatteredProps: generate_scattered_props(&sb, settings.num_props, settings.seed); break;
+    }
+
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+struct Renderer;
+struct World;
+
+enum struct SceneType
+{
+    // A closed room with an open front, two blocks on the floor and a light under the ceiling.
+    CornellBox,
+
+    // A floor and a ceiling held up by grid_width by grid_depth pillars, lit from the side by a distant light.
+    PillarGrid,
+
+    // num_props boxes of random size and rotation scattered over a floor, with a light above. With rock_rings set
+    // the props are rocks instead.
+    ScatteredProps
+};
+
+struct SceneSettings
+{
+    SceneType type;
+    unsigned grid_width;
+    unsigned grid_depth;
+    unsigned num_props;
+
+    // Props are placed from seed, so the same settings always make the same scene.
+    unsigned seed;
+
+    // If not 0 the props of ScatteredProps are lumpy rocks with rock_rings rings of quads from pole to pole, about
+    // 4 * rock_rings^2 triangles. Rocks only occlude: they get no lightmap and the radiosity mapper draws a proxy
+    // simplified by mesh_simplify in their place, see Object::occluder_geometry_handle.
+    unsigned rock_rings;
+
+    // The geometry gets lightmap uvs made for this size, it should match what run_radiosity_mapper is given.
+    unsigned lightmap_size;
+};
+
+// Every object but the rocks is an instance of box.wobj, numbered from 1 in the order they are added. Objects whose
+// scales have the same lightmap_scale_key share their geometry, all rocks share one geometry and one proxy. Returns
+// false if the box geometry could not be loaded.
+bool scene_generate(World* world, Renderer* renderer, const SceneSettings& settings);
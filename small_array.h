@@ -0,0 +1,176 @@
+#pragma once
+#include <stdint.h>
+
+struct Allocator;
+
+// Array with the same interface as DynamicArray, but the first N elements are stored inline and the allocator
+// is only used once it grows past N. A zeroed SmallArray is valid and empty, so arrays of them can be memset.
+template<typename T, size_t N>
+struct SmallArray
+{
+    Allocator* allocator;
+    T* heap_data;
+    size_t num;
+    size_t heap_capacity;
+    T inline_data[N];
+
+    T* data()
+    {
+        return heap_data == nullptr ? inline_data : heap_data;
+    }
+
+    const T* data() const
+    {
+        return heap_data == nullptr ? inline_data : heap_data;
+    }
+
+    size_t capacity() const
+    {
+        return heap_data == nullptr ? N : heap_capacity;
+    }
+
+    void set_capacity(size_t new_capacity)
+    {
+        Assert(new_capacity >= num && new_capacity <= SIZE_MAX / sizeof(T), "SmallArray capacity overflow.");
+
+        if (new_capacity <= N)
+        {
+            if (heap_data == nullptr)
+                return;
+
+            T* old_data = heap_data;
+            memcpy(inline_data, old_data, num * sizeof(T));
+            allocator->dealloc(old_data);
+            heap_data = nullptr;
+            heap_capacity = 0;
+            return;
+        }
+
+        if (allocator->try_extend(heap_data, new_capacity * sizeof(T)))
+        {
+            heap_capacity = new_capacity;
+            return;
+        }
+
+        T* old_data = data();
+        T* new_data = (T*)allocator->alloc(new_capacity * sizeof(T));
+        memcpy(new_data, old_data, num * sizeof(T));
+
+        if (heap_data != nullptr)
+            allocator->dealloc(heap_data);
+
+        heap_data = new_data;
+        heap_capacity = new_capacity;
+    }
+
+    void grow()
+    {
+        size_t c = capacity();
+        size_t new_capacity = c * 2 > num + 5 ? c * 2 : num + 5;
+        Assert(new_capacity > c, "SmallArray capacity overflow.");
+        set_capacity(new_capacity);
+    }
+
+    void reserve(size_t n)
+    {
+        if (n > capacity())
+            set_capacity(n);
+    }
+
+    // New elements are zeroed.
+    void resize(size_t n)
+    {
+        reserve(n);
+
+        if (n > num)
+            memset(data() + num, 0, (n - num) * sizeof(T));
+
+        num = n;
+    }
+
+    void shrink_to_fit()
+    {
+        if (heap_data != nullptr && num != heap_capacity)
+            set_capacity(num);
+    }
+
+    void insert(const T& v, size_t i)
+    {
+        while (i + 1 > capacity())
+            grow();
+
+        *(data() + i) = v;
+    }
+
+    void add(const T& v)
+    {
+        if (num == capacity())
+            grow();
+
+        *(data() + num) = v;
+        ++num;
+    }
+
+    T* push()
+    {
+        if (num == capacity())
+            grow();
+
+        T* p = data() + num;
+        ++num;
+        return p;
+    }
+
+    void remove(size_t i)
+    {
+        if (num == 1 || (num > 1 && i == num - 1))
+        {
+            --num;
+            return;
+        }
+
+        memcpy(data() + i, data() + num - 1, sizeof(T));
+        --num;
+    }
+
+    T* clone_raw(Allocator* alloc = nullptr) const
+    {
+        T* p = (T*)(alloc == nullptr ? allocator : alloc)->alloc(num * sizeof(T));
+        memcpy(p, data(), num * sizeof(T));
+        return p;
+    }
+
+    T& last()
+    {
+        return data()[num - 1];
+    }
+
+    T& operator[](size_t i)
+    {
+        return data()[i];
+    }
+
+    const T& operator[](size_t i) const
+    {
+        return data()[i];
+    }
+};
+
+template<typename T, size_t N>
+inline SmallArray<T, N> small_array_create(Allocator* allocator)
+{
+    SmallArray<T, N> sa = {};
+    sa.allocator = allocator;
+    return sa;
+}
+
+template<typename T, size_t N>
+inline void small_array_destroy(SmallArray<T, N>* sa)
+{
+    if (sa->heap_data != nullptr)
+        sa->allocator->dealloc(sa->heap_data);
+
+    sa->heap_data = nullptr;
+    sa->heap_capacity = 0;
+    sa->num = 0;
+}
@@ -4,28 +4,25 @@
 #include "world.h"
 #include "renderer_direct3d.h"
 #include "mesh.h"
-#include "obj.h"
+#include "mesh_cache.h"
 #include "file.h"
 #include "memory.h"
+#include "lightmap_uv.h"
+#include "math_batch.h"
 
-static Object create_scaled_box(Renderer* renderer, const Mesh& m, const Vector3& scale, const Vector3& pos, const Color& color, unsigned id, bool is_light)
+// Every box is an instance of the same geometry, the scale is part of its world transform.
+static Object create_scaled_box(Renderer* renderer, RRHandle box_geometry_handle, const Aabb& box_bounds, const Vector3& scale, const Vector3& pos, unsigned id, bool is_light)
 {
-    Vertex* scaled_vertices = m.vertices.clone_raw();
-    memcpy(scaled_vertices, m.vertices.data, m.vertices.num * sizeof(Vertex));
-
-    for (unsigned i = 0; i < m.vertices.num; ++i)
-    {
-        scaled_vertices[i].position = scaled_vertices[i].position * scale;
-        scaled_vertices[i].color = color;
-    }
-
-    RRHandle box_geometry_handle = renderer->load_geometry(scaled_vertices, m.vertices.num, m.indices.data, m.indices.num);
     Object obj = {};
     obj.geometry_handle = box_geometry_handle;
     obj.world_transform = matrix4x4_identity();
+    obj.world_transform.x.x = scale.x;
+    obj.world_transform.y.y = scale.y;
+    obj.world_transform.z.z = scale.z;
     obj.id = id;
     obj.is_light = is_light;
     memcpy(&obj.world_transform.w.x, &pos.x, sizeof(Vector3));
+    transform_aabbs(obj.world_transform, &box_bounds, &obj.world_bounds, 1);
 
     {
         static char lightmap_filename[256];
@@ -35,7 +32,7 @@ static Object create_scaled_box(Renderer* renderer, const Mesh& m, const Vector3
 
         if (f.valid)
         {
-            RRHandle lightmap_handle = renderer->load_texture(f.file.data, PixelFormat::R8G8B8A8_UINT_NORM, 64, 64);
+            RRHandle lightmap_handle = renderer->load_texture(f.file.data, PixelFormat::R8G8B8A8_UINT_NORM, LightmapSize, LightmapSize);
         
             if (IsValidRRHandle(lightmap_handle))
                 obj.lightmap_handle = lightmap_handle;
@@ -45,12 +42,29 @@ static Object create_scaled_box(Renderer* renderer, const Mesh& m, const Vector3
     return obj;
 }
 
+// Boxes whose scales have the same lightmap_scale_key share packed geometry, with lightmap uvs made for that key.
+static RRHandle load_box_for_scale(Renderer* renderer, Allocator* ta, const Vector3& scale)
+{
+    CachedMesh cm = mesh_load_cached(ta, "box.wobj", LightmapSize, lightmap_scale_key(scale));
+
+    if (!cm.valid)
+        return {InvalidHandle};
+
+    Mesh m = mesh_cache_copy(ta, cm);
+    PackedMesh pm = mesh_pack(ta, m);
+    RRHandle h = renderer->load_geometry(pm);
+    packed_mesh_destroy(&pm);
+    mesh_destroy(&m);
+    mesh_cache_unload(&cm);
+    return h;
+}
+
 void create_test_world(World* world, Renderer* renderer)
 {
     Allocator ta = create_temp_allocator();
-    LoadedMesh lm = obj_load(&ta, "box.wobj");
+    CachedMesh cm = mesh_load_cached(&ta, "box.wobj");
 
-    if (!lm.valid)
+    if (!cm.valid)
         return;
 
     float floor_width = 6;
@@ -58,21 +72,30 @@ void create_test_world(World* world, Renderer* renderer)
     float floor_thickness = 0.3f;
     float floor_to_cieling = 2;
     float pillar_width = 0.4f;
+    Vector3 floor_scale = {floor_width, floor_thickness, floor_depth};
+    Vector3 pillar_scale = {pillar_width, floor_to_cieling, pillar_width};
+    Vector3 light_scale = {10, 10, 10};
 
-    world->objects.add(create_scaled_box(renderer, lm.mesh, {floor_width, floor_thickness, floor_depth}, {0, 0, 0}, color_random(), 4, false));
-    world->objects.add(create_scaled_box(renderer, lm.mesh, {pillar_width, floor_to_cieling, pillar_width}, {-1, (floor_thickness + floor_to_cieling) / 2, 1}, color_random(), 12, false));
-    world->objects.add(create_scaled_box(renderer, lm.mesh, {pillar_width, floor_to_cieling, pillar_width}, {-1, (floor_thickness + floor_to_cieling) / 2, -1}, color_random(), 123, false));
-    world->objects.add(create_scaled_box(renderer, lm.mesh, {floor_width, floor_thickness, floor_depth}, {0, floor_thickness + floor_to_cieling, 0}, color_random(), 145, false));
-    //world->objects.add(create_scaled_box(renderer, lm.mesh, {floor_width, floor_thickness, floor_depth}, {0, floor_thickness + floor_to_cieling - 15, 0}, color::random(), 12333))
+    Aabb box_bounds = vertices_bounds(cm.vertices, cm.num_vertices);
+    mesh_cache_unload(&cm);
+    RRHandle floor_box = load_box_for_scale(renderer, &ta, floor_scale);
+    RRHandle pillar_box = load_box_for_scale(renderer, &ta, pillar_scale);
+    RRHandle light_box = load_box_for_scale(renderer, &ta, light_scale);
 
-    //world->objects.add(create_scaled_box(renderer, lm.mesh, {2,2,2}, {0, 0, 0}, color::random(), 145, false));
+    if (floor_box.h == InvalidHandle || pillar_box.h == InvalidHandle || light_box.h == InvalidHandle)
+        return;
 
-    //world->objects.add(create_scaled_box(renderer, lm.mesh, {1,1,1}, vector3::lookdir * 5, color::random(), 145));
+    world->objects.add(create_scaled_box(renderer, floor_box, box_bounds, floor_scale, {0, 0, 0}, 4, false));
+    world->objects.add(create_scaled_box(renderer, pillar_box, box_bounds, pillar_scale, {-1, (floor_thickness + floor_to_cieling) / 2, 1}, 12, false));
+    world->objects.add(create_scaled_box(renderer, pillar_box, box_bounds, pillar_scale, {-1, (floor_thickness + floor_to_cieling) / 2, -1}, 123, false));
+    world->objects.add(create_scaled_box(renderer, floor_box, box_bounds, floor_scale, {0, floor_thickness + floor_to_cieling, 0}, 145, false));
+    //world->objects.add(create_scaled_box(renderer, box, {floor_width, floor_thickness, floor_depth}, {0, floor_thickness + floor_to_cieling - 15, 0}, 12333))
 
-    //world::add_object(world, create_scaled_box(renderer, lm.mesh, {1, 1, 1}, {-10, 0, 0}, color::random()));
+    //world->objects.add(create_scaled_box(renderer, box, {2,2,2}, {0, 0, 0}, 145, false));
 
-    if (lm.valid)
-    {
-        world->objects.add(create_scaled_box(renderer, lm.mesh, {10, 10, 10}, {-20, 25, -19}, {1,1,1,1}, 10000, true));
-    }
+    //world->objects.add(create_scaled_box(renderer, box, {1,1,1}, vector3::lookdir * 5, 145));
+
+    //world::add_object(world, create_scaled_box(renderer, box, {1, 1, 1}, {-10, 0, 0}));
+
+    world->objects.add(create_scaled_box(renderer, light_box, box_bounds, light_scale, {-20, 25, -19}, 10000, true));
 }
@@ -0,0 +1,179 @@
+#include "trace.h"
+
+#if defined(ENABLE_TRACING)
+
+#include <stdio.h>
+#include <new>
+#include <atomic>
+#include <chrono>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+// Written only by its own thread. num_written is published after each event, and after the chunk it is in, so a
+// reader sees whole events up to it. Buffers are never freed, events of threads that have exited are still
+// written out.
+struct TraceBuffer
+{
+    TraceEvent* chunks[TraceMaxChunksPerThread];
+    std::atomic<uint64_t> num_written;
+    std::atomic<uint64_t> num_dropped;
+};
+
+static std::atomic<TraceBuffer*> trace_buffers[TraceMaxThreads];
+static std::atomic<unsigned> trace_num_threads;
+static thread_local TraceBuffer* trace_thread_buffer;
+static thread_local bool trace_thread_registered;
+
+// A timestamp together with the time it was taken, two of them give the rate of the time stamp counter.
+struct TraceClockSample
+{
+    uint64_t timestamp;
+    std::chrono::steady_clock::time_point time;
+};
+
+static TraceClockSample clock_sample()
+{
+    TraceClockSample s;
+    s.timestamp = trace_timestamp();
+    s.time = std::chrono::steady_clock::now();
+    return s;
+}
+
+static const TraceClockSample trace_start = clock_sample();
+
+static void* alloc_pages(size_t size)
+{
+    #if defined(_WIN32)
+        return VirtualAlloc(nullptr, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+    #else
+        void* p = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        return p == MAP_FAILED ? nullptr : p;
+    #endif
+}
+
+static TraceBuffer* register_thread()
+{
+    trace_thread_registered = true;
+    unsigned slot = trace_num_threads.fetch_add(1);
+
+    if (slot >= TraceMaxThreads)
+        return nullptr;
+
+    void* memory = alloc_pages(sizeof(TraceBuffer));
+
+    if (memory == nullptr)
+        return nullptr;
+
+    TraceBuffer* b = (TraceBuffer*)memory;
+    new (&b->num_written) std::atomic<uint64_t>(0);
+    new (&b->num_dropped) std::atomic<uint64_t>(0);
+    trace_buffers[slot].store(b, std::memory_order_release);
+    return b;
+}
+
+void trace_record(const char* name, uint64_t start, uint64_t end)
+{
+    TraceBuffer* b = trace_thread_buffer;
+
+    if (b == nullptr)
+    {
+        if (trace_thread_registered)
+            return;
+
+        b = trace_thread_buffer = register_thread();
+
+        if (b == nullptr)
+            return;
+    }
+
+    uint64_t n = b->num_written.load(std::memory_order_relaxed);
+    uint64_t chunk = n / TraceEventsPerChunk;
+
+    if (chunk < TraceMaxChunksPerThread && b->chunks[chunk] == nullptr)
+        b->chunks[chunk] = (TraceEvent*)alloc_pages(TraceEventsPerChunk * sizeof(TraceEvent));
+
+    if (chunk >= TraceMaxChunksPerThread || b->chunks[chunk] == nullptr)
+    {
+        b->num_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent& e = b->chunks[chunk][n % TraceEventsPerChunk];
+    e.name = name;
+    e.start = start;
+    e.end = end;
+    b->num_written.store(n + 1, std::memory_order_release);
+}
+
+static void write_json_string(FILE* f, const char* s)
+{
+    fputc('"', f);
+
+    for (; *s != 0; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', f);
+
+        fputc(*s, f);
+    }
+
+    fputc('"', f);
+}
+
+bool trace_write_chrome_json(const char* filename)
+{
+    FILE* f = fopen(filename, "wb");
+
+    if (f == nullptr)
+        return false;
+
+    TraceClockSample now = clock_sample();
+    double elapsed_us = std::chrono::duration<double, std::micro>(now.time - trace_start.time).count();
+    double us_per_tick = elapsed_us > 0 && now.timestamp > trace_start.timestamp
+        ? elapsed_us / (double)(now.timestamp - trace_start.timestamp)
+        : 0.001;
+
+    unsigned num_threads = trace_num_threads.load();
+    num_threads = num_threads < TraceMaxThreads ? num_threads : TraceMaxThreads;
+    uint64_t num_dropped = 0;
+    bool first = true;
+    fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    for (unsigned t = 0; t < num_threads; ++t)
+    {
+        const TraceBuffer* b = trace_buffers[t].load(std::memory_order_acquire);
+
+        if (b == nullptr)
+            continue;
+
+        unsigned tid = t + 1;
+        fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"thread %u\"}}", first ? "" : ",\n", tid, tid);
+        first = false;
+
+        uint64_t num_written = b->num_written.load(std::memory_order_acquire);
+        num_dropped += b->num_dropped.load(std::memory_order_relaxed);
+
+        for (uint64_t i = 0; i < num_written; ++i)
+        {
+            const TraceEvent& e = b->chunks[i / TraceEventsPerChunk][i % TraceEventsPerChunk];
+            double ts = (double)(int64_t)(e.start - trace_start.timestamp) * us_per_tick;
+            double dur = (double)(e.end - e.start) * us_per_tick;
+            fprintf(f, ",\n{\"name\": ");
+            write_json_string(f, e.name);
+            fprintf(f, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", tid, ts, dur);
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+
+    if (num_dropped > 0)
+        fprintf(stderr, "Tracing dropped %llu events, threads keep at most %u.\n", (unsigned long long)num_dropped, TraceEventsPerChunk * TraceMaxChunksPerThread);
+
+    return fclose(f) == 0;
+}
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+#include <stdint.h>
+
+//#define ENABLE_TRACING
+
+// Scoped timers for finding where the time goes. TRACE_SCOPE("name") records the time from where it is to the
+// end of the enclosing scope. Every thread records into a buffer of its own without locks, which grows by a chunk
+// of TraceEventsPerChunk events whenever it is full, and trace_write_chrome_json writes them all as a Chrome
+// trace, which chrome://tracing and Perfetto open. Names are stored as pointers, use string literals.
+//
+// Without ENABLE_TRACING TRACE_SCOPE expands to nothing and trace.cpp is empty.
+
+#if defined(ENABLE_TRACING)
+    #if defined(_M_X64) || defined(__x86_64__)
+        #if defined(_MSC_VER)
+            #include <intrin.h>
+        #else
+            #include <x86intrin.h>
+        #endif
+        #define TRACE_USE_RDTSC
+    #else
+        #include <chrono>
+    #endif
+
+    const unsigned TraceEventsPerChunk = 64 * 1024;
+
+    // A thread drops the events it records past this many chunks, 64M events. A bake records about 25 per patch.
+    const unsigned TraceMaxChunksPerThread = 1024;
+
+    // Threads past this many record nothing.
+    const unsigned TraceMaxThreads = 64;
+
+    struct TraceEvent
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // Ticks of the time stamp counter where there is one, converted to time when the trace is written.
+    inline uint64_t trace_timestamp()
+    {
+        #if defined(TRACE_USE_RDTSC)
+            return __rdtsc();
+        #else
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        #endif
+    }
+
+    void trace_record(const char* name, uint64_t start, uint64_t end);
+
+    // Other threads should be done recording, events they write meanwhile may be torn. Returns false if the file
+    // can't be written.
+    bool trace_write_chrome_json(const char* filename);
+
+    struct TraceScope
+    {
+        TraceScope(const char* scope_name) : name(scope_name), start(trace_timestamp())
+        {
+        }
+
+        ~TraceScope()
+        {
+            trace_record(name, start, trace_timestamp());
+        }
+
+        const char* name;
+        uint64_t start;
+    };
+
+    #define TRACE_CONCAT_INNER(a, b) a##b
+    #define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+    #define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+    #define TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,75 @@
+#define ENABLE_TRACING
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include "helpers.h"
+#include "trace.cpp"
+
+static void record_events(unsigned num)
+{
+    for (unsigned i = 0; i < num; ++i)
+    {
+        TRACE_SCOPE("outer");
+        TRACE_SCOPE("inner");
+    }
+}
+
+static unsigned count_occurrences(const char* s, const char* what)
+{
+    unsigned n = 0;
+
+    for (const char* p = strstr(s, what); p != nullptr; p = strstr(p + 1, what))
+        ++n;
+
+    return n;
+}
+
+int main()
+{
+    // One thread fills more than two chunks, the others less than one.
+    const unsigned many = TraceEventsPerChunk + 5;
+    std::thread threads[3] = {
+        std::thread(record_events, 10),
+        std::thread(record_events, many),
+        std::thread(record_events, 3),
+    };
+
+    for (unsigned i = 0; i < 3; ++i)
+        threads[i].join();
+
+    {
+        TRACE_SCOPE("with \"quotes\"");
+    }
+
+    const char* filename = "trace_test.json";
+    assert(trace_write_chrome_json(filename));
+
+    FILE* f = fopen(filename, "rb");
+    assert(f != nullptr);
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char* json = (char*)malloc((size_t)size + 1);
+    assert(fread(json, 1, (size_t)size, f) == (size_t)size);
+    json[size] = 0;
+    fclose(f);
+    remove(filename);
+
+    assert(count_occurrences(json, "\"ph\": \"M\"") == 4);
+    assert(count_occurrences(json, "\"ph\": \"X\"") == 20 + 2 * many + 6 + 1);
+    assert(count_occurrences(json, "\"name\": \"outer\"") == 10 + many + 3);
+    assert(strstr(json, "\"with \\\"quotes\\\"\"") != nullptr);
+    assert(json[0] == '{' && strstr(json, "\n]}\n") != nullptr);
+
+    // Scopes end in reverse order, so each inner event is recorded before its outer one and lies within it.
+    const char* inner = strstr(json, "\"name\": \"inner\"");
+    const char* outer = strstr(json, "\"name\": \"outer\"");
+    assert(inner != nullptr && outer != nullptr && inner < outer);
+    double inner_ts = atof(strstr(inner, "\"ts\": ") + 6), inner_dur = atof(strstr(inner, "\"dur\": ") + 7);
+    double outer_ts = atof(strstr(outer, "\"ts\": ") + 6), outer_dur = atof(strstr(outer, "\"dur\": ") + 7);
+    assert(outer_ts <= inner_ts + 0.001 && inner_ts + inner_dur <= outer_ts + outer_dur + 0.002);
+
+    free(json);
+    return 0;
+}
@@ -9,3 +9,14 @@ struct Vertex
     Vector2 uv;
     Color color;
 };
+
+// Compact vertex, 20 bytes instead of 48. Positions are unorm16 relative to the bounds of the mesh, normals are
+// octahedral encoded snorm16, uvs are half floats so that tiling uvs outside [0, 1] survive, and color is unorm8.
+// position[3] is always 65535 so that the GPU reads w as 1.
+struct PackedVertex
+{
+    unsigned short position[4];
+    short normal[2];
+    unsigned short uv[2];
+    ColorUNorm color;
+};